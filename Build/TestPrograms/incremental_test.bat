@@ -0,0 +1,55 @@
+
+@echo off
+setlocal enabledelayedexpansion
+
+REM Compiles incremental_base.ryu and then two edits of it with the same
+REM -incremental cache. Each step checks how many procedures reused their
+REM cached bytecode (cached_procs), and that main returns the same value
+REM with the cache as it does with a full compilation.
+
+if exist incremental.cache (
+del incremental.cache
+)
+
+set failed=0
+
+REM Nothing is cached yet
+call :Check incremental_base.ryu 0 22
+REM Only the body of Scale changed, its caller can still be reused
+call :Check incremental_body.ryu 3 27
+REM The signature of Scale changed, so Scale and Combine are compiled again
+call :Check incremental_signature.ryu 2 27
+
+del incremental.cache
+del incremental_time.json
+
+if !failed!==0 (
+echo Incremental test passed
+) else (
+echo Incremental test FAILED
+)
+
+exit /b !failed!
+
+:Check
+ryu %1 -incremental incremental.cache -no_link -time=json > incremental_time.json
+findstr /C:"\"cached_procs\": %2," incremental_time.json > nul
+if errorlevel 1 (
+echo %1: expected %2 cached procedures
+set failed=1
+)
+
+REM Everything is cached at this point
+ryu %1 -incremental incremental.cache -run
+if not !errorlevel!==%3 (
+echo %1: main returned !errorlevel! with the cache, expected %3
+set failed=1
+)
+
+ryu %1 -run
+if not !errorlevel!==%3 (
+echo %1: main returned !errorlevel!, expected %3
+set failed=1
+)
+
+exit /b 0
@@ -222,6 +222,88 @@ cforceinline TypeInfo* TokToPrimitiveType(TokenType tokType)
     return 0;
 }
 
+// NOTE: AST nodes are allocated in a few big pools, one for each
+// category of node, so that e.g. the typechecker walking an expression
+// only touches expression nodes, which are packed together. Each pool is
+// a single reservation, so a node can be referred to with a 32-bit handle
+// (its offset in the pool, in 8-byte units) instead of a pointer. Ast_Ref
+// converts to and from pointers implicitly, so edges can be switched over
+// to handles one at a time; for now it's done for the edges between
+// expressions, which make up most of the AST in typical code.
+// Parsers hand out nodes from chunks of the pools, which are taken with
+// an atomic increment, so it works with the parallel parse as well.
+
+enum Ast_PoolKind : uint8
+{
+    Ast_ExprPool = 0,
+    Ast_StmtPool,
+    Ast_DeclPool,  // Including procedure definitions
+    
+    Ast_NumPools
+};
+
+#define Ast_PoolGranularity 8  // Alignment of all nodes, and unit of the handles
+#define Ast_PoolReserveSize GB(8)
+#define Ast_PoolChunkSize   KB(256)
+
+struct Ast_Pool
+{
+    char* base = 0;
+    volatile uint32 numChunks = 0;
+};
+
+// Part of a chunk, owned by a single parser
+struct Ast_PoolCursor
+{
+    char* at  = 0;
+    char* end = 0;
+};
+
+extern Ast_Pool astPools[Ast_NumPools];
+
+// 0 is the null handle
+typedef uint32 Ast_Handle;
+
+cforceinline void* Ast_FromHandle(Ast_PoolKind pool, Ast_Handle handle)
+{
+    if(handle == 0) return 0;
+    return astPools[pool].base + (uint64)handle * Ast_PoolGranularity;
+}
+
+cforceinline Ast_Handle Ast_ToHandle(Ast_PoolKind pool, void* ptr)
+{
+    if(!ptr) return 0;
+    
+    uint64 offset = (uint64)((char*)ptr - astPools[pool].base);
+    Assert(offset < Ast_PoolReserveSize && offset % Ast_PoolGranularity == 0 && "Node is not in this pool");
+    return (Ast_Handle)(offset / Ast_PoolGranularity);
+}
+
+template<typename t, Ast_PoolKind pool>
+struct Ast_Ref
+{
+    Ast_Handle handle = 0;
+    
+    Ast_Ref() = default;
+    Ast_Ref(t* ptr) { handle = Ast_ToHandle(pool, ptr); }
+    
+    cforceinline operator t*() const { return (t*)Ast_FromHandle(pool, handle); }
+    cforceinline t* operator->() const { return (t*)Ast_FromHandle(pool, handle); }
+    
+    // For casts to other kinds of nodes, as with pointers
+    template<typename u>
+    cforceinline explicit operator u*() const { return (u*)Ast_FromHandle(pool, handle); }
+};
+
+template<typename t>
+using Ast_ExprRef = Ast_Ref<t, Ast_ExprPool>;
+
+// Sets up the pools, if they haven't been already
+void Ast_InitPools();
+// Frees all nodes, while no parsers are running
+void Ast_ResetPools();
+void* Ast_PoolAlloc(Ast_PoolCursor* cursor, Ast_PoolKind pool, size_t size);
+
 // @cleanup the same function is in typer (should just be in typer)
 template<typename t>
 t* Ast_MakeType(Arena* arena)
@@ -236,10 +318,9 @@ struct Ast_Node
 {
     // Primary token representing this node
     // (e.g. 'if' token for if statement)
-    Token* where;
-    Ast_NodeKind kind;
-    
+    TokenIdx where;
     Dg_Idx entityIdx = Dg_Null;
+    Ast_NodeKind kind;
     CompPhase phase = CompPhase_Typecheck;
 };
 
@@ -271,11 +352,11 @@ inline bool Ast_IsDecl(Ast_Node* node)
 
 struct Ast_Expr : public Ast_Node
 {
+    TokenIdx typeWhere = 0;
     TypeInfo* type;
     // Type to convert to during codegen.
     // For example, in 3.4 + 4, 4 has convertTo = float
     TypeInfo* castType;
-    Token* typeWhere = 0;
 };
 
 struct Ast_Stmt : public Ast_Node {};
@@ -299,9 +380,9 @@ struct Ast_Block : public Ast_Stmt
     // and detect "use before decl" scenarios.
     Array<Ast_Declaration*> decls;
     // When the array gets too big, a table is used instead.
-    // (Key is just a hash). When this is constructed, all strings
-    // are hashed beforehand by the lexer, so there's no need to
-    // compute the hash for this.
+    // (Key is the atom of the name). All identifiers are
+    // interned beforehand by the lexer, so there's no need
+    // to hash or compare any strings for this.
     HashTable<int64, Ast_Declaration*> declsTable;
     
     Ast_Block* enclosing = 0;
@@ -446,7 +527,7 @@ struct Ast_IdentType : public TypeInfo
 {
     Ast_IdentType() { typeId = Typeid_Ident; };
     
-    HashedString name;
+    InternedString name;
     
     Slice<Ast_Expr*> polyParams = { 0, 0 };
     
@@ -459,10 +540,10 @@ struct Ast_StructType : public TypeInfo
     Ast_StructType() { typeId = Typeid_Struct; };
     
     Slice<TypeInfo*>    memberTypes = { 0, 0 };
-    Slice<HashedString> memberNames = { 0, 0 };
+    Slice<InternedString> memberNames = { 0, 0 };
     
     // For errors
-    Slice<Token*> memberNameTokens = { 0, 0 };
+    Slice<TokenIdx> memberNameTokens = { 0, 0 };
     
     // Filled in later in the sizing stage 
     Slice<uint32> memberOffsets = { 0, 0 };
@@ -473,9 +554,9 @@ struct Ast_StructType : public TypeInfo
 struct Ast_Declaration : public Ast_Node
 {
     Ast_DeclSpec declSpecs;
-    Token* typeTok;
+    TokenIdx typeTok;
     TypeInfo* type;
-    HashedString name;
+    InternedString name;
     
     // Codegen
     TB_Node* tildeNode;
@@ -509,6 +590,7 @@ struct Ast_ProcDef : public Ast_Node
     Ast_ProcDecl* decl;
     
     Ast_Block block;
+    TokenIdx bodyStart = 0;  // The '{', where the signature ends
     
     // Flattened form of all declarations in the
     // procedure. Useful for codegen and other things
@@ -536,11 +618,11 @@ struct Ast_BinaryExpr : public Ast_Expr
     Ast_BinaryExpr() { kind = AstKind_BinaryExpr; };
     
     uint16 op;  // I guess this can just be the token type value for now
-    Ast_Expr* lhs;
-    Ast_Expr* rhs;
+    Ast_ExprRef<Ast_Expr> lhs;
+    Ast_ExprRef<Ast_Expr> rhs;
     
     // Filled in by the typechecker
-    Ast_FuncCall* overloaded = 0;
+    Ast_ExprRef<Ast_FuncCall> overloaded = 0;
 };
 
 struct Ast_UnaryExpr : public Ast_Expr
@@ -549,10 +631,10 @@ struct Ast_UnaryExpr : public Ast_Expr
     
     uint16 op;
     bool isPostfix;
-    Ast_Expr* expr;
+    Ast_ExprRef<Ast_Expr> expr;
     
     // Filled in by the typechecker
-    Ast_FuncCall* overloaded = 0;
+    Ast_ExprRef<Ast_FuncCall> overloaded = 0;
 };
 
 struct Ast_TernaryExpr : public Ast_Expr
@@ -560,19 +642,19 @@ struct Ast_TernaryExpr : public Ast_Expr
     Ast_TernaryExpr() { kind = AstKind_TernaryExpr; };
     
     uint8 ternaryOperator;
-    Ast_Expr* expr1;
-    Ast_Expr* expr2;
-    Ast_Expr* expr3;
+    Ast_ExprRef<Ast_Expr> expr1;
+    Ast_ExprRef<Ast_Expr> expr2;
+    Ast_ExprRef<Ast_Expr> expr3;
     
     // Filled in by the typechecker
-    Ast_FuncCall* overloaded = 0;
+    Ast_ExprRef<Ast_FuncCall> overloaded = 0;
 };
 
 struct Ast_FuncCall : public Ast_Expr
 {
     Ast_FuncCall() { kind = AstKind_FuncCall; };
     
-    Ast_Expr* target;
+    Ast_ExprRef<Ast_Expr> target;
     Slice<Ast_Expr*> args = { 0, 0 };
     
     // Filled in by the typechecker
@@ -583,15 +665,15 @@ struct Ast_Subscript : public Ast_Expr
 {
     Ast_Subscript() { kind = AstKind_Subscript; };
     
-    Ast_Expr* target;
-    Ast_Expr* idxExpr;
+    Ast_ExprRef<Ast_Expr> target;
+    Ast_ExprRef<Ast_Expr> idxExpr;
 };
 
 struct Ast_IdentExpr : public Ast_Expr
 {
     Ast_IdentExpr() { kind = AstKind_Ident; };
     
-    HashedString name;
+    InternedString name;
     
     // Filled in by the typechecker
     Ast_Declaration* declaration = 0;
@@ -601,9 +683,9 @@ struct Ast_MemberAccess : public Ast_Expr
 {
     Ast_MemberAccess() { kind = AstKind_MemberAccess; };
     
-    Ast_Expr* target;
+    Ast_ExprRef<Ast_Expr> target;
     
-    HashedString memberName;
+    InternedString memberName;
     
     // Filled in by the typechecker
     Ast_StructType* structDecl = 0;
@@ -614,7 +696,7 @@ struct Ast_Typecast : public Ast_Expr
 {
     Ast_Typecast() { kind = AstKind_Typecast; };
     
-    Ast_Expr* expr;
+    Ast_ExprRef<Ast_Expr> expr;
 };
 
 enum ConstBitfield
@@ -661,14 +743,28 @@ inline bool Ast_IsExprBitManipulation(Ast_BinaryExpr* expr)
     return false;
 }
 
+// Pool of each kind of node, the most derived overload is picked
+constexpr Ast_PoolKind Ast_PoolOf(Ast_Node*)        { return Ast_StmtPool; }
+constexpr Ast_PoolKind Ast_PoolOf(Ast_Expr*)        { return Ast_ExprPool; }
+constexpr Ast_PoolKind Ast_PoolOf(Ast_Declaration*) { return Ast_DeclPool; }
+constexpr Ast_PoolKind Ast_PoolOf(Ast_ProcDef*)     { return Ast_DeclPool; }
+
+inline Ast_PoolKind Ast_PoolOfKind(Ast_NodeKind kind)
+{
+    if(kind >= AstKind_ExprBegin && kind <= AstKind_ExprEnd) return Ast_ExprPool;
+    if(kind >= AstKind_DeclBegin && kind <= AstKind_DeclEnd) return Ast_DeclPool;
+    return Ast_StmtPool;
+}
+
+struct Parser;
 template<typename t>
-t* Ast_MakeNode(Arena* arena, Token* token);
-Ast_Node* Ast_MakeNode(Arena* arena, Token* token, Ast_NodeKind kind);
+t* Ast_MakeNode(Parser* p, TokenIdx token);
+Ast_Node* Ast_MakeNode(Parser* p, TokenIdx token, Ast_NodeKind kind);
 template<>
-Ast_Declaration* Ast_MakeNode<Ast_Declaration>(Arena* arena, Token* token);
+Ast_Declaration* Ast_MakeNode<Ast_Declaration>(Parser* p, TokenIdx token);
 
 template<typename t>
-t Ast_InitNode(Token* token);
+t Ast_InitNode(TokenIdx token);
 
 // Utility functions
 
@@ -679,14 +775,14 @@ cforceinline Ast_ProcType* Ast_GetProcType(Ast_ProcDecl* procDecl) { return (Ast
 cforceinline Ast_ProcType* Ast_GetProcDefType(Ast_ProcDef* procDef) { return (Ast_ProcType*)procDef->decl->type; }
 cforceinline Ast_StructType* Ast_GetStructType(Ast_StructDef* structDef) { return (Ast_StructType*)structDef->type; }
 
-cforceinline Token* Ast_GetVarDeclTypeToken(Ast_VarDecl* decl)
+cforceinline TokenIdx Ast_GetVarDeclTypeToken(Ast_VarDecl* decl)
 {
     // This might be a horrible hack, but maybe not.
     // TODO: Update: it definitely is.
     return decl->where - 1;
 }
 
-cforceinline Token* Ast_GetTypecastTypeToken(Ast_Typecast* typecast)
+cforceinline TokenIdx Ast_GetTypecastTypeToken(Ast_Typecast* typecast)
 {
     return typecast->where;
 }
@@ -0,0 +1,29 @@
+
+#include "atom.h"
+
+AtomTable atomTable;
+
+Atom Atom_Intern(String str)
+{
+    uint32 hash = (uint32)HashString(str);
+    Atom_Shard* shard = &atomTable.shards[hash >> (32 - Atom_ShardBits)];
+    
+    Spinlock_Lock(&shard->lock);
+    defer(Spinlock_Unlock(&shard->lock));
+    
+    Atom* found = shard->table.Get(str, hash);
+    if(found) return *found;
+    
+    // Atoms start from 1
+    Atom atom = AtomicIncrement32(&atomTable.numAtoms);
+    shard->table.Add(str, hash, atom);
+    return atom;
+}
+
+void Atom_ResetTable()
+{
+    for(int i = 0; i < Atom_NumShards; ++i)
+        atomTable.shards[i].table.Free();
+    
+    atomTable.numAtoms = 0;
+}
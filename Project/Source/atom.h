@@ -0,0 +1,33 @@
+
+#pragma once
+
+#include "base.h"
+
+// NOTE: Every distinct identifier is interned by the lexer and gets
+// a unique 32-bit atom, so all later phases can compare names with a
+// single integer compare. The table is global and sharded by hash, each
+// shard with its own lock, so that files can be lexed in parallel.
+// Strings are not copied, they need to outlive the table (file contents
+// are never freed anyway, other sources reset the table before freeing).
+
+#define Atom_ShardBits 4
+#define Atom_NumShards (1 << Atom_ShardBits)
+
+struct alignas(64) Atom_Shard
+{
+    Spinlock lock;
+    StringTable<Atom> table;
+};
+
+struct AtomTable
+{
+    Atom_Shard shards[Atom_NumShards];
+    volatile uint32 numAtoms = 0;
+};
+
+extern AtomTable atomTable;
+
+// Thread-safe
+Atom Atom_Intern(String str);
+// Frees all atoms, while no files are being lexed
+void Atom_ResetTable();
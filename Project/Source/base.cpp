@@ -1,46 +1,6 @@
 
 #include "base.h"
 
-char* ReadEntireFileIntoMemoryAndNullTerminate(char* fileName)
-{
-    ProfileFunc(prof);
-    
-    char* result = NULL;
-    
-    FILE* file = fopen(fileName, "rb");
-    if(file)
-    {
-        fseek(file, 0, SEEK_END);
-        size_t fileSize = ftell(file);
-        fseek(file, 0, SEEK_SET);
-        
-        result = (char*)malloc(fileSize + 1);
-        fread(result, 1, fileSize, file);
-        result[fileSize] = 0;
-        
-        fclose(file);
-    }
-    else
-    {
-        printf("Usage Error: Could not find the file ");
-        printf(fileName);
-        printf("\n");
-    }
-    
-    return result;
-}
-
-size_t GetFileSize(FILE* file)
-{
-    if(!file) return 0;
-    
-    size_t prev = ftell(file);
-    fseek(file, 0, SEEK_END);
-    size_t res = ftell(file);
-    fseek(file, 0, prev);
-    return res;
-}
-
 // Slice utilities
 template<typename t>
 void Slice<t>::Append(Arena* a, t element)
@@ -98,6 +58,95 @@ Slice<t> Slice<t>::CopyToArena(Arena* to)
     return result;
 }
 
+// ArenaArray utilities
+template<typename t>
+void ArenaArray<t>::Append(Arena* a, t element)
+{
+    if(this->length >= this->capacity)
+    {
+        int64 newCapacity = this->capacity * 2;
+        if(newCapacity < ArenaArray_MinCapacity)
+            newCapacity = ArenaArray_MinCapacity;
+        
+        this->Reserve(a, newCapacity);
+    }
+    
+    this->ptr[this->length] = element;
+    ++this->length;
+}
+
+template<typename t>
+void ArenaArray<t>::Reserve(Arena* a, int64 newCapacity)
+{
+    if(newCapacity <= this->capacity) return;
+    
+    // Grows in place if possible, otherwise copies
+    this->ptr = (t*)Arena_ResizeLastAlloc(a, this->ptr,
+                                          sizeof(t) * this->capacity,
+                                          sizeof(t) * newCapacity,
+                                          alignof(t));
+    this->capacity = newCapacity;
+}
+
+template<typename t>
+void ArenaArray<t>::ShrinkToFit(Arena* a)
+{
+    if(this->length == 0 || this->length == this->capacity) return;
+    if((a->buffer + a->prevOffset) != (uchar*)this->ptr) return;
+    
+    Arena_ResizeLastAlloc(a, this->ptr, sizeof(t) * this->capacity,
+                          sizeof(t) * this->length, alignof(t));
+    this->capacity = this->length;
+}
+
+// ChunkedArray utilities
+template<typename t>
+void ChunkedArray<t>::Append(Arena* a, t element)
+{
+    Chunk* chunk = this->lastChunk;
+    if(!chunk || chunk->length >= chunk->capacity)
+    {
+        int64 capacity = chunk ? chunk->capacity * 2 : ChunkedArray_MinChunkSize;
+        
+        Chunk* newChunk = Arena_AllocVar(a, Chunk);
+        newChunk->next     = 0;
+        newChunk->ptr      = (t*)Arena_Alloc(a, sizeof(t) * capacity, alignof(t));
+        newChunk->length   = 0;
+        newChunk->capacity = capacity;
+        
+        if(chunk)
+            chunk->next = newChunk;
+        else
+            this->firstChunk = newChunk;
+        
+        this->lastChunk = newChunk;
+        chunk = newChunk;
+    }
+    
+    chunk->ptr[chunk->length] = element;
+    ++chunk->length;
+    ++this->length;
+}
+
+template<typename t>
+Slice<t> ChunkedArray<t>::CopyToArena(Arena* to)
+{
+    Slice<t> result = { 0, 0 };
+    if(this->length == 0) return result;
+    
+    result.ptr = (t*)Arena_Alloc(to, sizeof(t) * this->length, alignof(t));
+    result.length = this->length;
+    
+    int64 offset = 0;
+    for(Chunk* chunk = this->firstChunk; chunk; chunk = chunk->next)
+    {
+        memcpy(&result.ptr[offset], chunk->ptr, sizeof(t) * chunk->length);
+        offset += chunk->length;
+    }
+    
+    return result;
+}
+
 void String::Append(Arena* a, char element)
 {
     // If empty, allocate a new array
@@ -157,6 +206,11 @@ uint64 HashString(char* str, uint64 seed)
     return hash + seed;
 }
 
+uint32 LayoutIdOf(Slice<uint64> sizes)
+{
+    return (uint32)HashString({ (char*)sizes.ptr, (int64)(sizes.length * sizeof(uint64)) });
+}
+
 // Slice utilities
 template<typename t>
 void Array<t>::Append(t element)
@@ -205,7 +259,7 @@ void Array<t>::Resize(uint32 newSize)
     this->length = newSize;
     if(this->capacity < this->length)
     {
-        if(this->capacity < Array_MinCapacity)
+        if(this->length < Array_MinCapacity)
             capacity = Array_MinCapacity;
         else
             this->capacity = this->length * 3 / 2;
@@ -235,13 +289,70 @@ void Array<t>::FreeAll()
     this->length   = 0;
 }
 
+cforceinline uint32 HashTable_MatchByte(uint8* group, uint8 b)
+{
+#ifdef HashTable_SSE2
+    __m128i ctrl = _mm_loadu_si128((__m128i*)group);
+    return (uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8((char)b)));
+#else
+    uint32 res = 0;
+    for(int i = 0; i < HashTable_GroupSize; ++i)
+        res |= (uint32)(group[i] == b) << i;
+    return res;
+#endif
+}
+
+cforceinline uint32 HashTable_MatchEmpty(uint8* group)
+{
+    return HashTable_MatchByte(group, HashTable_Empty);
+}
+
+cforceinline uint32 HashTable_MatchEmptyOrDeleted(uint8* group)
+{
+#ifdef HashTable_SSE2
+    // Both have the upper bit set
+    __m128i ctrl = _mm_loadu_si128((__m128i*)group);
+    return (uint32)_mm_movemask_epi8(ctrl);
+#else
+    uint32 res = 0;
+    for(int i = 0; i < HashTable_GroupSize; ++i)
+        res |= (uint32)((group[i] & 0x80) != 0) << i;
+    return res;
+#endif
+}
+
+cforceinline uint32 HashTable_FirstBit(uint32 mask)
+{
+    Assert(mask != 0);
+    return LowestSetBit(mask);
+}
+
+uint32 HashTable_RoundCapacity(uint32 capacity)
+{
+    uint32 res = HashTable_MinCapacity;
+    while(res < capacity) res *= 2;
+    return res;
+}
+
+// Quadratic (triangular) probing over groups, which
+// visits all groups when their number is a power of 2
+cforceinline uint32 HashTable_ProbingScheme(uint32 group, uint32 step, uint32 numGroups)
+{
+    return (group + step) & (numGroups - 1);
+}
+
 template<typename k, typename v>
 void HashTable<k, v>::Init(uint32 capacity)
 {
-    this->capacity = capacity;
-    uint64 numBytes = sizeof(HashTableEntry<k, v>) * capacity;
-    entries = (HashTableEntry<k, v>*)malloc(numBytes);
-    memset(entries, 0, numBytes);
+    capacity = HashTable_RoundCapacity(capacity);
+    this->capacity   = capacity;
+    this->count      = 0;
+    this->tombstones = 0;
+    
+    ctrl = (uint8*)malloc(capacity);
+    keys = (k*)malloc(sizeof(k) * capacity);
+    vals = (v*)malloc(sizeof(v) * capacity);
+    memset(ctrl, HashTable_Empty, capacity);
 }
 
 template<typename k, typename v>
@@ -270,15 +381,47 @@ uint32 HashTable<k, v>::HashFunction(uintptr key)
 template<typename k, typename v>
 v* HashTable<k, v>::Get(k key)
 {
+    HashTableCursor<k> cursor;
+    return GetFirst(key, &cursor);
+}
+
+template<typename k, typename v>
+v* HashTable<k, v>::GetFirst(k key, HashTableCursor<k>* cursor)
+{
+    if(capacity == 0) return 0;
+    
     uint32 hash = HashFunction((uintptr)key);
-    for(int i = 0; i <= count + 1; ++i)
+    uint32 numGroups = capacity / HashTable_GroupSize;
+    cursor->key     = key;
+    cursor->h2      = hash & 0x7F;
+    cursor->group   = (hash >> 7) & (numGroups - 1);
+    cursor->step    = 0;
+    cursor->matches = HashTable_MatchByte(&ctrl[cursor->group * HashTable_GroupSize], cursor->h2);
+    return GetNext(cursor);
+}
+
+template<typename k, typename v>
+v* HashTable<k, v>::GetNext(HashTableCursor<k>* cursor)
+{
+    uint32 numGroups = capacity / HashTable_GroupSize;
+    while(true)
     {
-        Assert(i != count + 1);
+        uint32 groupStart = cursor->group * HashTable_GroupSize;
+        while(cursor->matches)
+        {
+            uint32 idx = groupStart + HashTable_FirstBit(cursor->matches);
+            cursor->matches &= cursor->matches - 1;
+            if(keys[idx] == cursor->key)
+                return &vals[idx];
+        }
+        
+        // If there's an empty slot in this group, the
+        // key can't be further along the probe sequence
+        if(HashTable_MatchEmpty(&ctrl[groupStart]) || cursor->step + 1 >= numGroups)
+            return 0;
         
-        uint32 idx = HashTable_ProbingScheme(hash, i, capacity);
-        if(entries[idx].occupied && entries[idx].key == key)
-            return &entries[idx].val;
-        else return 0;
+        cursor->group   = HashTable_ProbingScheme(cursor->group, ++cursor->step, numGroups);
+        cursor->matches = HashTable_MatchByte(&ctrl[cursor->group * HashTable_GroupSize], cursor->h2);
     }
     
     return 0;
@@ -287,97 +430,148 @@ v* HashTable<k, v>::Get(k key)
 template<typename k, typename v>
 void HashTable<k, v>::Add(k key, v val)
 {
+    if(capacity == 0)
+        Init(HashTable_MinCapacity);
+    else if(count + tombstones + 1 > capacity * HashTable_LoadFactor)
+    {
+        // If it's mostly tombstones, just clean
+        // them up instead of growing the table
+        bool grow = count + 1 > capacity * HashTable_LoadFactor / 2;
+        Grow(grow ? capacity * 2 : capacity);
+    }
+    
     uint32 hash = HashFunction((uintptr)key);
-    for(int i = 0; i <= count + 1; ++i)
+    uint32 numGroups = capacity / HashTable_GroupSize;
+    uint32 group = (hash >> 7) & (numGroups - 1);
+    for(uint32 step = 0; ; group = HashTable_ProbingScheme(group, ++step, numGroups))
     {
-        Assert(i != count + 1);
+        Assert(step < numGroups);
+        
+        uint32 freeSlots = HashTable_MatchEmptyOrDeleted(&ctrl[group * HashTable_GroupSize]);
+        if(!freeSlots) continue;
         
-        uint32 idx = HashTable_ProbingScheme(hash, i, capacity);
-        if(entries[idx].occupied) continue;
+        uint32 idx = group * HashTable_GroupSize + HashTable_FirstBit(freeSlots);
+        if(ctrl[idx] == HashTable_Deleted) --tombstones;
         
-        // Not occupied, add new value
-        entries[idx].key = key;
-        entries[idx].occupied = true;
-        entries[idx].val = val;
+        ctrl[idx] = hash & 0x7F;
+        keys[idx] = key;
+        vals[idx] = val;
         ++count;
         break;
     }
+}
+
+template<typename k, typename v>
+bool HashTable<k, v>::Remove(k key)
+{
+    HashTableCursor<k> cursor;
+    v* val = GetFirst(key, &cursor);
+    if(!val) return false;
+    
+    // If the group still has an empty slot, probing would
+    // stop here anyway, so no tombstone is needed
+    uint32 idx = (uint32)(val - vals);
+    uint8* group = &ctrl[idx - idx % HashTable_GroupSize];
+    if(HashTable_MatchEmpty(group))
+        ctrl[idx] = HashTable_Empty;
+    else
+    {
+        ctrl[idx] = HashTable_Deleted;
+        ++tombstones;
+    }
     
-    if((float)count / capacity > HashTable_LoadFactor)
-        Grow(capacity * 2);
+    --count;
+    return true;
 }
 
 template<typename k, typename v>
 void HashTable<k, v>::Grow(uint32 newSize)
 {
-    uint64 numBytes = sizeof(HashTableEntry<k, v>) * newSize;
-    auto newEntries = (HashTableEntry<k, v>*)malloc(numBytes);
-    memset(newEntries, 0, numBytes);
+    uint8* oldCtrl = ctrl;
+    k* oldKeys = keys;
+    v* oldVals = vals;
+    uint32 oldCapacity = capacity;
     
-    for(int i = 0; i < capacity; ++i)
+    // Tombstones are dropped in the process
+    Init(newSize);
+    for(uint32 i = 0; i < oldCapacity; ++i)
     {
-        if(!entries[i].occupied) continue;
+        if(oldCtrl[i] & 0x80) continue;
+        
         // TODO: @performance Instead of recalculating the hash,
         // They could all just be stored in a separate array. Not
         // sure if that's faster though
-        uint32 hash = HashFunction((uintptr)entries[i].key);
-        
-        for(int j = 0; j <= count + 1; ++j)
-        {
-            Assert(j != count + 1);
-            
-            int idx = HashTable_ProbingScheme(hash, j, newSize);
-            if(newEntries[idx].occupied) continue;
-            
-            newEntries[idx] = entries[i];
-            break;
-        }
+        Add(oldKeys[i], oldVals[i]);
     }
     
-    free(entries);
-    entries = newEntries;
-    capacity = newSize;
+    free(oldCtrl);
+    free(oldKeys);
+    free(oldVals);
 }
 
 template<typename k, typename v>
 void HashTable<k, v>::Free()
 {
-    free(entries);
+    free(ctrl);
+    free(keys);
+    free(vals);
+    ctrl = 0;
+    keys = 0;
+    vals = 0;
+    count = 0;
+    tombstones = 0;
+    capacity = 0;
 }
 
-cforceinline uint32 HashTable_ProbingScheme(uint32 hash, uint32 iter, uint32 length)
+template<typename v>
+void StringTable<v>::Init(uint32 capacity)
 {
-    // Linear
-    return (hash + iter) % length;
+    capacity = HashTable_RoundCapacity(capacity);
+    this->capacity   = capacity;
+    this->count      = 0;
+    this->tombstones = 0;
+    
+    ctrl   = (uint8*)malloc(capacity);
+    keys   = (String*)malloc(sizeof(String) * capacity);
+    vals   = (v*)malloc(sizeof(v) * capacity);
+    hashes = (uint32*)malloc(sizeof(uint32) * capacity);
+    memset(ctrl, HashTable_Empty, capacity);
 }
 
 template<typename v>
-void StringTable<v>::Init(uint32 capacity)
+uint32 StringTable<v>::HashFunction(String key)
 {
-    this->capacity = capacity;
-    uint64 numBytes = sizeof(StringTableEntry<v>) * capacity;
-    entries = (StringTableEntry<v>*)malloc(numBytes);
-    memset(entries, 0, numBytes);
+    return (uint32)HashString(key);
 }
 
 template<typename v>
-uint64 StringTable<v>::HashFunction(String key)
+v* StringTable<v>::Get(String key)
 {
-    return HashString(str);
+    return Get(key, HashFunction(key));
 }
 
 template<typename v>
-v* StringTable<v>::Get(String key)
+v* StringTable<v>::Get(String key, uint32 hash)
 {
-    uint32 hash = HashFunction((uintptr)key);
-    for(int i = 0; i <= count + 1; ++i)
+    if(capacity == 0) return 0;
+    
+    uint8 h2 = hash & 0x7F;
+    uint32 numGroups = capacity / HashTable_GroupSize;
+    uint32 group = (hash >> 7) & (numGroups - 1);
+    for(uint32 step = 0; step < numGroups; group = HashTable_ProbingScheme(group, ++step, numGroups))
     {
-        Assert(i != count + 1);
+        uint32 groupStart = group * HashTable_GroupSize;
+        uint32 matches = HashTable_MatchByte(&ctrl[groupStart], h2);
+        while(matches)
+        {
+            uint32 idx = groupStart + HashTable_FirstBit(matches);
+            matches &= matches - 1;
+            if(hashes[idx] == hash && keys[idx] == key)
+                return &vals[idx];
+        }
         
-        uint32 idx = StringTable_ProbingScheme(hash, i, capacity);
-        if(entries[idx].occupied && entries[idx].key == key)
-            return &entries[idx].val;
-        else return 0;
+        if(HashTable_MatchEmpty(&ctrl[groupStart]))
+            return 0;
     }
     
     return 0;
@@ -386,68 +580,116 @@ v* StringTable<v>::Get(String key)
 template<typename v>
 void StringTable<v>::Add(String key, v val)
 {
-    uint32 hash = HashFunction((uintptr)key);
-    for(int i = 0; i <= count + 1; ++i)
+    Add(key, HashFunction(key), val);
+}
+
+template<typename v>
+void StringTable<v>::Add(String key, uint32 hash, v val)
+{
+    if(capacity == 0)
+        Init(HashTable_MinCapacity);
+    else if(count + tombstones + 1 > capacity * HashTable_LoadFactor)
+    {
+        bool grow = count + 1 > capacity * HashTable_LoadFactor / 2;
+        Grow(grow ? capacity * 2 : capacity);
+    }
+    
+    uint32 numGroups = capacity / HashTable_GroupSize;
+    uint32 group = (hash >> 7) & (numGroups - 1);
+    for(uint32 step = 0; ; group = HashTable_ProbingScheme(group, ++step, numGroups))
     {
-        Assert(i != count + 1);
+        Assert(step < numGroups);
+        
+        uint32 freeSlots = HashTable_MatchEmptyOrDeleted(&ctrl[group * HashTable_GroupSize]);
+        if(!freeSlots) continue;
         
-        uint32 idx = StringTable_ProbingScheme(hash, i, capacity);
-        if(entries[idx].occupied) continue;
+        uint32 idx = group * HashTable_GroupSize + HashTable_FirstBit(freeSlots);
+        if(ctrl[idx] == HashTable_Deleted) --tombstones;
         
-        // Not occupied, add new value
-        entries[idx].key = key;
-        entries[idx].occupied = true;
-        entries[idx].val = val;
+        ctrl[idx]   = hash & 0x7F;
+        keys[idx]   = key;
+        vals[idx]   = val;
+        hashes[idx] = hash;
         ++count;
         break;
     }
+}
+
+template<typename v>
+bool StringTable<v>::Remove(String key)
+{
+    v* val = Get(key);
+    if(!val) return false;
+    
+    uint32 idx = (uint32)(val - vals);
+    uint8* group = &ctrl[idx - idx % HashTable_GroupSize];
+    if(HashTable_MatchEmpty(group))
+        ctrl[idx] = HashTable_Empty;
+    else
+    {
+        ctrl[idx] = HashTable_Deleted;
+        ++tombstones;
+    }
     
-    if((float)count / capacity > StringTable_LoadFactor)
-        Grow(capacity * 2);
+    --count;
+    return true;
 }
 
 template<typename v>
 void StringTable<v>::Grow(uint32 newSize)
 {
-    uint64 numBytes = sizeof(StringTableEntry<k, v>) * newSize;
-    auto newEntries = (StringTableEntry<k, v>*)malloc(numBytes);
-    memset(newEntries, 0, numBytes);
+    uint8* oldCtrl = ctrl;
+    String* oldKeys = keys;
+    v* oldVals = vals;
+    uint32* oldHashes = hashes;
+    uint32 oldCapacity = capacity;
     
-    for(int i = 0; i < capacity; ++i)
+    Init(newSize);
+    uint32 numGroups = capacity / HashTable_GroupSize;
+    for(uint32 i = 0; i < oldCapacity; ++i)
     {
-        if(!entries[i].occupied) continue;
-        // TODO: @performance Instead of recalculating the hash,
-        // They could all just be stored in a separate array
-        uint32 hash = HashFunction((uintptr)entries[i].key);
+        if(oldCtrl[i] & 0x80) continue;
         
-        for(int j = 0; j <= count + 1; ++j)
+        // Reinsert using the stored hash
+        uint32 hash = oldHashes[i];
+        uint32 group = (hash >> 7) & (numGroups - 1);
+        for(uint32 step = 0; ; group = HashTable_ProbingScheme(group, ++step, numGroups))
         {
-            Assert(j != count + 1);
+            Assert(step < numGroups);
             
-            int idx = StringTable_ProbingScheme(hash, j, newSize);
-            if(newEntries[idx].occupied) continue;
+            uint32 freeSlots = HashTable_MatchEmptyOrDeleted(&ctrl[group * HashTable_GroupSize]);
+            if(!freeSlots) continue;
             
-            newEntries[idx] = entries[i];
+            uint32 idx = group * HashTable_GroupSize + HashTable_FirstBit(freeSlots);
+            ctrl[idx]   = hash & 0x7F;
+            keys[idx]   = oldKeys[i];
+            vals[idx]   = oldVals[i];
+            hashes[idx] = hash;
+            ++count;
             break;
         }
     }
     
-    free(entries);
-    entries = newEntries;
-    capacity = newSize;
+    free(oldCtrl);
+    free(oldKeys);
+    free(oldVals);
+    free(oldHashes);
 }
 
 template<typename v>
 void StringTable<v>::Free()
 {
-    Arena_TempEnd(temp);
-    free(entries);
-}
-
-cforceinline uint32 StringTable_ProbingScheme(uint32 hash, uint32 iter, uint32 length)
-{
-    // Linear
-    return (hash + iter) % length;
+    free(ctrl);
+    free(keys);
+    free(vals);
+    free(hashes);
+    ctrl   = 0;
+    keys   = 0;
+    vals   = 0;
+    hashes = 0;
+    count = 0;
+    tombstones = 0;
+    capacity = 0;
 }
 
 int numDigits(int n)
@@ -592,21 +834,15 @@ bool operator ==(char* s1, String s2)
     return s1[i] == 0;
 }
 
-inline bool operator ==(HashedString s1, HashedString s2)
+inline bool operator ==(InternedString s1, InternedString s2)
 {
-    // Fast path, the hashes match
-    if(s1.hash == s2.hash) return true;
-    
-    // Slow path, regular string compare
-    int i = 0;
-    while(i < s2.length)
-    {
-        if(s1[i] == 0 || s2[i] != s1[i])
-            return false;
-        ++i;
-    }
-    
-    return s1[i] == 0;
+    Assert(s1.atom != 0 && s2.atom != 0);
+    return s1.atom == s2.atom;
+}
+
+inline bool operator !=(InternedString s1, InternedString s2)
+{
+    return !(s1 == s2);
 }
 
 // Exits if it sees a null terminator,
@@ -687,32 +923,88 @@ Arena* GetScratchArena(ThreadContext* threadCtx, int idx)
 }
 
 #ifdef Profile
+struct Spall_ThreadBuffer
+{
+    SpallBuffer buffer;
+    uint32 tid;
+    bool initted;
+};
+
+static thread_local Spall_ThreadBuffer spallThreadBuffer;
+static uint32 spallPid = 0;
+
 void InitSpall()
 {
     spallCtx = spall_init_file("ryu_profile.spall", 1000000.0 / GetRdtscFreq());
-    
-    size_t bufferSize = GB(1);
-    uchar* buffer = (uchar*)malloc(bufferSize);
-    memset(buffer, 1, bufferSize);
-    
-    spallBuffer.length = bufferSize;
-    spallBuffer.data   = buffer;
+    spallPid = OS_GetProcessId();
 }
 
 void QuitSpall()
 {
-    spall_buffer_quit(&spallCtx, &spallBuffer);
+    QuitSpallThread();
     spall_quit(&spallCtx);
 }
 
+static Spall_ThreadBuffer* Spall_GetThreadBuffer()
+{
+    Spall_ThreadBuffer* threadBuffer = &spallThreadBuffer;
+    if(!threadBuffer->initted)
+    {
+        threadBuffer->buffer = { 0 };
+        threadBuffer->buffer.length = Spall_BufferSize;
+        threadBuffer->buffer.data   = malloc(Spall_BufferSize);
+        spall_buffer_init(&spallCtx, &threadBuffer->buffer);
+        
+        threadBuffer->tid     = OS_GetThreadId();
+        threadBuffer->initted = true;
+    }
+    
+    return threadBuffer;
+}
+
+void QuitSpallThread()
+{
+    Spall_ThreadBuffer* threadBuffer = &spallThreadBuffer;
+    if(!threadBuffer->initted) return;
+    
+    spall_buffer_quit(&spallCtx, &threadBuffer->buffer);
+    free(threadBuffer->buffer.data);
+    threadBuffer->initted = false;
+}
+
+void Spall_Begin(char* name, int64 nameLength)
+{
+    Spall_ThreadBuffer* threadBuffer = Spall_GetThreadBuffer();
+    spall_buffer_begin_ex(&spallCtx, &threadBuffer->buffer, name, nameLength,
+                          (double)__rdtsc(), threadBuffer->tid, spallPid);
+}
+
+void Spall_BeginArgs(char* name, int64 nameLength, char* args, int64 argsLength)
+{
+    Spall_ThreadBuffer* threadBuffer = Spall_GetThreadBuffer();
+    spall_buffer_begin_args(&spallCtx, &threadBuffer->buffer, name, nameLength, args, argsLength,
+                            (double)__rdtsc(), threadBuffer->tid, spallPid);
+}
+
+void Spall_End()
+{
+    Spall_ThreadBuffer* threadBuffer = Spall_GetThreadBuffer();
+    spall_buffer_end_ex(&spallCtx, &threadBuffer->buffer, (double)__rdtsc(), threadBuffer->tid, spallPid);
+}
+
 ProfileFuncGuard::ProfileFuncGuard(char* funcName, uint64 stringLength)
 {
-    spall_buffer_begin(&spallCtx, &spallBuffer, funcName, stringLength, (double)__rdtsc());
+    Spall_Begin(funcName, stringLength);
+}
+
+ProfileFuncGuard::ProfileFuncGuard(String name, String args)
+{
+    Spall_BeginArgs(name.ptr, name.length, args.ptr, args.length);
 }
 
 ProfileFuncGuard::~ProfileFuncGuard()
 {
-    spall_buffer_end(&spallCtx, &spallBuffer, (double)__rdtsc());
+    Spall_End();
 }
 
 #endif  /* Profile */
\ No newline at end of file
@@ -91,11 +91,119 @@ typedef uintptr_t uintptr;
 #include "os/os_agnostic.h"
 #include "memory_management.h"
 
+// Atomics
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#if defined(_M_X64) || defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+// Returns the incremented value
+inline uint32 AtomicIncrement32(volatile uint32* val)
+{
+#ifdef _MSC_VER
+    return (uint32)_InterlockedIncrement((volatile long*)val);
+#else
+    return __atomic_add_fetch(val, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Returns the decremented value
+inline uint32 AtomicDecrement32(volatile uint32* val)
+{
+#ifdef _MSC_VER
+    return (uint32)_InterlockedDecrement((volatile long*)val);
+#else
+    return __atomic_sub_fetch(val, 1, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Returns the value after the addition
+inline uint32 AtomicAdd32(volatile uint32* val, uint32 toAdd)
+{
+#ifdef _MSC_VER
+    return (uint32)_InterlockedExchangeAdd((volatile long*)val, (long)toAdd) + toAdd;
+#else
+    return __atomic_add_fetch(val, toAdd, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Returns true if the exchange happened
+inline bool AtomicCompareExchange32(volatile uint32* val, uint32 expected, uint32 desired)
+{
+#ifdef _MSC_VER
+    return (uint32)_InterlockedCompareExchange((volatile long*)val, (long)desired, (long)expected) == expected;
+#else
+    return __atomic_compare_exchange_n(val, &expected, desired, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+#endif
+}
+
+inline uint32 AtomicLoadAcquire32(volatile uint32* val)
+{
+#ifdef _MSC_VER
+    return *val;  // Volatile reads have acquire semantics with MSVC
+#else
+    return __atomic_load_n(val, __ATOMIC_ACQUIRE);
+#endif
+}
+
+inline void AtomicStoreRelease32(volatile uint32* val, uint32 newVal)
+{
+#ifdef _MSC_VER
+    _InterlockedExchange((volatile long*)val, (long)newVal);
+#else
+    __atomic_store_n(val, newVal, __ATOMIC_RELEASE);
+#endif
+}
+
+// Index of the lowest set bit, the mask can't be 0
+inline uint32 LowestSetBit(uint32 mask)
+{
+#ifdef _MSC_VER
+    unsigned long idx;
+    _BitScanForward(&idx, mask);
+    return (uint32)idx;
+#else
+    return (uint32)__builtin_ctz(mask);
+#endif
+}
+
+inline void CpuPause()
+{
+#if defined(_M_X64) || defined(__x86_64__)
+    _mm_pause();
+#endif
+}
+
+// Only meant for very short critical sections
+struct Spinlock
+{
+    volatile uint32 locked = 0;
+};
+
+inline void Spinlock_Lock(Spinlock* lock)
+{
+    while(!AtomicCompareExchange32(&lock->locked, 0, 1))
+    {
+        while(lock->locked) CpuPause();
+    }
+}
+
+inline void Spinlock_Unlock(Spinlock* lock)
+{
+    AtomicStoreRelease32(&lock->locked, 0);
+}
+
 // Thread context
 #define ThreadCtx_NumScratchArenas 4
 struct ThreadContext
 {
     Arena scratchPool[ThreadCtx_NumScratchArenas];
+    
+    // Index of the job system worker running on
+    // this thread (0 is the main thread)
+    uint32 workerIdx = 0;
 };
 
 void ThreadCtx_Init(ThreadContext* threadCtx, size_t scratchReserveSize, size_t scratchCommitSize);
@@ -104,25 +212,43 @@ Arena* GetScratchArena(ThreadContext* threadCtx, Arena** conflictArray, int coun
 #ifdef Profile
 #include "spall/spall.h"
 
+// NOTE: Each thread writes to its own buffer, which is only
+// allocated the first time the thread records an event, and which
+// is written to the file whenever it's full. All events are tagged
+// with the thread id, so parallel stages show up as separate tracks.
+#define Spall_BufferSize MB(4)
+
 static SpallProfile spallCtx;
-static SpallBuffer spallBuffer;
 
 void InitSpall();
 void QuitSpall();
+// Flushes and frees the buffer of the calling thread,
+// every thread which recorded events has to call this before exiting
+void QuitSpallThread();
+
+void Spall_Begin(char* name, int64 nameLength);
+void Spall_BeginArgs(char* name, int64 nameLength, char* args, int64 argsLength);
+void Spall_End();
 
 #define ProfileFunc(guardName)  ProfileFuncGuard guardName(__FUNCTION__, sizeof(__FUNCTION__));
 #define ProfileBlock(guardName, blockName) ProfileFuncGuard guardName(blockName, sizeof(blockName));
+// Zone with a name only known at runtime (e.g. an entity), and
+// additional information shown next to it; both are Strings
+#define ProfileBlockArgs(guardName, name, args) ProfileFuncGuard guardName(name, args);
 
+struct String;
 struct ProfileFuncGuard
 {
     ProfileFuncGuard() = delete;
     ProfileFuncGuard(char* funcName, uint64 stringLength);
+    ProfileFuncGuard(String name, String args);
     ~ProfileFuncGuard();
 };
 
 #else
 #define ProfileFunc(guardName)
 #define ProfileBlock(guardName, blockName)
+#define ProfileBlockArgs(guardName, name, args)
 #endif  /* Profile */
 
 // Generic data structures
@@ -151,6 +277,46 @@ struct Slice
 #endif
 };
 
+// Arena-backed growable array. The capacity doubles on growth, so appends
+// are amortized O(1). Unlike Slice::Append, the array doesn't need to be the
+// last allocation performed in the arena: if it isn't, the elements are moved
+// to a new allocation and the old one is simply left behind in the arena.
+#define ArenaArray_MinCapacity 16
+template<typename t>
+struct ArenaArray : public Slice<t>
+{
+    int64 capacity = 0;
+    
+    void Append(Arena* a, t element);
+    void Reserve(Arena* a, int64 newCapacity);
+    // Gives back the unused capacity, if this is the last allocation
+    void ShrinkToFit(Arena* a);
+};
+
+// Arena-backed array stored as a list of chunks, each one twice as big
+// as the previous. Elements never move, so pointers to them stay valid
+// and appending never copies, no matter what else is allocated in the
+// arena. Use CopyToArena to get the contiguous version once it's done.
+#define ChunkedArray_MinChunkSize 64
+template<typename t>
+struct ChunkedArray
+{
+    struct Chunk
+    {
+        Chunk* next;
+        t* ptr;
+        int64 length;
+        int64 capacity;
+    };
+    
+    Chunk* firstChunk = 0;
+    Chunk* lastChunk  = 0;
+    int64 length = 0;
+    
+    void Append(Arena* a, t element);
+    Slice<t> CopyToArena(Arena* to);
+};
+
 #define for_array(loopVar, array) for(int loopVar = 0; loopVar < (array).length; ++loopVar)
 
 // Used for dynamic arrays with unknown/variable lifetimes
@@ -209,7 +375,12 @@ struct String
 #endif
 };
 
-struct HashedString
+// Unique id of an interned string (see atom.h), 0 is not a valid atom
+typedef uint32 Atom;
+
+// String which was interned, so that comparisons are
+// just an integer compare.
+struct InternedString
 {
     union
     {
@@ -221,7 +392,7 @@ struct HashedString
         String str;
     };
     
-    int64 hash;
+    Atom atom;
     
 #ifdef BoundsChecking
     // For reading the value
@@ -235,67 +406,109 @@ struct HashedString
 // Hash function from the stb library. Could be better but it's fine for now
 uint64 HashString(String str, uint64 seed = 0x31415926);
 uint64 HashString(char* str, uint64 seed = 0x31415926);
+// Identifies the layout of structures which are stored as they are in memory
+// (e.g. in a file), it changes whenever one of the sizes changes
+uint32 LayoutIdOf(Slice<uint64> sizes);
+
+// NOTE: The hash tables below are open addressing tables in the style of
+// Google's "Swiss tables". Each slot has a control byte, stored in a separate
+// array: it's either empty, deleted (tombstone), or it contains the lower 7
+// bits of the hash of the key in that slot. Lookups compare the control bytes
+// of a whole group of slots at once (with SSE2 where available), and only
+// touch the keys whose control byte matches. Groups are probed quadratically,
+// and capacities are always powers of 2 so the modulo is just a mask.
+// Keys are not unique: Add never overwrites, and GetFirst/GetNext can be
+// used to iterate over all values with the same key.
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define HashTable_SSE2
+#endif
 
-// Generic hash table structure for 64 bit keys, for when you want a quick performance boost
+#define HashTable_GroupSize 16
+#define HashTable_MinCapacity HashTable_GroupSize
 
-template<typename k, typename v>
-struct HashTableEntry
+enum HashTable_CtrlEnum
+{
+    HashTable_Empty   = 0x80,
+    HashTable_Deleted = 0xFE,
+    // Anything with the upper bit not set is a full slot
+};
+
+float HashTable_LoadFactor = 0.875f;
+
+// Bitmasks of the slots in a group
+uint32 HashTable_MatchByte(uint8* group, uint8 b);
+uint32 HashTable_MatchEmpty(uint8* group);
+uint32 HashTable_MatchEmptyOrDeleted(uint8* group);
+uint32 HashTable_FirstBit(uint32 mask);
+uint32 HashTable_RoundCapacity(uint32 capacity);
+
+// Used to iterate over all values with the same key
+template<typename k>
+struct HashTableCursor
 {
-    static_assert(sizeof(k) == 8, "Key must be 64 bits");
-    
     k key;
-    v val;
-    bool occupied;
+    uint32 group;
+    uint32 step;
+    uint32 matches;
+    uint8 h2;
 };
 
-float HashTable_LoadFactor = 0.5f;
+// Generic hash table structure for 64 bit keys, for when you want a quick performance boost
 template<typename k, typename v>
 struct HashTable
 {
-    HashTableEntry<k, v>* entries = 0;
-    uint32 count;
-    uint32 capacity;
+    static_assert(sizeof(k) == 8, "Key must be 64 bits");
+    
+    // Structure of arrays, so that probing only
+    // touches the control bytes
+    uint8* ctrl = 0;
+    k* keys = 0;
+    v* vals = 0;
+    uint32 count = 0;
+    uint32 tombstones = 0;
+    uint32 capacity = 0;
     
     void Init(uint32 capacity);
     // From odin-lang's PtrMap hash
     uint32 HashFunction(uintptr key);
     v* Get(k key);
+    v* GetFirst(k key, HashTableCursor<k>* cursor);
+    v* GetNext(HashTableCursor<k>* cursor);
     void Add(k key, v val);
+    bool Remove(k key);
     void Grow(uint32 newSize);
     void Free();
 };
 
-uint32 HashTable_ProbingScheme(uint32 hash, uint32 iter, uint32 length);
+uint32 HashTable_ProbingScheme(uint32 group, uint32 step, uint32 numGroups);
 
 // Hash table built for string keys. Strings are not copied, allocated or freed
 // so the management of the strings themselves is up to the user.
-
-template<typename v>
-struct StringTableEntry
-{
-    String key;
-    v val;
-    bool occupied;
-};
-
 template<typename v>
 struct StringTable
 {
-    StringTableEntry<v>* entries = 0;
-    uint32 count;
-    uint32 capacity;
+    uint8* ctrl = 0;
+    String* keys = 0;
+    v* vals = 0;
+    // Stored so that growing doesn't need to rehash the strings
+    uint32* hashes = 0;
+    uint32 count = 0;
+    uint32 tombstones = 0;
+    uint32 capacity = 0;
     
     void Init(uint32 capacity);
-    uint64 HashFunction(String key);
+    uint32 HashFunction(String key);
     v* Get(String key);
-    void AllocString();
     void Add(String key, v val);
+    // Variants for when the hash was already computed
+    v* Get(String key, uint32 hash);
+    void Add(String key, uint32 hash, v val);
+    bool Remove(String key);
     void Grow(uint32 newSize);
     void Free();
 };
 
-uint32 StringTable_ProbingScheme(uint32 hash, uint32 iter, uint32 length);
-
 // Math utilities
 inline bool IsPowerOf2(uintptr a)
 {
@@ -313,10 +526,6 @@ cforceinline t clamp(t val, t minVal, t maxVal) { return val < minVal ? minVal :
 
 int numDigits(int n);
 
-// I/O utilities
-size_t GetFileSize(FILE* file);
-char* ReadEntireFileIntoMemoryAndNullTerminate(char* fileName);
-
 // String utilities
 
 // Very simple implementation of StringBuilder. Uses linear arenas,
@@ -344,6 +553,8 @@ struct StringBuilder
 bool operator ==(String s1, String s2);
 bool operator ==(char* s1, String s2);
 bool operator ==(String s1, char* s2);
+inline bool operator ==(InternedString s1, InternedString s2);
+inline bool operator !=(InternedString s1, InternedString s2);
 
 bool StringBeginsWith(char* stream, String str);
 bool StringBeginsWith(char* stream, char* str);
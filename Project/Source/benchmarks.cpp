@@ -0,0 +1,531 @@
+
+#include "benchmarks.h"
+#include "memory_management.h"
+#include "os/os_agnostic.h"
+#include "lexer.h"
+#include "parser.h"
+#include "semantics.h"
+#include "dependency_graph.h"
+#include "interpreter.h"
+#include "job_system.h"
+#include "tilde_codegen.h"
+#include "compile_stats.h"
+#include "perf_regress.h"
+
+void Bench_RunAll()
+{
+    printf("----- Benchmarks -----\n");
+    Bench_Arena();
+    Bench_ArenaAppend();
+    Bench_HugePages();
+    Bench_HashTable();
+    Bench_StringTable();
+    Bench_ScopeLookup();
+    Bench_JobSystem();
+    Bench_CompileThroughput();
+    printf("----------------------\n");
+}
+
+double Bench_Seconds(uint64 ticks)
+{
+    return 1.0 / GetRdtscFreq() * ticks;
+}
+
+void Bench_PrintRate(char* name, uint64 count, uint64 ticks)
+{
+    double seconds = Bench_Seconds(ticks);
+    printf("    %-24s %8.2f Mops/s  %6.2fns/op\n", name, count / seconds / 1e6, seconds / count * 1e9);
+}
+
+void Bench_Arena()
+{
+    printf("Arena allocation:\n");
+    
+    // Everything fits in the first block
+    Bench_ArenaPass("1GB reserve", GB(1), GB(1) - MB(2));
+    // Same amount of memory, but it needs to chain 16 blocks
+    Bench_ArenaPass("64MB reserve, chained", MB(64), GB(1) - MB(2));
+}
+
+// Fills the arena with small allocations of varying size, writing to
+// each of them (so that commits are actually paid for), then frees
+// everything and does it again with memory which is already committed.
+void Bench_ArenaPass(char* name, size_t reserveSize, size_t totalSize)
+{
+    Arena arena = Arena_VirtualMemInit(reserveSize, MB(2));
+    defer(Arena_Free(&arena));
+    
+    for(int pass = 0; pass < 2; ++pass)
+    {
+        uint64 numAllocs = 0;
+        size_t allocated = 0;
+        uint32 rng = 0x9E3779B9;
+        
+        uint64 start = __rdtsc();
+        while(allocated < totalSize)
+        {
+            // Xorshift, allocation sizes in [8, 256]
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            size_t size = 8 + (rng & 0xF8);
+            
+            auto ptr = (uchar*)Arena_Alloc(&arena, size);
+            ptr[0] = (uchar)size;
+            
+            allocated += size;
+            ++numAllocs;
+        }
+        
+        double seconds = Bench_Seconds(__rdtsc() - start);
+        printf("    %-24s %-6s %8.2f Mallocs/s  %6.2f GB/s\n", name, pass == 0 ? "cold" : "warm",
+               numAllocs / seconds / 1e6, allocated / seconds / GB(1));
+        
+        Arena_FreeAll(&arena);
+    }
+}
+
+// Appends to growable arrays while something else is also being
+// allocated in the same arena, which is what happens when building
+// the list of top level nodes while parsing.
+void Bench_ArenaAppend()
+{
+    printf("Arena appends (interleaved allocations):\n");
+    
+    const int numElements = 1 << 20;
+    Arena arena = Arena_VirtualMemInit(GB(1), MB(2));
+    defer(Arena_Free(&arena));
+    
+    {
+        ArenaArray<uint64> array;
+        uint64 start = __rdtsc();
+        for(int i = 0; i < numElements; ++i)
+        {
+            array.Append(&arena, i);
+            if((i & 63) == 0) Arena_Alloc(&arena, 32);
+        }
+        
+        Bench_PrintRate("ArenaArray", numElements, __rdtsc() - start);
+        Arena_FreeAll(&arena);
+    }
+    
+    {
+        ChunkedArray<uint64> array;
+        uint64 start = __rdtsc();
+        for(int i = 0; i < numElements; ++i)
+        {
+            array.Append(&arena, i);
+            if((i & 63) == 0) Arena_Alloc(&arena, 32);
+        }
+        
+        Slice<uint64> flat = array.CopyToArena(&arena);
+        Bench_PrintRate("ChunkedArray (+ flatten)", numElements, __rdtsc() - start);
+        Assert(flat.length == numElements && flat[numElements-1] == numElements-1);
+        Arena_FreeAll(&arena);
+    }
+}
+
+void Bench_HugePages()
+{
+    printf("Random walk over 512MB of arena memory:\n");
+    Bench_ArenaWalk("Regular pages", false);
+    Bench_ArenaWalk("Huge pages", true);
+}
+
+// Links the nodes of a big array in a random cycle and follows it,
+// which is TLB bound, similar to walking the AST in the typechecker.
+void Bench_ArenaWalk(char* name, bool hugePages)
+{
+    struct Node
+    {
+        Node* next;
+        uint64 payload[7];
+    };
+    
+    Arena_EnableHugePages(hugePages);
+    Arena arena = Arena_VirtualMemInit(GB(1), MB(2));
+    Arena_EnableHugePages(false);
+    defer(Arena_Free(&arena));
+    
+    const uint32 numNodes = MB(512) / sizeof(Node);
+    const uint32 numSteps = 1 << 24;
+    
+    // Sattolo's algorithm, produces a single cycle
+    uint32* order = (uint32*)malloc(sizeof(uint32) * numNodes);
+    defer(free(order));
+    for(uint32 i = 0; i < numNodes; ++i)
+        order[i] = i;
+    
+    uint64 rng = 0x9E3779B97F4A7C15;
+    for(uint32 i = numNodes - 1; i > 0; --i)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        uint32 j = (uint32)(rng % i);
+        Swap(uint32, order[i], order[j]);
+    }
+    
+    uint64 start = __rdtsc();
+    Node* nodes = Arena_AllocArray(&arena, numNodes, Node);
+    for(uint32 i = 0; i < numNodes; ++i)
+    {
+        Node* node = &nodes[order[i]];
+        node->next = &nodes[order[(i + 1) % numNodes]];
+        node->payload[0] = i;
+    }
+    
+    double fillSeconds = Bench_Seconds(__rdtsc() - start);
+    
+    start = __rdtsc();
+    Node* node = &nodes[0];
+    uint64 sum = 0;
+    for(uint32 i = 0; i < numSteps; ++i)
+    {
+        sum += node->payload[0];
+        node = node->next;
+    }
+    
+    double walkSeconds = Bench_Seconds(__rdtsc() - start);
+    printf("    %-24s fill: %6.3fs  walk: %6.2fns/node  (%llu)\n", name, fillSeconds,
+           walkSeconds / numSteps * 1e9, (unsigned long long)(sum & 0xFF));
+}
+
+// Keys are random, like the hashes used as keys for the declaration tables
+void Bench_HashTable()
+{
+    printf("HashTable<int64, int64> (1M keys):\n");
+    
+    const uint32 numKeys = 1 << 20;
+    int64* keys   = (int64*)malloc(sizeof(int64) * numKeys);
+    int64* misses = (int64*)malloc(sizeof(int64) * numKeys);
+    defer({ free(keys); free(misses); });
+    
+    uint64 rng = 0x9E3779B97F4A7C15;
+    for(uint32 i = 0; i < numKeys; ++i)
+    {
+        rng ^= rng << 13;
+        rng ^= rng >> 7;
+        rng ^= rng << 17;
+        keys[i] = (int64)rng;
+        misses[i] = (int64)(rng ^ 0x5555555555555555);
+    }
+    
+    HashTable<int64, int64> table;
+    table.Init(HashTable_MinCapacity);
+    defer(table.Free());
+    
+    uint64 start = __rdtsc();
+    for(uint32 i = 0; i < numKeys; ++i)
+        table.Add(keys[i], i);
+    Bench_PrintRate("Insert (with growth)", numKeys, __rdtsc() - start);
+    
+    int64 found = 0;
+    start = __rdtsc();
+    for(uint32 i = 0; i < numKeys; ++i)
+        found += table.Get(keys[i]) != 0;
+    Bench_PrintRate("Lookup (hit)", numKeys, __rdtsc() - start);
+    
+    start = __rdtsc();
+    for(uint32 i = 0; i < numKeys; ++i)
+        found += table.Get(misses[i]) != 0;
+    Bench_PrintRate("Lookup (miss)", numKeys, __rdtsc() - start);
+    
+    start = __rdtsc();
+    for(uint32 i = 0; i < numKeys; i += 2)
+        table.Remove(keys[i]);
+    Bench_PrintRate("Remove", numKeys / 2, __rdtsc() - start);
+    
+    start = __rdtsc();
+    for(uint32 i = 0; i < numKeys; ++i)
+        found += table.Get(keys[i]) != 0;
+    Bench_PrintRate("Lookup (after remove)", numKeys, __rdtsc() - start);
+    
+    // Expected: numKeys + numKeys / 2
+    if(found != numKeys + numKeys / 2)
+        printf("    Unexpected number of hits: %lld\n", (long long)found);
+}
+
+void Bench_StringTable()
+{
+    printf("StringTable<int64> (1M keys):\n");
+    
+    const uint32 numKeys = 1 << 20;
+    Arena arena = Arena_VirtualMemInit(GB(1), MB(2));
+    defer(Arena_Free(&arena));
+    
+    String* keys   = Arena_AllocArray(&arena, numKeys, String);
+    String* misses = Arena_AllocArray(&arena, numKeys, String);
+    for(uint32 i = 0; i < numKeys; ++i)
+    {
+        char buf[64];
+        int len = snprintf(buf, sizeof(buf), "identifier_%u", i);
+        keys[i] = { (char*)Arena_AllocAndCopy(&arena, buf, len, 1), len };
+        len = snprintf(buf, sizeof(buf), "missing_%u", i);
+        misses[i] = { (char*)Arena_AllocAndCopy(&arena, buf, len, 1), len };
+    }
+    
+    StringTable<int64> table;
+    table.Init(HashTable_MinCapacity);
+    defer(table.Free());
+    
+    uint64 start = __rdtsc();
+    for(uint32 i = 0; i < numKeys; ++i)
+        table.Add(keys[i], i);
+    Bench_PrintRate("Insert (with growth)", numKeys, __rdtsc() - start);
+    
+    int64 found = 0;
+    start = __rdtsc();
+    for(uint32 i = 0; i < numKeys; ++i)
+        found += table.Get(keys[i]) != 0;
+    Bench_PrintRate("Lookup (hit)", numKeys, __rdtsc() - start);
+    
+    start = __rdtsc();
+    for(uint32 i = 0; i < numKeys; ++i)
+        found += table.Get(misses[i]) != 0;
+    Bench_PrintRate("Lookup (miss)", numKeys, __rdtsc() - start);
+    
+    if(found != numKeys)
+        printf("    Unexpected number of hits: %lld\n", (long long)found);
+}
+
+// Identifier resolution in deeply nested scopes. The cost per
+// identifier should stay flat as the depth increases.
+void Bench_ScopeLookup()
+{
+    printf("Frontend on nested scopes (lex + parse + typecheck + bytecode):\n");
+    Bench_ScopeLookupDepth(8, 512);
+    Bench_ScopeLookupDepth(64, 64);
+    Bench_ScopeLookupDepth(256, 16);
+}
+
+void Bench_ScopeLookupDepth(int depth, int numProcs)
+{
+    Arena srcArena = Arena_VirtualMemInit(GB(1), MB(2));
+    Arena astArena = Arena_VirtualMemInit(GB(1), MB(2));
+    Arena internArena = Arena_VirtualMemInit(GB(1), MB(2));
+    Arena entityArena = Arena_VirtualMemInit(GB(1), MB(2));
+    defer({
+              Arena_Free(&astArena);
+              Arena_Free(&internArena);
+              Arena_Free(&entityArena);
+              Ast_ResetPools();
+              
+              // The atoms of the identifiers point into the source
+              Atom_ResetTable();
+              Arena_Free(&srcArena);
+          });
+    
+    String src = Bench_GenNestedScopes(&srcArena, depth, numProcs);
+    
+    uint64 start = __rdtsc();
+    Tokenizer tokenizer = InitTokenizer(&astArena, &internArena, src.ptr, StrLit("bench.ryu"));
+    Parser parser = { &astArena, &tokenizer };
+    parser.entityArena = &entityArena;
+    
+    LexFile(&tokenizer);
+    Ast_FileScope* fileAst = ParseFile(&parser);
+    if(!parser.status)
+    {
+        printf("    Depth %d: there were syntax errors!\n", depth);
+        return;
+    }
+    
+    Interp interp;
+    bool status = MainDriver(&parser, &interp, fileAst);
+    uint64 ticks = __rdtsc() - start;
+    if(!status)
+    {
+        printf("    Depth %d: there were semantic errors!\n", depth);
+        return;
+    }
+    
+    // Each level references two variables
+    uint64 numIdents = (uint64)numProcs * depth * 2;
+    double seconds = Bench_Seconds(ticks);
+    printf("    Depth %-4d %8.3fs  %8.2fns/identifier\n", depth, seconds, seconds / numIdents * 1e9);
+}
+
+// Each level declares a variable which refers to the outermost
+// one and to the one in the enclosing scope, e.g.:
+// proc f0(int a)->int
+// {
+//     int v0 = a;
+//     { int v1 = v0 + v0; { int v2 = v0 + v1; ... } }
+//     return v0;
+// }
+String Bench_GenNestedScopes(Arena* arena, int depth, int numProcs)
+{
+    StringBuilder builder(arena);
+    char buf[128];
+    
+    for(int p = 0; p < numProcs; ++p)
+    {
+        snprintf(buf, sizeof(buf), "proc f%d(int a)->int\n{\nint v0 = a;\n", p);
+        builder.Append(buf);
+        
+        for(int i = 1; i <= depth; ++i)
+        {
+            snprintf(buf, sizeof(buf), "{\nint v%d = v0 + v%d;\n", i, i - 1);
+            builder.Append(buf);
+        }
+        
+        for(int i = 1; i <= depth; ++i)
+            builder.Append("}\n");
+        
+        builder.Append("return v0;\n}\n\n");
+    }
+    
+    builder.Append('\0');
+    return builder.string;
+}
+
+// Sums over a big array, with a bit of work per element
+// so that the parallel version isn't just memory bound
+static void Bench_SumRange(int64 start, int64 end, void* userData)
+{
+    auto values = (Slice<uint64>*)userData;
+    uint64 sum = 0;
+    for(int64 i = start; i < end; ++i)
+    {
+        uint64 v = (*values)[i];
+        sum += (v * 0x9E3779B97F4A7C15) >> 32;
+    }
+    
+    (*values)[start] = sum;
+}
+
+static void Bench_GraphTask(void* userData)
+{
+    AtomicAdd32((volatile uint32*)userData, 1);
+}
+
+void Bench_JobSystem()
+{
+    printf("Job system (%d threads):\n", jobSystem.numWorkers);
+    
+    const int64 numElements = 1 << 24;
+    const int64 batchSize   = 1 << 14;
+    Arena arena = Arena_VirtualMemInit(GB(1), MB(2));
+    defer(Arena_Free(&arena));
+    
+    Slice<uint64> values = { Arena_AllocArrayPack(&arena, numElements, uint64), numElements };
+    
+    {
+        for(int64 i = 0; i < numElements; ++i) values[i] = i;
+        uint64 start = __rdtsc();
+        for(int64 i = 0; i < numElements; i += batchSize)
+            Bench_SumRange(i, min(numElements, i + batchSize), &values);
+        
+        Bench_PrintRate("Serial for", numElements, __rdtsc() - start);
+    }
+    
+    {
+        for(int64 i = 0; i < numElements; ++i) values[i] = i;
+        uint64 start = __rdtsc();
+        Job_ParallelFor(numElements, batchSize, Bench_SumRange, &values);
+        Bench_PrintRate("Job_ParallelFor", numElements, __rdtsc() - start);
+    }
+    
+    // Wide graph with a diamond shape: one root, many
+    // independent tasks in the middle, one sink
+    {
+        const uint32 numTasks = 1 << 14;
+        volatile uint32 counter = 0;
+        
+        uint64 start = __rdtsc();
+        Job_TaskGraph graph = Job_MakeGraph(&arena);
+        uint32 root = Job_AddTask(&graph, Bench_GraphTask, (void*)&counter);
+        uint32 sink = Job_AddTask(&graph, Bench_GraphTask, (void*)&counter);
+        for(uint32 i = 0; i < numTasks; ++i)
+        {
+            uint32 task = Job_AddTask(&graph, Bench_GraphTask, (void*)&counter);
+            Job_AddDependency(&graph, task, root);
+            Job_AddDependency(&graph, sink, task);
+        }
+        
+        Job_RunGraph(&graph);
+        Bench_PrintRate("Job_RunGraph", numTasks + 2, __rdtsc() - start);
+        Assert(counter == numTasks + 2);
+    }
+}
+
+// Runs the whole pipeline (except for the linker) on synthetic programs,
+// each one stressing a different part of the compiler
+void Bench_CompileThroughput()
+{
+    printf("Compile throughput (no linking):\n");
+    printf("    %-22s %8s %9s  %-10s %14s %14s\n", "", "Lines", "Tokens", "Phase", "Lines/s", "Tokens/s");
+    
+    Corpus_Params params;
+    params.numProcs = 2000;
+    Bench_CompileCorpus("Many procedures", params);
+    
+    params = {};
+    params.structDepth = 64;
+    Bench_CompileCorpus("Deep structs", params);
+    
+    params = {};
+    params.declChainLength = 200;
+    Bench_CompileCorpus("Long decl chains", params);
+    
+    params = {};
+    params.numProcs   = 20;
+    params.exprLength = Corpus_MaxExprLength;
+    Bench_CompileCorpus("Long expressions", params);
+    
+    params = {};
+    params.switchCases = 512;
+    Bench_CompileCorpus("Big switches", params);
+    
+    params = {};
+    params.nestingDepth = 64;
+    Bench_CompileCorpus("Deep nesting", params);
+}
+
+void Bench_CompileCorpus(char* name, Corpus_Params params)
+{
+    Arena srcArena = Arena_VirtualMemInit(GB(1), MB(2));
+    defer({
+              // Perf_Compile interns the identifiers of the source
+              Atom_ResetTable();
+              Arena_Free(&srcArena);
+          });
+    
+    String src = Corpus_Generate(&srcArena, params);
+    uint64 numLines = 0;
+    for(int64 i = 0; i < src.length; ++i)
+        numLines += src[i] == '\n';
+    
+    if(!Perf_Compile(src, StrLit("corpus.ryu")))
+    {
+        printf("    %s: there were errors!\n", name);
+        return;
+    }
+    
+    struct Phase
+    {
+        char* name;
+        double seconds;
+    };
+    
+    Phase phases[] =
+    {
+        { "Frontend", timings.frontend },
+        { "IR Gen",   timings.irGen },
+        { "Backend",  timings.backend },
+        { "Total",    timings.frontend + timings.irGen + timings.backend },
+    };
+    
+    uint64 numTokens = counters.tokens;
+    for(int i = 0; i < StArraySize(phases); ++i)
+    {
+        double seconds = max(phases[i].seconds, 1e-9);
+        if(i == 0)
+            printf("    %-22s %8llu %9llu  ", name, (unsigned long long)numLines, (unsigned long long)numTokens);
+        else
+            printf("    %-22s %8s %9s  ", "", "", "");
+        
+        printf("%-10s %14.0f %14.0f\n", phases[i].name, numLines / seconds, numTokens / seconds);
+    }
+}
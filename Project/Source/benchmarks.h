@@ -0,0 +1,31 @@
+
+#pragma once
+
+#include "base.h"
+#include "corpus_gen.h"
+
+// NOTE: Microbenchmarks for the core data structures and
+// allocators, run with the "-bench" command line argument. These
+// are used to check that changes to the hot paths are actually
+// improvements, they're not needed for compilation.
+
+// Runs all benchmarks and prints the results
+void Bench_RunAll();
+
+void Bench_Arena();
+void Bench_ArenaPass(char* name, size_t reserveSize, size_t totalSize);
+void Bench_ArenaAppend();
+void Bench_HugePages();
+void Bench_ArenaWalk(char* name, bool hugePages);
+void Bench_HashTable();
+void Bench_StringTable();
+void Bench_PrintRate(char* name, uint64 count, uint64 ticks);
+void Bench_ScopeLookup();
+void Bench_JobSystem();
+void Bench_CompileThroughput();
+void Bench_CompileCorpus(char* name, Corpus_Params params);
+void Bench_ScopeLookupDepth(int depth, int numProcs);
+String Bench_GenNestedScopes(Arena* arena, int depth, int numProcs);
+
+// Converts rdtsc ticks to seconds
+double Bench_Seconds(uint64 ticks);
@@ -195,6 +195,12 @@ void Interp_InsertInstrAtMiddle(Interp_Builder* builder, Interp_Instr instr, Ins
             ++instr.branch.defaultCase;
     }
     
+    for_array(i, builder->tailCalls)
+    {
+        if(builder->tailCalls[i].retInstr >= idx)
+            ++builder->tailCalls[i].retInstr;
+    }
+    
     for(int i = idx; i < proc->instrs.length - 1; ++i)
     {
         ++builder->instrOffsets[i];
@@ -455,9 +461,16 @@ void Interp_MemCpy(Interp_Builder* builder, RegIdx dst, RegIdx src, RegIdx count
     newElement->memcpy.align = align;
 }
 
-RegIdx Interp_ArrayAccess(Interp_Builder* builder)
+RegIdx Interp_ArrayAccess(Interp_Builder* builder, RegIdx base, RegIdx idx, uint64 stride)
 {
-    return RegIdx_Unused;
+    auto newElement = Interp_InsertInstr(builder);
+    newElement->op            = Op_ArrayAccess;
+    newElement->dst           = builder->regCounter;
+    newElement->arracc.base   = base;
+    newElement->arracc.idx    = idx;
+    newElement->arracc.stride = stride;
+    Interp_AdvanceReg(builder);
+    return newElement->dst;
 }
 
 RegIdx Interp_MemberAccess(Interp_Builder* builder, RegIdx base, int64 offset)
@@ -483,9 +496,16 @@ RegIdx Interp_GetSymbolAddress(Interp_Builder* builder, SymIdx symbol)
     return newElement->dst;
 }
 
-void Interp_Select(Interp_Builder* builder)
+RegIdx Interp_Select(Interp_Builder* builder, RegIdx cond, RegIdx a, RegIdx b)
 {
-    
+    auto newElement = Interp_InsertInstr(builder);
+    newElement->op       = Op_Select;
+    newElement->dst      = builder->regCounter;
+    newElement->sel.cond = cond;
+    newElement->sel.a    = a;
+    newElement->sel.b    = b;
+    Interp_AdvanceReg(builder);
+    return newElement->dst;
 }
 
 // @incomplete
@@ -776,20 +796,78 @@ void Interp_PatchGoto(Interp_Builder* builder, InstrIdx gotoInstr, InstrIdx targ
     instr.branch.defaultCase = target;
 }
 
+// NOTE: The values and regions slices are sorted in place
 void Interp_PatchBranch(Interp_Builder* builder, InstrIdx branchInstr, Slice<int64> values, Slice<InstrIdx> regions, InstrIdx defaultRegion)
 {
-    uint32 instrIdx = Interp_AllocateInstrIdxArray(builder, regions);
-    int64 val = 0;
-    uint32 valIdx = Interp_AllocateConstArray(builder, values);
+    Assert(values.length == regions.length);
     
     auto& instr = builder->proc->instrs[branchInstr];
     instr.op = Op_Branch;
     instr.branch.defaultCase = defaultRegion;
+    instr.bitfield &= ~(InstrBF_JumpTable | InstrBF_BinarySearch);
+    
+    // Sort the keys, so that the branch can be dispatched
+    // using either a jump table or a binary search
+    {
+        int64 tmpVal;
+        InstrIdx tmpRegion;
+#define Tmp_Less(i, j) values[i] < values[j]
+#define Tmp_Swap(i, j) tmpVal = values[i], values[i] = values[j], values[j] = tmpVal, \
+tmpRegion = regions[i], regions[i] = regions[j], regions[j] = tmpRegion
+        QSORT(values.length, Tmp_Less, Tmp_Swap);
+#undef Tmp_Swap
+#undef Tmp_Less
+    }
+    
+    auto lowering = Interp_ClassifySwitch(values.ptr, values.length);
+    if(lowering == InstrBF_JumpTable)
+    {
+        // Materialize the whole [min, max] range, holes jump to the default case.
+        // This way the keys are still valid for anything that only expects a
+        // list of (key, region) pairs.
+        ScratchArena scratch;
+        int64 minKey = values[0];
+        int64 range  = values[values.length-1] - minKey + 1;
+        
+        Slice<int64> tableKeys = { 0, 0 };
+        Slice<InstrIdx> tableRegions = { 0, 0 };
+        tableKeys.Resize(scratch, range);
+        tableRegions.Resize(scratch, range);
+        for(int i = 0; i < range; ++i)
+        {
+            tableKeys[i] = minKey + i;
+            tableRegions[i] = defaultRegion;
+        }
+        
+        for_array(i, values)
+            tableRegions[values[i] - minKey] = regions[i];
+        
+        values  = tableKeys;
+        regions = tableRegions;
+    }
+    
+    uint32 instrIdx = Interp_AllocateInstrIdxArray(builder, regions);
+    uint32 valIdx = Interp_AllocateConstArray(builder, values);
+    
+    instr.bitfield |= lowering;
     instr.branch.keyStart    = valIdx;
     instr.branch.caseStart   = instrIdx;
     instr.branch.count = regions.length;
 }
 
+// Case density analysis. Expects sorted keys without duplicates.
+InstrBitfield Interp_ClassifySwitch(int64* keys, uint32 count)
+{
+    if(count < Interp_SwitchMinCases) return 0;
+    
+    // Careful with overflow, the keys could be anything
+    uint64 range = (uint64)keys[count-1] - (uint64)keys[0] + 1;
+    bool dense = range != 0 && range <= Interp_JumpTableMaxSize &&
+        range <= (uint64)count * Interp_JumpTableMaxHoles;
+    
+    return dense ? InstrBF_JumpTable : InstrBF_BinarySearch;
+}
+
 // Patch if and else instructions index later
 InstrIdx Interp_If(Interp_Builder* builder, RegIdx value)
 {
@@ -864,7 +942,11 @@ void Interp_PrintInstr(Interp_Proc* proc, Interp_Instr* instr, Slice<Interp_Symb
         case Op_Float64Const: printf("%lf", instr->imm.doubleVal); break;
         case Op_Region:       break;
         case Op_Call:
+        case Op_TailCall:
         {
+            if(instr->bitfield & InstrBF_SelfTailCall)
+                printf("(Self) ");
+            
             printf("%%%d (", instr->call.target);
             
             uint32 start = instr->call.argStart;
@@ -916,6 +998,11 @@ void Interp_PrintInstr(Interp_Proc* proc, Interp_Instr* instr, Slice<Interp_Symb
             }
             else
             {
+                if(instr->bitfield & InstrBF_JumpTable)
+                    printf("(Jump Table) ");
+                else if(instr->bitfield & InstrBF_BinarySearch)
+                    printf("(Binary Search) ");
+                
                 printf("Branch %%%d (", instr->branch.value);
                 auto start = instr->branch.keyStart;
                 auto end = start + instr->branch.count;
@@ -956,7 +1043,7 @@ void Interp_PrintInstr(Interp_Proc* proc, Interp_Instr* instr, Slice<Interp_Symb
         }
         case Op_Local:
         {
-            printf("(idx: %d, size: %d, align: %d)", instr->dst, instr->local.size, instr->local.align);
+            printf("(idx: %d, size: %d, align: %d, offset: %d)", instr->dst, instr->local.size, instr->local.align, instr->local.offset);
             break;
         }
         case Op_GetSymbolAddress:
@@ -978,6 +1065,12 @@ void Interp_PrintInstr(Interp_Proc* proc, Interp_Instr* instr, Slice<Interp_Symb
         }
         case Op_ArrayAccess:
         {
+            printf("(base: %%%d, idx: %%%d, stride: %llu)", instr->arracc.base, instr->arracc.idx, instr->arracc.stride);
+            break;
+        }
+        case Op_Select:
+        {
+            printf("%%%d ? %%%d : %%%d", instr->sel.cond, instr->sel.a, instr->sel.b);
             break;
         }
         
@@ -992,7 +1085,6 @@ void Interp_PrintInstr(Interp_Proc* proc, Interp_Instr* instr, Slice<Interp_Symb
         case Op_Int2Float:
         case Op_Float2Int:
         case Op_Bitcast:
-        case Op_Select:
         case Op_Not:
         case Op_Negate:
         Interp_PrintUnary(instr); break;
@@ -1053,7 +1145,9 @@ void Interp_PrintPassRule(TB_PassingRule rule)
     }
 }
 
-void Interp_PrintProc(Interp_Proc* proc, Slice<Interp_Symbol> syms)
+// If instrCounts is provided, each instruction is annotated
+// with the number of times it was executed
+void Interp_PrintProc(Interp_Proc* proc, Slice<Interp_Symbol> syms, Slice<uint64> instrCounts)
 {
     // Print proc name, etc.
     printf("%.*s:\n", (int)syms[proc->symIdx].name.length, syms[proc->symIdx].name.ptr);
@@ -1082,6 +1176,9 @@ void Interp_PrintProc(Interp_Proc* proc, Slice<Interp_Symbol> syms)
     
     for_array(i, proc->instrs)
     {
+        if(instrCounts.length > 0)
+            printf("%12llu | ", instrCounts[i]);
+        
         int numChars = printf("%d:", counter++);
         for(int i = numChars; i < numSpaces; ++i)
             printf(" ");
@@ -18,6 +18,12 @@ struct Builder_MiddleInsert
     int insertPointOffset = 0;
 };
 
+struct Builder_TailCall
+{
+    InstrIdx retInstr;  // The call is right before it
+    bool isSelf;
+};
+
 struct Interp_Builder
 {
     DepGraph* graph;
@@ -59,6 +65,10 @@ struct Interp_Builder
     Array<Ast_Node*> deferStack;
     int curDeferIdx = 0;
     
+    // Candidates for tail calls, they're only applied
+    // once the whole procedure has been generated
+    Array<Builder_TailCall> tailCalls;
+    
     // NOTE: Used for getting the passing rules for arguments and return values
     TB_Module* module;
     
@@ -70,6 +80,7 @@ struct Interp_Builder
         breaks.FreeAll();
         continues.FreeAll();
         fallthroughs.FreeAll();
+        tailCalls.FreeAll();
     }
 };
 
@@ -111,10 +122,10 @@ RegIdx Interp_ImmFloat64(Interp_Builder* builder, Interp_Type type, double imm);
 void Interp_MemSet(Interp_Builder* builder, RegIdx dst, RegIdx val, RegIdx count, uint64 align);
 void Interp_MemZero(Interp_Builder* builder, RegIdx dst, RegIdx count, uint64 align);
 void Interp_MemCpy(Interp_Builder* builder, RegIdx dst, RegIdx src, RegIdx count, uint64 align, bool isVolatile);
-RegIdx Interp_ArrayAccess(Interp_Builder* builder);
+RegIdx Interp_ArrayAccess(Interp_Builder* builder, RegIdx base, RegIdx idx, uint64 stride);
 RegIdx Interp_MemberAccess(Interp_Builder* builder, RegIdx base, int64 offset);
 RegIdx Interp_GetSymbolAddress(Interp_Builder* builder, SymIdx symbol);
-void Interp_Select(Interp_Builder* builder);
+RegIdx Interp_Select(Interp_Builder* builder, RegIdx cond, RegIdx a, RegIdx b);
 RegIdx Interp_Add(Interp_Builder* builder, RegIdx reg1, RegIdx reg2);
 RegIdx Interp_Sub(Interp_Builder* builder, RegIdx reg1, RegIdx reg2);
 RegIdx Interp_Mul(Interp_Builder* builder, RegIdx reg1, RegIdx reg2);
@@ -167,11 +178,12 @@ InstrIdx Interp_If(Interp_Builder* builder, RegIdx value);
 void Interp_PatchIf(Interp_Builder* builder, InstrIdx ifInstr, RegIdx value, InstrIdx thenInstr, InstrIdx elseInstr);
 void Interp_PatchGoto(Interp_Builder* builder, InstrIdx gotoInstr, InstrIdx target);
 void Interp_PatchBranch(Interp_Builder* builder, InstrIdx branchInstr, Slice<int64> values, Slice<InstrIdx> regions, InstrIdx defaultRegion);
+InstrBitfield Interp_ClassifySwitch(int64* keys, uint32 count);
 InstrIdx Interp_Branch(Interp_Builder* builder);
 void Interp_Return(Interp_Builder* builder, RegIdx retValue);
 
 // Print Utilities
-void Interp_PrintProc(Interp_Proc* proc, Slice<Interp_Symbol> syms);
+void Interp_PrintProc(Interp_Proc* proc, Slice<Interp_Symbol> syms, Slice<uint64> instrCounts = { 0, 0 });
 void Interp_PrintInstr(Interp_Proc* proc, Interp_Instr* instr, Slice<Interp_Symbol> syms);
 void Interp_PrintBin(Interp_Instr* instr);
 void Interp_PrintUnary(Interp_Instr* instr);
\ No newline at end of file
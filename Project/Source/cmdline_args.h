@@ -18,9 +18,45 @@ X(useTildeLinker,    "tilde_linker",    bool,  false, \
 X(emitBytecode,      "emit_bc",         bool,  false,        "Print bytecode used for interpretation (#run directives)") \
 X(emitIr,            "emit_ir",         bool,  false,        "Print Intermediate Representation for the selected backend") \
 X(emitAsm,           "emit_asm",        bool,  false,        "Print generated assembly code") \
+X(run,               "run",             bool,  false, \
+"Run the main procedure in the bytecode interpreter instead of compiling it") \
+X(noJit,             "no_jit",          bool,  false, \
+"Never compile frequently called procedures to native code when running them in the bytecode interpreter") \
+X(vmProfile,         "vm_profile",      bool,  false, \
+"Profile the bytecode interpreter, print per procedure timings and execution counts per instruction") \
 X(debug,             "debug",           bool,  false,        "Generate debug information") \
+X(hugePages,         "huge_pages",      bool,  false, \
+"Back the compiler's big arenas with (transparent) huge pages, to reduce TLB misses") \
+X(numThreads,        "threads",         int,   0, \
+"Number of threads used by the compiler's job system, 0 means one per logical core") \
+X(jobStats,          "job_stats",       bool,  false, \
+"Print the number of jobs run by each thread of the job system and its utilization") \
+X(bench,             "bench",           bool,  false, \
+"Run the benchmarks for the internal data structures and allocators, then exit") \
+X(genCorpus,         "gen_corpus",      char*, "", \
+"Write a synthetic program to the given path (for compile time measurements), then exit") \
+X(corpusScale,       "corpus_scale",    int,   1, \
+"Size of the program generated by -gen_corpus, in multiples of 200 procedures") \
+X(perfBaseline,      "perf",            char*, "", \
+"Compile the given files and a generated program several times (without linking), and compare the median timings of each phase with the given baseline file; it's written if it doesn't exist") \
+X(perfRuns,          "perf_runs",       int,   10, \
+"Number of measured compilations of each input for -perf") \
+X(perfUpdate,        "perf_update",     bool,  false, \
+"Overwrite the -perf baseline file with the new measurements instead of comparing with it") \
+X(noLink,            "no_link",         bool,  false, \
+"Stop after the code generation, without invoking the linker") \
+X(snapshot,          "snapshot",        char*, "", \
+"Resume from the given snapshot of a previous compilation of the same file, skipping the frontend; if it doesn't exist or is out of date, it's written after the bytecode is generated") \
+X(incremental,       "incremental",     char*, "", \
+"Reuse the bytecode of the procedures which didn't change since the previous compilation, using the given cache file; it's written after each successful compilation") \
+X(mem,               "mem",             bool,  false, \
+"Print the committed and peak memory of each of the compiler's arenas") \
 X(time,              "time",            bool,  false, \
 "Print information about the timing of the various phases of the compilation process") \
+X(entityCosts,       "entity_costs",    int,   0, \
+"Print the given number of declarations which took the longest to compile, with the time spent in each stage") \
+X(timeJson,          "time=json",       bool,  false, \
+"Print the timings of all stages of the compilation, along with some counters, as JSON") \
 X(outputFile,        "o",               char*, "output.exe", "Desired path for the output file")
 
 struct CmdLineArgs
@@ -0,0 +1,48 @@
+
+#pragma once
+
+#include "base.h"
+#include "dependency_graph.h"
+#include "os/os_agnostic.h"
+
+// NOTE: Timings and counters for the whole compilation, printed
+// with -time, or with -time=json for scripts and dashboards. Times are
+// in seconds, measured with the monotonic clock of the OS, so they don't
+// depend on an estimate of the rdtsc frequency.
+
+struct Timings
+{
+    double frontend = 0;  // Everything before the IR generation, including the stages below
+    double lex      = 0;
+    double parse    = 0;
+    double phases[CompPhase_EnumSize] = {};  // Stages of MainDriver
+    double cycleDetection = 0;
+    double irGen    = 0;
+    double backend  = 0;
+    double linker   = 0;
+};
+
+struct Counters
+{
+    uint64 tokens       = 0;
+    uint64 astNodes     = 0;
+    uint64 entities     = 0;
+    uint64 yields[CompPhase_EnumSize] = {};  // By the phase of the entity which yielded
+    uint64 driverRounds = 0;
+    
+    uint64 bytecodeInstrs = 0;
+    uint64 procs          = 0;
+    uint64 cachedProcs    = 0;  // Bytecode reused with -incremental
+    uint64 bytesEmitted   = 0;  // Machine code generated by the backend
+};
+
+extern Timings timings;
+extern Counters counters;
+
+inline double SecondsSince(uint64 startNs)
+{
+    return (GetMonotonicTimeNs() - startNs) / 1e9;
+}
+
+void PrintTimings();
+void PrintTimingsJson();
@@ -0,0 +1,232 @@
+
+#include "corpus_gen.h"
+
+// Shape of the output, for one chain of procedures:
+// struct S0_0 { int x; S0_1 inner; }  // S0_1 is declared below
+// ...
+// proc f0(^S0_0 s, int a, int b)->int
+// {
+//     int res = a;
+//     if(a > b) { while(b < 100) { for(...) { ... } } }
+//     switch(a) { case 0: ... }
+//     int e = (a + b * 3) - (res + 4 * a) ...;
+//     res += s.inner.inner.x;
+//     res += f1(s, a + 1, b);  // f1 is declared below
+//     return res;
+// }
+String Corpus_Generate(Arena* arena, Corpus_Params params)
+{
+    ProfileFunc(prof);
+    
+    params.numProcs        = max(params.numProcs, 1);
+    params.structDepth     = max(params.structDepth, 0);
+    params.declChainLength = max(params.declChainLength, 1);
+    params.exprLength      = clamp(params.exprLength, 1, Corpus_MaxExprLength);
+    params.switchCases     = max(params.switchCases, 0);
+    params.nestingDepth    = max(params.nestingDepth, 0);
+    
+    int numChains = (params.numProcs + params.declChainLength - 1) / params.declChainLength;
+    
+    StringBuilder builder(arena);
+    char buf[128];
+    
+    // Main goes first, so it only refers to declarations further down
+    builder.Append("proc main()->int\n{\n    int res = 0;\n");
+    for(int c = 0; c < numChains; ++c)
+    {
+        if(params.structDepth > 0)
+        {
+            snprintf(buf, sizeof(buf), "    S%d_0 s%d;\n", c, c);
+            builder.Append(buf);
+            snprintf(buf, sizeof(buf), "    res += f%d(&s%d, %d, 2);\n", c * params.declChainLength, c, c);
+        }
+        else
+            snprintf(buf, sizeof(buf), "    res += f%d(%d, 2);\n", c * params.declChainLength, c);
+        
+        builder.Append(buf);
+    }
+    builder.Append("    return res;\n}\n\n");
+    
+    for(int c = 0; c < numChains; ++c)
+    {
+        if(params.structDepth > 0)
+            Corpus_GenStructs(&builder, c, params.structDepth);
+        
+        int first = c * params.declChainLength;
+        int last  = min(params.numProcs, first + params.declChainLength);
+        for(int i = first; i < last; ++i)
+            Corpus_GenProc(&builder, &params, i);
+    }
+    
+    builder.Append('\0');
+    return { builder.string.ptr, builder.string.length - 1 };
+}
+
+Corpus_Params Corpus_DefaultParams(int scale)
+{
+    Corpus_Params params;
+    params.numProcs = 200 * max(scale, 1);
+    return params;
+}
+
+bool Corpus_WriteFile(char* path, String contents)
+{
+    FILE* file = fopen(path, "wb");
+    if(!file) return false;
+    defer(fclose(file));
+    
+    return fwrite(contents.ptr, 1, contents.length, file) == (size_t)contents.length;
+}
+
+void Corpus_GenStructs(StringBuilder* builder, int chain, int depth)
+{
+    char buf[128];
+    for(int d = 0; d < depth; ++d)
+    {
+        snprintf(buf, sizeof(buf), "struct S%d_%d\n{\n    int x;\n", chain, d);
+        builder->Append(buf);
+        
+        if(d < depth - 1)
+            snprintf(buf, sizeof(buf), "    S%d_%d inner;\n}\n\n", chain, d + 1);
+        else
+            snprintf(buf, sizeof(buf), "    int y;\n}\n\n");
+        
+        builder->Append(buf);
+    }
+}
+
+void Corpus_GenProc(StringBuilder* builder, Corpus_Params* params, int idx)
+{
+    char buf[128];
+    int chain = idx / params->declChainLength;
+    bool hasStruct = params->structDepth > 0;
+    
+    if(hasStruct)
+        snprintf(buf, sizeof(buf), "proc f%d(^S%d_0 s, int a, int b)->int\n{\n", idx, chain);
+    else
+        snprintf(buf, sizeof(buf), "proc f%d(int a, int b)->int\n{\n", idx);
+    
+    builder->Append(buf);
+    builder->Append("    int res = a;\n");
+    
+    // Nested control flow
+    if(params->nestingDepth > 0)
+        Corpus_GenNested(builder, params, 1);
+    
+    // Switch
+    if(params->switchCases > 0)
+    {
+        builder->Append("    switch(a)\n    {\n");
+        for(int i = 0; i < params->switchCases; ++i)
+        {
+            snprintf(buf, sizeof(buf), "        case %d: res += %d;\n", i, i * 3 + 1);
+            builder->Append(buf);
+        }
+        builder->Append("        default: res -= 1;\n    }\n");
+    }
+    
+    // Long expression
+    builder->Append("    int e = ");
+    Corpus_GenExpr(builder, 0, params->exprLength);
+    builder->Append(";\n    res += e;\n");
+    
+    // Struct member access
+    if(hasStruct)
+    {
+        builder->Append("    res += s.");
+        for(int d = 1; d < params->structDepth; ++d)
+            builder->Append("inner.");
+        builder->Append("x;\n");
+    }
+    
+    // Call to the next procedure in the chain, declared further down
+    bool lastInChain = (idx + 1) % params->declChainLength == 0 || idx + 1 >= params->numProcs;
+    if(!lastInChain)
+    {
+        if(hasStruct)
+            snprintf(buf, sizeof(buf), "    res += f%d(s, a + 1, b);\n", idx + 1);
+        else
+            snprintf(buf, sizeof(buf), "    res += f%d(a + 1, b);\n", idx + 1);
+        
+        builder->Append(buf);
+    }
+    
+    builder->Append("    return res;\n}\n\n");
+}
+
+// Cycles between if, while and for
+void Corpus_GenNested(StringBuilder* builder, Corpus_Params* params, int level)
+{
+    char buf[128];
+    
+    Corpus_Indent(builder, level);
+    switch(level % 3)
+    {
+        case 1: snprintf(buf, sizeof(buf), "if(a > b + %d)\n", level); break;
+        case 2: snprintf(buf, sizeof(buf), "while(b < %d)\n", level * 100); break;
+        case 0: snprintf(buf, sizeof(buf), "for(int i%d = 0; i%d < 4; ++i%d)\n", level, level, level); break;
+    }
+    builder->Append(buf);
+    
+    Corpus_Indent(builder, level);
+    builder->Append("{\n");
+    
+    if(level < params->nestingDepth)
+        Corpus_GenNested(builder, params, level + 1);
+    
+    Corpus_Indent(builder, level + 1);
+    builder->Append("res += b;\n");
+    
+    // Makes the while loops terminate
+    if(level % 3 == 2)
+    {
+        Corpus_Indent(builder, level + 1);
+        builder->Append("++b;\n");
+    }
+    
+    Corpus_Indent(builder, level);
+    builder->Append("}\n");
+}
+
+// NOTE: The operands are grouped in a balanced tree of parentheses,
+// otherwise a long expression would be a very deep left-leaning AST, and
+// that would only measure how deep the recursion in the frontend can go.
+void Corpus_GenExpr(StringBuilder* builder, int first, int count)
+{
+    char* ops[] = { " + ", " - ", " * " };
+    const int numOps = StArraySize(ops);
+    
+    if(count <= 4)
+    {
+        char buf[32];
+        for(int i = first; i < first + count; ++i)
+        {
+            if(i != first) builder->Append(ops[i % numOps]);
+            
+            switch(i % 4)
+            {
+                case 0: builder->Append("a"); break;
+                case 1: builder->Append("b"); break;
+                case 2: builder->Append("res"); break;
+                case 3: snprintf(buf, sizeof(buf), "%d", i % 7 + 1); builder->Append(buf); break;
+            }
+        }
+        
+        return;
+    }
+    
+    int half = count / 2;
+    builder->Append('(');
+    Corpus_GenExpr(builder, first, half);
+    builder->Append(')');
+    builder->Append(ops[(first + half) % numOps]);
+    builder->Append('(');
+    Corpus_GenExpr(builder, first + half, count - half);
+    builder->Append(')');
+}
+
+void Corpus_Indent(StringBuilder* builder, int level)
+{
+    for(int i = 0; i < level; ++i)
+        builder->Append("    ");
+}
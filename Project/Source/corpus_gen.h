@@ -0,0 +1,36 @@
+
+#pragma once
+
+#include "base.h"
+
+// NOTE: Generates synthetic Ryu programs of arbitrary size, used to
+// measure how the compiler scales (see Bench_CompileThroughput) and as
+// input for end-to-end timings with "-gen_corpus". Each knob stresses a
+// different part of the pipeline. The output only uses features which
+// are supported by every stage, and it compiles without errors.
+
+// Each operand takes up to two registers, and RegIdx is 16 bits
+#define Corpus_MaxExprLength 30000
+
+struct Corpus_Params
+{
+    int numProcs        = 200;  // Procedures with the statements below
+    int structDepth     = 4;    // Structs containing each other, accessed by each procedure
+    int declChainLength = 8;    // Procedures (and structs) only using declarations further down the file
+    int exprLength      = 16;   // Operands of the long expression in each procedure
+    int switchCases     = 8;    // Cases of the switch in each procedure
+    int nestingDepth    = 3;    // Nested if/while/for statements in each procedure
+};
+
+// The result is null terminated
+String Corpus_Generate(Arena* arena, Corpus_Params params);
+// Scales up the size of the default corpus, which uses all knobs
+Corpus_Params Corpus_DefaultParams(int scale);
+bool Corpus_WriteFile(char* path, String contents);
+
+// Helpers
+void Corpus_GenStructs(StringBuilder* builder, int chain, int depth);
+void Corpus_GenProc(StringBuilder* builder, Corpus_Params* params, int idx);
+void Corpus_GenNested(StringBuilder* builder, Corpus_Params* params, int level);
+void Corpus_GenExpr(StringBuilder* builder, int first, int count);
+void Corpus_Indent(StringBuilder* builder, int level);
@@ -2,6 +2,12 @@
 #include "base.h"
 #include "memory_management.h"
 #include "semantics.h"
+#include "cmdline_args.h"
+#include "compile_stats.h"
+
+#ifndef UnityBuild
+extern CmdLineArgs cmdLineArgs;
+#endif
 
 // TODO: A lot of stuff still missing...
 
@@ -33,7 +39,7 @@ DepGraph Dg_InitGraph(Arena* phaseArenas[CompPhase_EnumSize][2])
     return graph;
 }
 
-bool MainDriver(Parser* p, Interp* interp, Ast_FileScope* file)
+bool MainDriver(Parser* p, Interp* interp, Ast_FileScope* file, Incr_Cache* incr)
 {
     ProfileFunc(prof);
     
@@ -52,20 +58,40 @@ bool MainDriver(Parser* p, Interp* interp, Ast_FileScope* file)
         {
             phaseArenaPtrs[i][j] = &phaseArenas[i][j];
             phaseArenas[i][j] = Arena_VirtualMemInit(size, commitSize);
+            
+            // The queues are reset on every iteration, so
+            // don't hold onto the memory of the biggest one
+            Arena_SetRetainSize(&phaseArenas[i][j], MB(16));
         }
     }
     
+    defer({
+              if(cmdLineArgs.mem)
+              {
+                  Arena_RecordStats("Type", &typeArena);
+                  for(int i = 0; i < CompPhase_EnumSize; ++i)
+                  {
+                      Arena_RecordStats("Phase queues", &phaseArenas[i][0]);
+                      Arena_RecordStats("Phase queues", &phaseArenas[i][1]);
+                  }
+              }
+          });
+    
     DepGraph g = Dg_InitGraph(phaseArenaPtrs);
     g.interp = interp;
     g.items = p->entities;
+    g.incr = incr;
     
     Typer t = InitTyper(&typeArena, p->tokenizer);
     t.graph = &g;
     t.fileScope = file;
+    Typer_InitSymbolTable(&t);
+    defer(Typer_FreeSymbolTable(&t));
     
     g.typer = &t;
     
     *interp = Interp_Init(&g);
+    interp->entities = p->entities;
     
     // TODO: for now we only have one file, one ast.
     // Fill the typecheck queue with initial values
@@ -87,6 +113,7 @@ bool MainDriver(Parser* p, Interp* interp, Ast_FileScope* file)
     {
         done = true;
         progress = false;
+        ++counters.driverRounds;
         
         // For each stage in the pipeline
         for(int i = CompPhase_Uninit + 1; i < CompPhase_EnumSize; ++i)
@@ -100,8 +127,13 @@ bool MainDriver(Parser* p, Interp* interp, Ast_FileScope* file)
             Dg_StartIteration(&g, &queue);
             
             // Detect cycles and perform topological sorting
+            uint64 cycleStart = GetMonotonicTimeNs();
             bool cycle = Dg_DetectCycle(&g, &queue);
+            timings.cycleDetection += SecondsSince(cycleStart);
+            
+            uint64 stageStart = GetMonotonicTimeNs();
             Dg_PerformStage(&g, &queue);
+            timings.phases[i] += SecondsSince(stageStart);
             
             if(cycle) g.status = false;
             if(queue.numSucceeded > 0) progress = true;
@@ -117,6 +149,10 @@ bool MainDriver(Parser* p, Interp* interp, Ast_FileScope* file)
     if(!done && !progress)
         fprintf(stderr, "Internal error: Unable to resolve code dependencies and/or detect a cycle.\n");
     
+    counters.procs += interp->procs.length;
+    for_array(i, interp->procs)
+        counters.bytecodeInstrs += interp->procs[i].instrs.length;
+    
     return g.status;
 }
 
@@ -134,10 +170,12 @@ Dg_IdxGen Dg_NewNode(Ast_Node* node, Arena* allocTo, Slice<Dg_Entity>* entities)
     auto& item    = (*entities)[res.idx];
     item.node     = node;
     item.waitFor  = { 0, 0 };
+    item.uses     = { 0, 0 };
     item.stackIdx = -1;
     item.sccIdx   = -1;
     item.flags    = 0;
     item.phase    = CompPhase_Typecheck;
+    item.cost     = {};
     return res;
 }
 
@@ -161,7 +199,24 @@ void Dg_Yield(DepGraph* g, Ast_Node* yieldUpon, CompPhase neededPhase)
     dep.idx = yieldUpon->entityIdx;
     
     dep.neededPhase = neededPhase;
-    g->items[g->curIdx].waitFor.Append(dep);
+    auto& entity = g->items[g->curIdx];
+    entity.waitFor.Append(dep);
+    ++entity.cost.numYields;
+    ++counters.yields[entity.phase];
+    
+    Dg_RecordUse(g, yieldUpon);
+}
+
+void Dg_RecordUse(DepGraph* g, Ast_Node* used)
+{
+    if(!g->incr || used->entityIdx == Dg_Null || used->entityIdx == g->curIdx) return;
+    
+    // Duplicates are removed when the uses are written to the cache,
+    // this only skips the common case of the same identifier in a row
+    auto& entity = g->items[g->curIdx];
+    if(entity.uses.length > 0 && entity.uses.last() == used->entityIdx) return;
+    
+    entity.uses.Append(used->entityIdx);
 }
 
 void Dg_Error(DepGraph* g)
@@ -219,7 +274,18 @@ void Dg_PerformStage(DepGraph* graph, Queue* q)
                 if(gNode.flags & Entity_Error) continue;
                 
                 graph->curIdx = q->processing[i];
+                
+                // The body of a cached procedure is not checked again
+                if(gNode.flags & Entity_Cached)
+                {
+                    Dg_UpdateQueue(graph, q, i, true);
+                    continue;
+                }
+                
+                ProfileBlockArgs(entityProf, Dg_EntityName(gNode.node), Dg_CompPhase2Str(q->phase));
+                uint64 start = GetMonotonicTimeNs();
                 bool outcome = CheckNode(graph->typer, gNode.node);
+                gNode.cost.phaseNs[q->phase] += GetMonotonicTimeNs() - start;
                 Dg_UpdateQueue(graph, q, i, outcome);
             }
             
@@ -235,7 +301,16 @@ void Dg_PerformStage(DepGraph* graph, Queue* q)
                 if(gNode.flags & Entity_Error) continue;
                 graph->curIdx = q->processing[i];
                 
+                if(gNode.flags & Entity_Cached)
+                {
+                    Dg_UpdateQueue(graph, q, i, true);
+                    continue;
+                }
+                
+                ProfileBlockArgs(entityProf, Dg_EntityName(gNode.node), Dg_CompPhase2Str(q->phase));
+                uint64 start = GetMonotonicTimeNs();
                 bool outcome = ComputeSize(graph->typer, astNode);
+                gNode.cost.phaseNs[q->phase] += GetMonotonicTimeNs() - start;
                 Dg_UpdateQueue(graph, q, i, outcome);
             }
             
@@ -247,8 +322,12 @@ void Dg_PerformStage(DepGraph* graph, Queue* q)
             {
                 auto& gNode = graph->items[q->processing[i]];
                 auto astNode = gNode.node;
+                graph->curIdx = q->processing[i];
                 
+                ProfileBlockArgs(entityProf, Dg_EntityName(gNode.node), Dg_CompPhase2Str(q->phase));
+                uint64 start = GetMonotonicTimeNs();
                 bool success = GenBytecode(graph->interp, astNode);
+                gNode.cost.phaseNs[q->phase] += GetMonotonicTimeNs() - start;
                 Dg_UpdateQueue(graph, q, i, success);
             }
             
@@ -566,6 +645,68 @@ String Dg_CompPhase2Sentence(CompPhase phase, bool pastTense)
     return res;
 }
 
+String Dg_EntityName(Ast_Node* node)
+{
+    switch(node->kind)
+    {
+        case AstKind_ProcDef:   return ((Ast_ProcDef*)node)->decl->name.str;
+        case AstKind_ProcDecl:
+        case AstKind_VarDecl:
+        case AstKind_StructDef: return ((Ast_Declaration*)node)->name.str;
+        default:                return StrLit("[unnamed entity]");
+    }
+}
+
+uint64 Dg_TotalCostNs(Dg_EntityCost* cost)
+{
+    uint64 total = cost->irGenNs + cost->backendNs;
+    for(int i = 0; i < CompPhase_EnumSize; ++i)
+        total += cost->phaseNs[i];
+    
+    return total;
+}
+
+void Dg_PrintEntityCosts(Slice<Dg_Entity> entities, int count)
+{
+    ScratchArena scratch;
+    
+    Slice<Dg_Idx> order = { 0, 0 };
+    for_array(i, entities)
+        order.Append(scratch, (Dg_Idx)i);
+    
+    {
+        Dg_Idx tmp;
+#define Tmp_Less(i, j) Dg_TotalCostNs(&entities[order[i]].cost) > Dg_TotalCostNs(&entities[order[j]].cost)
+#define Tmp_Swap(i, j) tmp = order[i], order[i] = order[j], order[j] = tmp
+        QSORT(order.length, Tmp_Less, Tmp_Swap);
+#undef Tmp_Swap
+#undef Tmp_Less
+    }
+    
+    const double msPerNs = 1.0 / 1000000.0;
+    
+    printf("----- Entity costs -----\n");
+    printf("%10s %10s %10s %10s %10s %10s %8s  %s\n", "Total", "Typecheck", "Size", "Bytecode",
+           "IR Gen", "Backend", "Yields", "Entity");
+    for(int i = 0; i < min((int)order.length, count); ++i)
+    {
+        auto& entity = entities[order[i]];
+        auto& cost = entity.cost;
+        String name = Dg_EntityName(entity.node);
+        
+        printf("%8.3fms %8.3fms %8.3fms %8.3fms %8.3fms %8.3fms %8u  %.*s%s\n",
+               Dg_TotalCostNs(&cost) * msPerNs,
+               cost.phaseNs[CompPhase_Typecheck] * msPerNs,
+               cost.phaseNs[CompPhase_ComputeSize] * msPerNs,
+               cost.phaseNs[CompPhase_Bytecode] * msPerNs,
+               cost.irGenNs * msPerNs, cost.backendNs * msPerNs,
+               cost.numYields, (int)name.length, name.ptr,
+               entity.node->kind == AstKind_ProcDecl ? " (decl)" : "");
+    }
+    
+    printf("------------------------\n");
+}
+
 String Dg_CompPhase2Str(CompPhase phase)
 {
     String res;
@@ -592,11 +733,14 @@ void Dg_DebugPrintDeps(DepGraph* g)
     for_array(i, g->items)
     {
         int numChars = 0;
-        Token* start = g->items[i].node->where;
-        Token* end = start;
-        while(end < start + 2 && end->type != Tok_EOF) ++end;
+        Tokenizer* tokenizer = g->typer->tokenizer;
+        TokenIdx start = g->items[i].node->where;
+        TokenIdx end = start;
+        while(end < start + 2 && TokType(tokenizer, end) != Tok_EOF) ++end;
         
-        String nodeStr = { start->text.ptr, end->ec - start->sc + 1 };
+        String nodeStr = TokText(tokenizer, start);
+        String endStr  = TokText(tokenizer, end);
+        nodeStr.length = endStr.ptr + endStr.length - nodeStr.ptr;
         nodeStr = nodeStr.CopyToArena(scratch);
         // Substitute newlines with spaces
         for_array(j, nodeStr)
@@ -628,11 +772,13 @@ void Dg_DebugPrintDeps(DepGraph* g)
             fprintf(stderr, "-> ");
             
             {
-                Token* start = g->items[waitFor[j].idx].node->where;
-                Token* end = start;
-                while(end < start + 2 && end->type != Tok_EOF) ++end;
+                TokenIdx start = g->items[waitFor[j].idx].node->where;
+                TokenIdx end = start;
+                while(end < start + 2 && TokType(tokenizer, end) != Tok_EOF) ++end;
                 
-                String nodeStr = { start->text.ptr, end->ec - start->sc + 1 };
+                String nodeStr = TokText(tokenizer, start);
+                String endStr  = TokText(tokenizer, end);
+                nodeStr.length = endStr.ptr + endStr.length - nodeStr.ptr;
                 nodeStr = nodeStr.CopyToArena(scratch);
                 // Substitute newlines with spaces
                 for_array(j, nodeStr)
@@ -11,6 +11,7 @@ struct Ast_FileScope;
 
 struct Typer;
 struct Interp;
+struct Incr_Cache;
 
 struct DepGraph;
 typedef uint32 Dg_Idx;
@@ -49,7 +50,17 @@ struct Dg_Dependency
 enum EntityFlags
 {
     Entity_OnStack = 1 << 0,
-    Entity_Error   = 1 << 1
+    Entity_Error   = 1 << 1,
+    Entity_Cached  = 1 << 2   // Reused from the previous compilation, see incremental.h
+};
+
+// Compile time spent on an entity, printed with -entity_costs
+struct Dg_EntityCost
+{
+    uint64 phaseNs[CompPhase_EnumSize] = {};  // Including the attempts which yielded
+    uint64 irGenNs   = 0;
+    uint64 backendNs = 0;
+    uint32 numYields = 0;
 };
 
 struct Dg_Entity
@@ -58,11 +69,17 @@ struct Dg_Entity
     
     Array<Dg_Dependency> waitFor;
     
+    // Entities this one needed while it was compiled,
+    // only recorded with -incremental (see Dg_RecordUse)
+    Array<Dg_Idx> uses;
+    
     // Tarjan visit
     CompPhase phase;
     uint32 stackIdx;
     uint32 sccIdx;  // Strongly Connected Component
     uint8 flags;
+    
+    Dg_EntityCost cost;
 };
 
 struct Queue
@@ -99,6 +116,7 @@ struct DepGraph
     
     Typer* typer;
     Interp* interp;
+    Incr_Cache* incr = 0;  // With -incremental
     
     bool status = true;
 };
@@ -107,6 +125,10 @@ DepGraph Dg_InitGraph(Arena* phaseArenas[CompPhase_EnumSize][2]);
 Dg_IdxGen Dg_NewNode(Ast_Node* node, Arena* allocTo, Slice<Dg_Entity>* entities);
 void Dg_StartIteration(DepGraph* g, Queue* q);
 void Dg_Yield(DepGraph* g, Ast_Node* yieldUpon, CompPhase neededPhase);
+// Records that the current entity depends on the result of another one
+// (e.g. an identifier resolved to it), so that it's recompiled when that
+// one changes. Yielding also records a use.
+void Dg_RecordUse(DepGraph* g, Ast_Node* used);
 void Dg_Error(DepGraph* g);
 void Dg_UpdatePhase(Dg_Entity* entity, CompPhase newPhase);
 void Dg_UpdateQueue(DepGraph* graph, Queue* q, int inputIdx, bool success);
@@ -118,7 +140,12 @@ void Dg_TopologicalSort(DepGraph* g, Queue* queue);  // Assumes that 'stackIdx'
 void Dg_ExplainCyclicDependency(DepGraph* g, Queue* q, Dg_Idx start, Dg_Idx end);
 String Dg_CompPhase2Sentence(CompPhase phase, bool pastTense = false);
 String Dg_CompPhase2Str(CompPhase phase);
+// Name of the declaration, used by the profiler
+String Dg_EntityName(Ast_Node* node);
+uint64 Dg_TotalCostNs(Dg_EntityCost* cost);
+// Prints the "count" entities which took the longest to compile
+void Dg_PrintEntityCosts(Slice<Dg_Entity> entities, int count);
 // For debugging purposes
 void Dg_DebugPrintDeps(DepGraph* g);
 
-bool MainDriver(Parser* p, Interp* interp, Ast_FileScope* file);
+bool MainDriver(Parser* p, Interp* interp, Ast_FileScope* file, Incr_Cache* incr = 0);
@@ -0,0 +1,608 @@
+
+#include "incremental.h"
+#include "memory_management.h"
+#include "snapshot.h"
+#include "compile_stats.h"
+#include "cmdline_args.h"
+
+#ifndef UnityBuild
+extern CmdLineArgs cmdLineArgs;
+#endif
+
+bool Incr_Prepare(Incr_Cache* cache, Parser* p, char* path)
+{
+    ProfileFunc(prof);
+    
+    cache->arena = Arena_VirtualMemInit(GB(1), MB(2));
+    
+    if(!Incr_ComputeFingerprints(cache, p))
+    {
+        Arena_Free(&cache->arena);
+        return false;
+    }
+    
+    cache->file = MapFileReadOnly(path);
+    if(cache->file.ptr && !Incr_ReadCache(cache))
+        cache->entries = { 0, 0 };
+    
+    Incr_MatchEntities(cache, p);
+    Incr_PropagateDirty(cache);
+    
+    for_array(i, p->entities)
+    {
+        uint32 entryIdx = cache->entryOfEntity[i];
+        if(entryIdx == Incr_None) continue;
+        
+        auto& entity = p->entities[i];
+        auto entry = &cache->entries[entryIdx];
+        if(entity.node->kind == AstKind_ProcDef && !entry->dirty && Incr_CanReuse(cache, p->entities, entry))
+            entity.flags |= Entity_Cached;
+    }
+    
+    return true;
+}
+
+void Incr_Free(Incr_Cache* cache)
+{
+    UnmapFile(cache->file);
+    cache->file = { 0 };
+    Arena_Free(&cache->arena);
+}
+
+// NOTE: Fingerprints are computed on the top-level declarations found
+// by ScanTopLevelDecls. It doesn't always agree with the parser (e.g. the
+// body of a procedure returning an anonymous struct is a separate range),
+// so ranges without entities are included in the fingerprints of both of
+// their neighbours. That way every token is covered by the entities it could
+// belong to, and a disagreement only causes more recompilation.
+bool Incr_ComputeFingerprints(Incr_Cache* cache, Parser* p)
+{
+    ProfileFunc(prof);
+    ScratchArena scratch(&cache->arena);
+    
+    Slice<Dg_Entity> entities = p->entities;
+    Tokenizer* t = p->tokenizer;
+    
+    Slice<TokenIdx> starts = ScanTopLevelDecls(p, scratch);
+    if(starts.length == 0) return false;
+    
+    // The last start is the EOF token
+    int64 numRanges = starts.length - 1;
+    bool* hasEntity = Arena_AllocArray(scratch, numRanges, bool);
+    memset(hasEntity, 0, sizeof(bool) * numRanges);
+    uint32* rangeOfEntity = Arena_AllocArray(scratch, entities.length, uint32);
+    for_array(i, entities)
+    {
+        // Last range which starts at or before the entity
+        TokenIdx where = entities[i].node->where;
+        int64 lo = 0, hi = numRanges;
+        while(hi - lo > 1)
+        {
+            int64 mid = (lo + hi) / 2;
+            if(starts[mid] <= where) lo = mid;
+            else                     hi = mid;
+        }
+        
+        if(numRanges == 0 || where < starts[lo] || where >= starts[numRanges]) return false;
+        
+        rangeOfEntity[i] = (uint32)lo;
+        hasEntity[lo] = true;
+    }
+    
+    cache->fingerprints.ptr = Arena_AllocArray(&cache->arena, entities.length, uint64);
+    cache->fingerprints.length = entities.length;
+    for_array(i, entities)
+    {
+        int64 first = rangeOfEntity[i];
+        int64 last  = rangeOfEntity[i];
+        while(first > 0 && !hasEntity[first - 1]) --first;
+        while(last + 1 < numRanges && !hasEntity[last + 1]) ++last;
+        
+        TokenIdx start = starts[first];
+        TokenIdx end   = starts[last + 1];
+        
+        auto node = entities[i].node;
+        cache->fingerprints[i] = Incr_HashTokens(t, start, end);
+        
+        // Procedure definitions always come after their declaration,
+        // which only gets the signature
+        if(node->kind == AstKind_ProcDef)
+        {
+            auto procDef = (Ast_ProcDef*)node;
+            TokenIdx bodyStart = procDef->bodyStart;
+            if(bodyStart <= start || bodyStart > end) bodyStart = end;
+            
+            cache->fingerprints[procDef->decl->entityIdx] = Incr_HashTokens(t, start, bodyStart);
+        }
+    }
+    
+    return true;
+}
+
+// Comments and whitespace don't change the fingerprint
+uint64 Incr_HashTokens(Tokenizer* t, TokenIdx start, TokenIdx end)
+{
+    uint64 hash = 0x31415926;
+    for(TokenIdx i = start; i < end; ++i)
+        hash = HashString(TokText(t, i), hash ^ TokType(t, i));
+    
+    return hash;
+}
+
+bool Incr_ReadCache(Incr_Cache* cache)
+{
+    ProfileFunc(prof);
+    
+    Incr_Reader r = { cache->file.ptr, cache->file.ptr + cache->file.size };
+    
+    Incr_Header header;
+    if(!Incr_Read(&r, &header, sizeof(header))) return false;
+    if(memcmp(header.magic, Incr_Magic, sizeof(header.magic)) != 0) return false;
+    if(header.version  != Incr_Version   ||
+       header.layoutId != Incr_LayoutId() ||
+       header.buildId  != Snap_BuildId())
+        return false;
+    
+    // A corrupt count shouldn't make us reserve an absurd amount of memory
+    if(header.numEntries > (cache->file.size - sizeof(header)) / Incr_MinEntrySize)
+        return false;
+    
+    Slice<Incr_Entry> entries = { 0, 0 };
+    entries.ptr = Arena_AllocArray(&cache->arena, header.numEntries, Incr_Entry);
+    entries.length = header.numEntries;
+    for_array(i, entries)
+    {
+        auto& entry = entries[i];
+        entry = {};
+        entry.entityIdx = Dg_Null;
+        
+        Incr_Blob name;
+        uint8 hasProc = 0;
+        bool ok = Incr_Read(&r, &entry.kind, sizeof(entry.kind))
+               && Incr_Read(&r, &entry.ordinal, sizeof(entry.ordinal))
+               && Incr_ReadBlob(&r, &name, sizeof(char))
+               && Incr_Read(&r, &entry.fingerprint, sizeof(entry.fingerprint))
+               && Incr_ReadBlob(&r, &entry.uses, sizeof(uint32))
+               && Incr_Read(&r, &hasProc, sizeof(hasProc));
+        if(!ok) return false;
+        
+        entry.name = { name.ptr, (int64)name.length };
+        entry.hasProc = hasProc;
+        if(!hasProc) continue;
+        
+        uint8 hasSelfTailCall = 0;
+        ok = Incr_Read(&r, &entry.maxReg, sizeof(entry.maxReg))
+          && Incr_Read(&r, &entry.prologueEnd, sizeof(entry.prologueEnd))
+          && Incr_Read(&r, &hasSelfTailCall, sizeof(hasSelfTailCall))
+          && Incr_Read(&r, &entry.frameSize, sizeof(entry.frameSize))
+          && Incr_Read(&r, &entry.retRule, sizeof(entry.retRule))
+          && Incr_Read(&r, &entry.retType, sizeof(entry.retType));
+        if(!ok) return false;
+        
+        entry.hasSelfTailCall = hasSelfTailCall;
+        for(int j = 0; j < Incr_NumProcArrays; ++j)
+        {
+            if(!Incr_ReadBlob(&r, &entry.arrays[j], Incr_ElementSize((Incr_ProcArray)j)))
+                return false;
+        }
+    }
+    
+    cache->entries = entries;
+    return true;
+}
+
+void Incr_MatchEntities(Incr_Cache* cache, Parser* p)
+{
+    ProfileFunc(prof);
+    
+    Slice<Dg_Entity> entities = p->entities;
+    
+    cache->ordinals.ptr = Arena_AllocArray(&cache->arena, entities.length, uint32);
+    cache->ordinals.length = entities.length;
+    cache->entryOfEntity.ptr = Arena_AllocArray(&cache->arena, entities.length, uint32);
+    cache->entryOfEntity.length = entities.length;
+    
+    HashTable<int64, uint32> counts;
+    HashTable<int64, Dg_Idx> current;
+    counts.Init(HashTable_MinCapacity);
+    current.Init(HashTable_MinCapacity);
+    defer({
+              counts.Free();
+              current.Free();
+          });
+    
+    for_array(i, entities)
+    {
+        auto node = entities[i].node;
+        String name = Dg_EntityName(node);
+        int64 countKey = Incr_EntityKey(node->kind, name, 0);
+        
+        uint32* count = counts.Get(countKey);
+        uint32 ordinal = count ? (*count)++ : 0;
+        if(!count) counts.Add(countKey, 1);
+        
+        cache->ordinals[i] = ordinal;
+        cache->entryOfEntity[i] = Incr_None;
+        current.Add(Incr_EntityKey(node->kind, name, ordinal), (Dg_Idx)i);
+    }
+    
+    for_array(i, cache->entries)
+    {
+        auto& entry = cache->entries[i];
+        HashTableCursor<int64> cursor;
+        int64 key = Incr_EntityKey(entry.kind, entry.name, entry.ordinal);
+        for(auto val = current.GetFirst(key, &cursor); val; val = current.GetNext(&cursor))
+        {
+            auto node = entities[*val].node;
+            bool match = node->kind == entry.kind
+                      && cache->ordinals[*val] == entry.ordinal
+                      && Dg_EntityName(node) == entry.name
+                      && cache->entryOfEntity[*val] == Incr_None;
+            if(match)
+            {
+                entry.entityIdx = *val;
+                cache->entryOfEntity[*val] = i;
+                break;
+            }
+        }
+    }
+}
+
+// An entry is dirty if its entity was removed or changed, or if one of
+// the entries it uses is dirty. This is a visit of the reverse edges
+// starting from the changed entries.
+void Incr_PropagateDirty(Incr_Cache* cache)
+{
+    ProfileFunc(prof);
+    ScratchArena scratch(&cache->arena);
+    
+    Slice<Incr_Entry> entries = cache->entries;
+    uint32 numEntries = (uint32)entries.length;
+    
+    // Reverse edges, in compressed form
+    uint32* revStart = Arena_AllocArray(scratch, numEntries + 1, uint32);
+    memset(revStart, 0, sizeof(uint32) * (numEntries + 1));
+    for_array(i, entries)
+    {
+        for(uint32 j = 0; j < entries[i].uses.length; ++j)
+        {
+            uint32 use;
+            memcpy(&use, entries[i].uses.ptr + j * sizeof(uint32), sizeof(uint32));
+            if(use < numEntries) ++revStart[use + 1];
+        }
+    }
+    
+    for(uint32 i = 0; i < numEntries; ++i)
+        revStart[i + 1] += revStart[i];
+    
+    uint32* revEdges = Arena_AllocArray(scratch, revStart[numEntries], uint32);
+    uint32* fill = Arena_AllocArray(scratch, numEntries, uint32);
+    memcpy(fill, revStart, sizeof(uint32) * numEntries);
+    
+    Slice<uint32> stack = { 0, 0 };
+    for_array(i, entries)
+    {
+        auto& entry = entries[i];
+        bool changed = entry.entityIdx == Dg_Null || entry.fingerprint != cache->fingerprints[entry.entityIdx];
+        for(uint32 j = 0; j < entry.uses.length; ++j)
+        {
+            uint32 use;
+            memcpy(&use, entry.uses.ptr + j * sizeof(uint32), sizeof(uint32));
+            if(use < numEntries)
+                revEdges[fill[use]++] = i;
+            else
+                changed = true;
+        }
+        
+        entry.dirty = changed;
+        if(changed) stack.Append(scratch, i);
+    }
+    
+    while(stack.length > 0)
+    {
+        uint32 cur = stack[stack.length - 1];
+        --stack.length;
+        
+        for(uint32 j = revStart[cur]; j < revStart[cur + 1]; ++j)
+        {
+            auto& dependant = entries[revEdges[j]];
+            if(dependant.dirty) continue;
+            
+            dependant.dirty = true;
+            stack.Append(scratch, revEdges[j]);
+        }
+    }
+}
+
+bool Incr_CanReuse(Incr_Cache* cache, Slice<Dg_Entity> entities, Incr_Entry* entry)
+{
+    if(!entry->hasProc) return false;
+    
+    Incr_Blob instrs = entry->arrays[Incr_Instrs];
+    for(uint32 i = 0; i < instrs.length; ++i)
+    {
+        Interp_Instr instr;
+        memcpy(&instr, instrs.ptr + i * sizeof(Interp_Instr), sizeof(Interp_Instr));
+        if(instr.op != Op_GetSymbolAddress) continue;
+        
+        uint32 ref = instr.symAddress.symbol;
+        if(ref >= cache->entries.length) return false;
+        
+        Dg_Idx entityIdx = cache->entries[ref].entityIdx;
+        if(entityIdx == Dg_Null) return false;
+        
+        auto kind = entities[entityIdx].node->kind;
+        if(kind != AstKind_ProcDecl && kind != AstKind_VarDecl) return false;
+    }
+    
+    return true;
+}
+
+bool Incr_ReuseProc(Incr_Cache* cache, Interp* interp, Ast_ProcDef* astProc)
+{
+    ProfileFunc(prof);
+    
+    auto entry = &cache->entries[cache->entryOfEntity[astProc->entityIdx]];
+    Slice<Dg_Entity> entities = interp->graph->items;
+    
+    // The symbols of the procedure and of everything
+    // it references have to exist before it's added
+    bool ready = true;
+    if(astProc->decl->phase <= CompPhase_Bytecode)
+    {
+        Dg_Yield(interp->graph, astProc->decl, CompPhase_Bytecode);
+        ready = false;
+    }
+    
+    Incr_Blob instrs = entry->arrays[Incr_Instrs];
+    for(uint32 i = 0; i < instrs.length; ++i)
+    {
+        Interp_Instr instr;
+        memcpy(&instr, instrs.ptr + i * sizeof(Interp_Instr), sizeof(Interp_Instr));
+        if(instr.op != Op_GetSymbolAddress) continue;
+        
+        auto node = entities[cache->entries[instr.symAddress.symbol].entityIdx].node;
+        if(node->phase <= CompPhase_Bytecode)
+        {
+            Dg_Yield(interp->graph, node, CompPhase_Bytecode);
+            ready = false;
+        }
+    }
+    
+    if(!ready) return false;
+    
+    Interp_Proc* proc = Interp_MakeProc(interp);
+    astProc->procIdx = interp->procs.length - 1;
+    proc->symIdx = astProc->decl->symIdx;
+    proc->entityIdx = astProc->entityIdx;
+    interp->symbols[proc->symIdx].procIdx = astProc->procIdx;
+    
+    proc->maxReg          = entry->maxReg;
+    proc->prologueEnd     = entry->prologueEnd;
+    proc->hasSelfTailCall = entry->hasSelfTailCall;
+    proc->frameSize       = entry->frameSize;
+    proc->retRule         = entry->retRule;
+    proc->retType         = entry->retType;
+    Incr_CopyArray(&proc->instrArrays, entry->arrays[Incr_InstrArrays]);
+    Incr_CopyArray(&proc->regArrays,   entry->arrays[Incr_RegArrays]);
+    Incr_CopyArray(&proc->constArrays, entry->arrays[Incr_ConstArrays]);
+    Incr_CopyArray(&proc->argRules,    entry->arrays[Incr_ArgRules]);
+    Incr_CopyArray(&proc->instrs,      entry->arrays[Incr_Instrs]);
+    Incr_CopyArray(&proc->argTypes,    entry->arrays[Incr_ArgTypes]);
+    
+    for_array(i, proc->instrs)
+    {
+        auto& instr = proc->instrs[i];
+        if(instr.op != Op_GetSymbolAddress) continue;
+        
+        auto node = entities[cache->entries[instr.symAddress.symbol].entityIdx].node;
+        if(node->kind == AstKind_ProcDecl)
+            instr.symAddress.symbol = ((Ast_ProcDecl*)node)->symIdx;
+        else
+            instr.symAddress.symbol = ((Ast_VarDecl*)node)->symIdx;
+    }
+    
+    ++counters.cachedProcs;
+    return true;
+}
+
+bool Incr_WriteCache(Incr_Cache* cache, Parser* p, Interp* interp, char* path)
+{
+    ProfileFunc(prof);
+    ScratchArena scratch(&cache->arena);
+    
+    Arena out = Arena_VirtualMemInit(GB(4), MB(2));
+    defer(Arena_Free(&out));
+    
+    Slice<Dg_Entity> entities = p->entities;
+    
+    auto header = Arena_AllocVarPack(&out, Incr_Header);
+    memset(header, 0, sizeof(Incr_Header));
+    memcpy(header->magic, Incr_Magic, sizeof(header->magic));
+    header->version    = Incr_Version;
+    header->layoutId   = Incr_LayoutId();
+    header->buildId    = Snap_BuildId();
+    header->numEntries = (uint32)entities.length;
+    
+    // Entries of the new cache are the entities of this compilation, in order
+    for_array(i, entities)
+    {
+        auto& entity = entities[i];
+        auto node = entity.node;
+        
+        uint8 kind = (uint8)node->kind;
+        String name = Dg_EntityName(node);
+        Incr_Write(&out, &kind, sizeof(kind));
+        Incr_Write(&out, &cache->ordinals[i], sizeof(uint32));
+        Incr_WriteBlob(&out, name.ptr, (uint32)name.length, sizeof(char));
+        Incr_Write(&out, &cache->fingerprints[i], sizeof(uint64));
+        
+        // Entities which weren't typechecked keep the uses of the previous compilation
+        Slice<uint32> uses = { 0, 0 };
+        if(entity.flags & Entity_Cached)
+        {
+            auto entry = &cache->entries[cache->entryOfEntity[i]];
+            for(uint32 j = 0; j < entry->uses.length; ++j)
+            {
+                uint32 use;
+                memcpy(&use, entry->uses.ptr + j * sizeof(uint32), sizeof(uint32));
+                uses.Append(scratch, cache->entries[use].entityIdx);
+            }
+        }
+        else
+        {
+            for_array(j, entity.uses)
+                uses.Append(scratch, entity.uses[j]);
+        }
+        
+        // Uses are recorded every time an identifier is resolved, remove the duplicates
+        {
+            uint32 tmp;
+#define Tmp_Less(i, j) uses[i] < uses[j]
+#define Tmp_Swap(i, j) tmp = uses[i], uses[i] = uses[j], uses[j] = tmp
+            QSORT(uses.length, Tmp_Less, Tmp_Swap);
+#undef Tmp_Swap
+#undef Tmp_Less
+        }
+        
+        int64 numUses = 0;
+        for_array(j, uses)
+        {
+            if(numUses == 0 || uses[numUses - 1] != uses[j])
+                uses[numUses++] = uses[j];
+        }
+        
+        Incr_WriteBlob(&out, uses.ptr, (uint32)numUses, sizeof(uint32));
+        
+        // The bytecode is only stored if all of its symbols belong to entities
+        Interp_Proc* proc = 0;
+        if(node->kind == AstKind_ProcDef && ((Ast_ProcDef*)node)->procIdx != ProcIdx_Unused)
+            proc = &interp->procs[((Ast_ProcDef*)node)->procIdx];
+        
+        Interp_Instr* instrs = 0;
+        if(proc)
+        {
+            instrs = Arena_AllocArray(scratch, proc->instrs.length, Interp_Instr);
+            memcpy(instrs, proc->instrs.ptr, sizeof(Interp_Instr) * proc->instrs.length);
+            for_array(j, proc->instrs)
+            {
+                if(instrs[j].op != Op_GetSymbolAddress) continue;
+                
+                auto decl = interp->symbols[instrs[j].symAddress.symbol].decl;
+                if(decl->entityIdx == Dg_Null)
+                {
+                    proc = 0;
+                    break;
+                }
+                
+                instrs[j].symAddress.symbol = decl->entityIdx;
+            }
+        }
+        
+        uint8 hasProc = proc != 0;
+        Incr_Write(&out, &hasProc, sizeof(hasProc));
+        if(!proc) continue;
+        
+        uint8 hasSelfTailCall = proc->hasSelfTailCall;
+        Incr_Write(&out, &proc->maxReg, sizeof(proc->maxReg));
+        Incr_Write(&out, &proc->prologueEnd, sizeof(proc->prologueEnd));
+        Incr_Write(&out, &hasSelfTailCall, sizeof(hasSelfTailCall));
+        Incr_Write(&out, &proc->frameSize, sizeof(proc->frameSize));
+        Incr_Write(&out, &proc->retRule, sizeof(proc->retRule));
+        Incr_Write(&out, &proc->retType, sizeof(proc->retType));
+        
+        // Same order as Incr_ProcArray
+        Incr_WriteBlob(&out, proc->instrArrays.ptr, (uint32)proc->instrArrays.length, sizeof(InstrIdx));
+        Incr_WriteBlob(&out, proc->regArrays.ptr, (uint32)proc->regArrays.length, sizeof(RegIdx));
+        Incr_WriteBlob(&out, proc->constArrays.ptr, (uint32)proc->constArrays.length, sizeof(int64));
+        Incr_WriteBlob(&out, proc->argRules.ptr, (uint32)proc->argRules.length, sizeof(TB_PassingRule));
+        Incr_WriteBlob(&out, instrs, (uint32)proc->instrs.length, sizeof(Interp_Instr));
+        Incr_WriteBlob(&out, proc->argTypes.ptr, (uint32)proc->argTypes.length, sizeof(Interp_Type));
+    }
+    
+    // If the arena had to chain another block, the file isn't contiguous
+    if(out.block) return false;
+    
+    // NOTE: The old cache is still mapped (cached bytecode was
+    // copied, but not the uses), so it can't be overwritten in place
+    // on every platform. Unmap it first, nothing reads it anymore.
+    UnmapFile(cache->file);
+    cache->file = { 0 };
+    
+    FILE* file = fopen(path, "wb");
+    if(!file) return false;
+    defer(fclose(file));
+    
+    return fwrite(header, 1, out.offset, file) == out.offset;
+}
+
+int64 Incr_EntityKey(uint8 kind, String name, uint32 ordinal)
+{
+    return (int64)HashString(name, ((uint64)kind << 32 | ordinal) ^ 0x31415926);
+}
+
+// The bytecode is stored as it is in memory
+uint32 Incr_LayoutId()
+{
+    uint64 sizes[] =
+    {
+        sizeof(Interp_Instr), sizeof(Interp_Type), sizeof(TB_PassingRule),
+        sizeof(InstrIdx), sizeof(RegIdx)
+    };
+    
+    return LayoutIdOf({ sizes, StArraySize(sizes) });
+}
+
+uint32 Incr_ElementSize(Incr_ProcArray array)
+{
+    switch(array)
+    {
+        case Incr_InstrArrays: return sizeof(InstrIdx);
+        case Incr_RegArrays:   return sizeof(RegIdx);
+        case Incr_ConstArrays: return sizeof(int64);
+        case Incr_ArgRules:    return sizeof(TB_PassingRule);
+        case Incr_Instrs:      return sizeof(Interp_Instr);
+        case Incr_ArgTypes:    return sizeof(Interp_Type);
+        default:               return 0;
+    }
+}
+
+bool Incr_Read(Incr_Reader* r, void* dst, uint64 size)
+{
+    if((uint64)(r->end - r->at) < size) return false;
+    
+    memcpy(dst, r->at, size);
+    r->at += size;
+    return true;
+}
+
+bool Incr_ReadBlob(Incr_Reader* r, Incr_Blob* blob, uint32 elementSize)
+{
+    if(!Incr_Read(r, &blob->length, sizeof(uint32))) return false;
+    
+    uint64 size = (uint64)blob->length * elementSize;
+    if((uint64)(r->end - r->at) < size) return false;
+    
+    blob->ptr = r->at;
+    r->at += size;
+    return true;
+}
+
+void Incr_Write(Arena* out, void* src, uint64 size)
+{
+    if(size > 0) Arena_AllocAndCopy(out, src, size, 1);
+}
+
+void Incr_WriteBlob(Arena* out, void* ptr, uint32 length, uint32 elementSize)
+{
+    Incr_Write(out, &length, sizeof(length));
+    Incr_Write(out, ptr, (uint64)length * elementSize);
+}
+
+template<typename t>
+void Incr_CopyArray(Array<t>* dst, Incr_Blob blob)
+{
+    dst->Resize(blob.length);
+    if(blob.length > 0)
+        memcpy(dst->ptr, blob.ptr, sizeof(t) * blob.length);
+}
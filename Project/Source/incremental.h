@@ -0,0 +1,135 @@
+
+#pragma once
+
+#include "base.h"
+#include "dependency_graph.h"
+#include "lexer.h"
+#include "parser.h"
+#include "interpreter.h"
+#include "os/os_agnostic.h"
+
+// NOTE: Incremental recompilation, enabled with "-incremental <path>".
+// After a successful compilation, a cache is written with a fingerprint of
+// the tokens of each top-level declaration, the entities each one used
+// while it was typechecked (see Dg_RecordUse), and the bytecode of each
+// procedure before inlining. The next compilation of the same program
+// compares the fingerprints: an entity is dirty if its tokens changed, if
+// it was removed, or if anything it used is dirty (transitively). The
+// bodies of the procedures which are not dirty are not typechecked again,
+// and their bytecode is taken from the cache (Entity_Cached).
+// Declarations, structs and global variables are always checked again:
+// they're cheap, and the rest of the program needs their types anyway.
+// The fingerprint of a procedure declaration only covers its signature,
+// so that editing a body doesn't invalidate its callers.
+// Entities are matched by kind, name and ordinal (the n-th entity with
+// the same kind and name), since the AST isn't stable across compilations.
+// Symbol references in the cached bytecode are stored as entities of the
+// declarations they refer to, and are remapped to the current symbols.
+
+#define Incr_Magic   "RYUINCR"
+#define Incr_Version 1
+// Entry of an entity which is not in the cache
+#define Incr_None    UINT32_MAX
+// Size of an entry without a name, uses or bytecode: kind, ordinal,
+// name length, fingerprint, number of uses and hasProc
+#define Incr_MinEntrySize (1 + 4 + 4 + 8 + 4 + 1)
+
+struct Incr_Header
+{
+    char magic[8];
+    uint32 version;
+    uint32 layoutId;  // Instructions are stored as they are in memory
+    uint64 buildId;
+    uint32 numEntries;
+};
+
+// The arrays of a cached Interp_Proc, in this order in the file
+enum Incr_ProcArray
+{
+    Incr_InstrArrays = 0,
+    Incr_RegArrays,
+    Incr_ConstArrays,
+    Incr_ArgRules,
+    Incr_Instrs,
+    Incr_ArgTypes,
+    
+    Incr_NumProcArrays
+};
+
+// Points into the cache file, so it's not necessarily aligned
+struct Incr_Blob
+{
+    char* ptr;
+    uint32 length;  // In elements
+};
+
+struct Incr_Entry
+{
+    uint8 kind;  // Ast_NodeKind
+    uint32 ordinal;
+    String name;
+    uint64 fingerprint;
+    Incr_Blob uses;  // Other entries (uint32)
+    
+    // Bytecode of procedure definitions, before inlining
+    bool hasProc;
+    RegIdx maxReg;
+    InstrIdx prologueEnd;
+    bool hasSelfTailCall;
+    uint32 frameSize;
+    TB_PassingRule retRule;
+    Interp_Type retType;
+    Incr_Blob arrays[Incr_NumProcArrays];
+    
+    Dg_Idx entityIdx;  // In the current compilation, Dg_Null if it's not there anymore
+    bool dirty;
+};
+
+struct Incr_Cache
+{
+    Arena arena;
+    MappedFile file = { 0 };
+    Slice<Incr_Entry> entries = { 0, 0 };
+    
+    // One for each entity of the current compilation
+    Slice<uint64> fingerprints  = { 0, 0 };
+    Slice<uint32> ordinals      = { 0, 0 };
+    Slice<uint32> entryOfEntity = { 0, 0 };  // Incr_None if it's new
+};
+
+struct Incr_Reader
+{
+    char* at;
+    char* end;
+};
+
+// Fingerprints the entities of the parsed program, loads the cache
+// at path (if it's valid) and marks the entities whose work can be
+// reused. Returns false if the program can't be compiled incrementally,
+// in which case the cache shouldn't be written either.
+bool Incr_Prepare(Incr_Cache* cache, Parser* p, char* path);
+// To be called right after MainDriver succeeds, before inlining
+bool Incr_WriteCache(Incr_Cache* cache, Parser* p, Interp* interp, char* path);
+void Incr_Free(Incr_Cache* cache);
+// Called instead of Interp_ConvertProc for entities marked with Entity_Cached
+bool Incr_ReuseProc(Incr_Cache* cache, Interp* interp, Ast_ProcDef* astProc);
+
+bool Incr_ComputeFingerprints(Incr_Cache* cache, Parser* p);
+uint64 Incr_HashTokens(Tokenizer* t, TokenIdx start, TokenIdx end);
+// Returns false if the file is not a valid cache for this compiler
+bool Incr_ReadCache(Incr_Cache* cache);
+void Incr_MatchEntities(Incr_Cache* cache, Parser* p);
+void Incr_PropagateDirty(Incr_Cache* cache);
+// Checks that the symbols referenced by the bytecode of the entry are still there
+bool Incr_CanReuse(Incr_Cache* cache, Slice<Dg_Entity> entities, Incr_Entry* entry);
+int64 Incr_EntityKey(uint8 kind, String name, uint32 ordinal);
+uint32 Incr_LayoutId();
+uint32 Incr_ElementSize(Incr_ProcArray array);
+
+// Reading and writing of the cache file
+bool Incr_Read(Incr_Reader* r, void* dst, uint64 size);
+bool Incr_ReadBlob(Incr_Reader* r, Incr_Blob* blob, uint32 elementSize);
+void Incr_Write(Arena* out, void* src, uint64 size);
+void Incr_WriteBlob(Arena* out, void* ptr, uint32 length, uint32 elementSize);
+template<typename t>
+void Incr_CopyArray(Array<t>* dst, Incr_Blob blob);
@@ -4,6 +4,8 @@
 #include "base.h"
 #include "interpreter.h"
 #include "bytecode_builder.h"
+#include "jit.h"
+#include "incremental.h"
 
 bool GenBytecode(Interp* interp, Ast_Node* node)
 {
@@ -24,6 +26,18 @@ bool GenBytecode(Interp* interp, Ast_Node* node)
     else if(node->kind == AstKind_ProcDef)
     {
         auto astProc = (Ast_ProcDef*)node;
+        
+        // Unchanged since the last compilation, with -incremental
+        if(interp->graph->items[astProc->entityIdx].flags & Entity_Cached)
+        {
+            if(!Incr_ReuseProc(interp->graph->incr, interp, astProc)) return false;
+            
+            if(cmdLineArgs.emitBytecode)
+                Interp_PrintProc(&interp->procs[astProc->procIdx], interp->symbols);
+            
+            return true;
+        }
+        
         bool yielded = false;
         auto proc = Interp_ConvertProc(interp, astProc, &yielded);
         
@@ -214,7 +228,9 @@ RegIdx Interp_GetRVal(Interp_Builder* builder, Interp_Val val, TypeInfo* type)
     
     if(val.type == Interp_LValue)
     {
-        val.reg = Interp_Load(builder, Interp_ConvertType(type), val.reg, type->align, false);
+        // Arrays decay to the address of their first element
+        if(type->typeId != Typeid_Arr)
+            val.reg = Interp_Load(builder, Interp_ConvertType(type), val.reg, type->align, false);
         val.type = Interp_RValue;
     }
     else if(val.type == Interp_RValuePhi)
@@ -602,9 +618,16 @@ void Interp_ConvertSwitch(Interp_Builder* builder, Ast_Switch* stmt)
     ScratchArena scratch;
     
     RegIdx value = Interp_ConvertNodeRVal(builder, stmt->switchExpr);
-    Interp_EndOfExpression(builder);
     
-    auto branchInstr = Interp_If(builder, value);
+    // Keys are 64-bit constants, so the value is extended to 64 bits
+    // as well. This way jump table bounds checks and binary search
+    // comparisons don't have to care about the width of the value.
+    auto switchType = stmt->switchExpr->type;
+    if(switchType->size < 8)
+    {
+        auto wideType = switchType->isSigned ? &Typer_Int64 : &Typer_Uint64;
+        value = Interp_ConvertTypeConversion(builder, value, Interp_ConvertType(switchType), switchType, wideType);
+    }
     
     Slice<int64> caseVals = { 0, 0 };
     Slice<InstrIdx> caseRegions = { 0, 0 };  // Does not include default case
@@ -619,9 +642,18 @@ void Interp_ConvertSwitch(Interp_Builder* builder, Ast_Switch* stmt)
         
         int64 intValue = *(int64*)constValue->addr;
         caseVals.Append(scratch, intValue);
-        Interp_EndOfExpression(builder);
     }
     
+    // A branch with a single case is an if (see Interp_If),
+    // so in that case the comparison has to be explicit
+    bool singleCase = caseVals.length == 1;
+    if(singleCase)
+        value = Interp_CmpEq(builder, value, Interp_ImmSInt(builder, Interp_Int64, caseVals[0]));
+    
+    Interp_EndOfExpression(builder);
+    
+    auto branchInstr = Interp_If(builder, value);
+    
     for_array(i, stmt->stmts)
     {
         auto caseRegion = Interp_Region(builder);
@@ -651,7 +683,11 @@ void Interp_ConvertSwitch(Interp_Builder* builder, Ast_Switch* stmt)
     if(defaultCase == InstrIdx_Unused)
         defaultCase = exit;
     
-    Interp_PatchBranch(builder, branchInstr, caseVals, caseRegions, defaultCase);
+    if(singleCase)
+        Interp_PatchIf(builder, branchInstr, value, caseRegions[0], defaultCase);
+    else
+        Interp_PatchBranch(builder, branchInstr, caseVals, caseRegions, defaultCase);
+    
     Interp_PatchJumps(builder, exit, &builder->breaks);
     Assert(builder->continues.length <= 0);
 }
@@ -691,10 +727,205 @@ void Interp_ConvertReturn(Interp_Builder* builder, Ast_Return* stmt)
         
         int lastRet = stmt->rets.length - 1;
         auto toRet = Interp_BuildPreRet(builder, 0, regs[lastRet], stmt->rets[lastRet]->type, proc->retRule);
+        
+        // Calls in tail position can reuse the caller's frame, as long
+        // as there's nothing left to do after them. This is only a candidate,
+        // see Interp_ApplyTailCalls
+        if(builder->deferStack.length == 0 && stmt->rets.length == 1 &&
+           stmt->rets[0]->kind == AstKind_FuncCall)
+        {
+            auto call = (Ast_FuncCall*)stmt->rets[0];
+            if(Interp_IsTailCallCompatible(builder, call))
+            {
+                Builder_TailCall tailCall;
+                tailCall.retInstr = proc->instrs.length;
+                tailCall.isSelf   = false;
+                
+                if(call->target->kind == AstKind_Ident)
+                {
+                    auto decl = ((Ast_IdentExpr*)call->target)->declaration;
+                    tailCall.isSelf = decl->kind == AstKind_ProcDecl &&
+                        ((Ast_ProcDecl*)decl)->symIdx == proc->symIdx;
+                }
+                
+                builder->tailCalls.Append(tailCall);
+            }
+        }
+        
         Interp_Return(builder, toRet);
     }
 }
 
+// The callee has to use the same passing rules as the caller,
+// so that arguments and return value can stay where they are.
+bool Interp_IsTailCallCompatible(Interp_Builder* builder, Ast_FuncCall* call)
+{
+    auto proc = builder->proc;
+    auto procType = (Ast_ProcType*)GetBaseTypeShallow(call->target->type);
+    if(procType->typeId != Typeid_Proc) return false;
+    
+    // Additional returns are passed by pointer
+    if(procType->retTypes.length != 1) return false;
+    if(procType->args.length != proc->argRules.length) return false;
+    
+    for_array(i, procType->args)
+    {
+        auto debugType = Tc_ConvertToDebugType(proc->module, procType->args[i]->type);
+        TB_PassingRule rule = tb_get_passing_rule_from_dbg(proc->module, debugType, false);
+        
+        // Indirect arguments are copies living in the caller's frame
+        if(rule != proc->argRules[i] || rule == TB_PASSING_INDIRECT)
+            return false;
+    }
+    
+    auto retDebugType = Tc_ConvertToDebugType(proc->module, procType->retTypes[0]);
+    TB_PassingRule retRule = tb_get_passing_rule_from_dbg(proc->module, retDebugType, true);
+    return retRule == TB_PASSING_DIRECT && retRule == proc->retRule;
+}
+
+// Turns candidates into actual tail calls, once the whole
+// procedure is known
+void Interp_ApplyTailCalls(Interp_Builder* builder)
+{
+    auto proc = builder->proc;
+    if(builder->tailCalls.length <= 0) return;
+    
+    // The frame can only be reused if the address of
+    // a local can't outlive the current call
+    if(Interp_LocalsEscape(proc)) return;
+    
+    for_array(i, builder->tailCalls)
+    {
+        auto tailCall = builder->tailCalls[i];
+        if(tailCall.retInstr <= 0) continue;
+        
+        auto& ret  = proc->instrs[tailCall.retInstr];
+        auto& call = proc->instrs[tailCall.retInstr - 1];
+        Assert(ret.op == Op_Ret);
+        
+        // The returned value has to be the result of the call as is
+        if(call.op != Op_Call || (ret.bitfield & InstrBF_RetVoid) || ret.unary.src != call.dst)
+            continue;
+        
+        call.op = Op_TailCall;
+        if(tailCall.isSelf)
+        {
+            call.bitfield |= InstrBF_SelfTailCall;
+            proc->hasSelfTailCall = true;
+        }
+    }
+}
+
+// NOTE: This is very conservative, any use of an address
+// that is not a plain load or store counts as an escape.
+// @performance Could be less conservative
+bool Interp_LocalsEscape(Interp_Proc* proc)
+{
+    ScratchArena scratch;
+    Slice<bool> isAddr = { 0, 0 };
+    isAddr.Resize(scratch, proc->maxReg + 1);
+    for_array(i, isAddr)
+        isAddr[i] = false;
+    
+    for_array(i, proc->instrs)
+    {
+        auto& instr = proc->instrs[i];
+        switch(instr.op)
+        {
+            case Op_Local: isAddr[instr.dst] = true; break;
+            case Op_MemberAccess: isAddr[instr.dst] = isAddr[instr.memacc.base]; break;
+            case Op_ArrayAccess:
+            {
+                if(isAddr[instr.arracc.idx]) return true;
+                isAddr[instr.dst] = isAddr[instr.arracc.base];
+                break;
+            }
+            case Op_Select:
+            {
+                if(isAddr[instr.sel.cond] || isAddr[instr.sel.a] || isAddr[instr.sel.b]) return true;
+                break;
+            }
+            case Op_Store:
+            {
+                if(isAddr[instr.store.val]) return true;
+                break;
+            }
+            case Op_Call:
+            case Op_TailCall:
+            {
+                for(int j = 0; j < instr.call.argCount; ++j)
+                {
+                    if(isAddr[proc->regArrays[instr.call.argStart + j]])
+                        return true;
+                }
+                
+                break;
+            }
+            case Op_Ret:
+            {
+                if(!(instr.bitfield & InstrBF_RetVoid) && isAddr[instr.unary.src])
+                    return true;
+                break;
+            }
+            case Op_Truncate:
+            case Op_FloatExt:
+            case Op_SignExt:
+            case Op_ZeroExt:
+            case Op_Int2Ptr:
+            case Op_Ptr2Int:
+            case Op_Uint2Float:
+            case Op_Float2Uint:
+            case Op_Int2Float:
+            case Op_Float2Int:
+            case Op_Bitcast:
+            case Op_Not:
+            case Op_Negate:
+            {
+                if(isAddr[instr.unary.src]) return true;
+                break;
+            }
+            case Op_Null:
+            case Op_IntegerConst:
+            case Op_Float32Const:
+            case Op_Float64Const:
+            case Op_Region:
+            case Op_SysCall:
+            case Op_Load:
+            case Op_MemCpy:
+            case Op_MemSet:
+            case Op_DebugBreak:
+            case Op_Branch:
+            case Op_GetSymbolAddress: break;
+            default:  // Binary operators
+            {
+                if(isAddr[instr.bin.src1] || isAddr[instr.bin.src2]) return true;
+                break;
+            }
+        }
+    }
+    
+    return false;
+}
+
+// Assigns each local a fixed offset in the frame, so that
+// executing Op_Local more than once yields the same address
+void Interp_ComputeFrameLayout(Interp_Proc* proc)
+{
+    uint32 offset = 0;
+    for_array(i, proc->instrs)
+    {
+        auto& instr = proc->instrs[i];
+        if(instr.op != Op_Local) continue;
+        
+        uint32 align = max((uint32)1, instr.local.align);
+        offset = (offset + align - 1) & ~(align - 1);
+        instr.local.offset = offset;
+        offset += instr.local.size;
+    }
+    
+    proc->frameSize = offset;
+}
+
 void Interp_ConvertSimpleJump(Interp_Builder* builder, Array<InstrIdx>* toPatch)
 {
     // Convert defer statements of the current scope only
@@ -1161,6 +1392,30 @@ Interp_Val Interp_ConvertTernaryExpr(Interp_Builder* builder, Ast_TernaryExpr* e
 Interp_Val Interp_ConvertSubscript(Interp_Builder* builder, Ast_Subscript* expr)
 {
     Interp_Val res;
+    res.type = Interp_LValue;
+    
+    // Arrays are stored inline, so their address is the base,
+    // while pointers have to be loaded first.
+    RegIdx base;
+    if(expr->target->type->typeId == Typeid_Arr)
+    {
+        auto target = Interp_ConvertNode(builder, expr->target);
+        Assert(Interp_IsValueValid(target) && target.type == Interp_LValue);
+        base = target.reg;
+    }
+    else
+        base = Interp_ConvertNodeRVal(builder, expr->target);
+    
+    // The index is extended to 64 bits, the same as the address
+    RegIdx idx = Interp_ConvertNodeRVal(builder, expr->idxExpr);
+    auto idxType = expr->idxExpr->castType;
+    if(idxType->size < 8)
+    {
+        auto wideType = idxType->isSigned ? &Typer_Int64 : &Typer_Uint64;
+        idx = Interp_ConvertTypeConversion(builder, idx, Interp_ConvertType(idxType), idxType, wideType);
+    }
+    
+    res.reg = Interp_ArrayAccess(builder, base, idx, expr->type->size);
     return res;
 }
 
@@ -1296,6 +1551,8 @@ Interp_Proc* Interp_ConvertProc(Interp* interp, Ast_ProcDef* astProc, bool* outY
     }
     
     proc->symIdx = astProc->decl->symIdx;
+    proc->entityIdx = astProc->entityIdx;
+    interp->symbols[proc->symIdx].procIdx = astProc->procIdx;
     
     proc->argRules.Resize(astDecl->args.length);
     // NOTE: We also have all returns except for the last one. Those are just pointers.
@@ -1376,6 +1633,8 @@ Interp_Proc* Interp_ConvertProc(Interp* interp, Ast_ProcDef* astProc, bool* outY
         }
     }
     
+    proc->prologueEnd = proc->instrs.length;
+    
     // Block
     Interp_ConvertBlock(builder, &astProc->block);
     
@@ -1385,6 +1644,9 @@ Interp_Proc* Interp_ConvertProc(Interp* interp, Ast_ProcDef* astProc, bool* outY
     if(!builder->genJump) Interp_ReturnVoid(builder);
     builder->genJump = true;
     
+    Interp_ApplyTailCalls(builder);
+    Interp_ComputeFrameLayout(proc);
+    
     // Fill in these helper arrays for codegen
     if(proc->retRule == TB_PASSING_INDIRECT)
         proc->argTypes.Append(Interp_Ptr);
@@ -1526,7 +1788,1021 @@ RegIdx Interp_ConvertTypeConversion(Interp_Builder* builder, RegIdx src, Interp_
     return res;
 }
 
-void Interp_ExecProc(Interp_Proc* proc)
+// Inlining
+
+// NOTE: This runs once all procedures have been converted,
+// and it only inlines leaf procedures, so the order in which
+// the procedures are visited doesn't matter.
+void Interp_InlineProcs(Interp* interp)
+{
+    ProfileFunc(prof);
+    
+    for_array(i, interp->procs)
+    {
+        auto proc = &interp->procs[i];
+        bool inlined = Interp_InlineCalls(interp, proc);
+        
+        if(inlined && cmdLineArgs.emitBytecode)
+        {
+            printf("After inlining, ");
+            Interp_PrintProc(proc, interp->symbols);
+        }
+    }
+}
+
+// Splices the bodies of small callees in place of their calls.
+// Callee registers are moved past the caller's, and its regions
+// are remapped to their new position. Returns true if anything
+// was inlined.
+bool Interp_InlineCalls(Interp* interp, Interp_Proc* proc)
+{
+    ScratchArena scratch;
+    
+    // Find the call sites first
+    Slice<Interp_Proc*> callees = { 0, 0 };
+    callees.Resize(scratch, proc->instrs.length);
+    
+    int growth = 0;
+    bool found = false;
+    for_array(i, proc->instrs)
+    {
+        callees[i] = Interp_GetInlineCandidate(interp, proc, i);
+        if(!callees[i]) continue;
+        
+        int calleeSize = callees[i]->instrs.length;
+        bool outOfRegs = proc->maxReg + 1 + callees[i]->maxReg >= RegIdx_Unused;
+        if(growth + calleeSize > Interp_InlineMaxGrowth || outOfRegs)
+        {
+            callees[i] = 0;
+            continue;
+        }
+        
+        growth += calleeSize;
+        found = true;
+    }
+    
+    if(!found) return false;
+    
+    Array<Interp_Instr> newInstrs;
+    newInstrs.Init(proc->instrs.length + growth);
+    
+    // Old instruction index -> new instruction index
+    Slice<InstrIdx> instrMap = { 0, 0 };
+    instrMap.Resize(scratch, proc->instrs.length);
+    
+    // Only the arrays which are already there refer to
+    // old indices, the callees' ones are remapped while copying
+    uint32 oldInstrArraysLength = proc->instrArrays.length;
+    
+    // All inlined bodies can share the same registers,
+    // as none of their values outlive the call
+    RegIdx regBase = proc->maxReg + 1;
+    RegIdx newMaxReg = proc->maxReg;
+    
+    for_array(i, proc->instrs)
+    {
+        auto instr = proc->instrs[i];
+        auto callee = callees[i];
+        instrMap[i] = newInstrs.length;
+        
+        if(!callee)
+        {
+            newInstrs.Append(instr);
+            continue;
+        }
+        
+        // Arguments are already lowered according to the passing
+        // rules, so the callee's parameters are exactly the
+        // registers that were passed to the call
+        Slice<RegIdx> regMap = { 0, 0 };
+        regMap.Resize(scratch, callee->maxReg + 1);
+        for_array(j, regMap)
+        {
+            if(j < instr.call.argCount)
+                regMap[j] = proc->regArrays[instr.call.argStart + j];
+            else
+                regMap[j] = regBase + j;
+        }
+        
+        // The value returned by the callee is written directly
+        // to the destination of the call
+        auto ret = callee->instrs.last();
+        if(!(ret.bitfield & InstrBF_RetVoid))
+            regMap[ret.unary.src] = instr.dst;
+        
+        newMaxReg = max(newMaxReg, (RegIdx)(regBase + callee->maxReg));
+        
+        // Copy everything except for the return,
+        // which is the last instruction
+        InstrIdx calleeStart = newInstrs.length;
+        for(int j = 0; j < callee->instrs.length - 1; ++j)
+        {
+            auto copy = callee->instrs[j];
+            Interp_RemapInstrRegs(&copy, regMap);
+            
+            if(copy.op == Op_Branch)
+            {
+                copy.branch.defaultCase += calleeStart;
+                if(copy.branch.count > 0)
+                {
+                    uint32 caseStart = proc->instrArrays.length;
+                    uint32 keyStart  = proc->constArrays.length;
+                    for(int k = 0; k < copy.branch.count; ++k)
+                    {
+                        proc->instrArrays.Append(callee->instrArrays[copy.branch.caseStart + k] + calleeStart);
+                        proc->constArrays.Append(callee->constArrays[copy.branch.keyStart + k]);
+                    }
+                    
+                    copy.branch.caseStart = caseStart;
+                    copy.branch.keyStart  = keyStart;
+                }
+            }
+            
+            newInstrs.Append(copy);
+        }
+    }
+    
+    // Remap the regions referred to by the caller's branches
+    for_array(i, proc->instrs)
+    {
+        if(callees[i]) continue;
+        
+        auto& instr = newInstrs[instrMap[i]];
+        if(instr.op == Op_Branch)
+            instr.branch.defaultCase = instrMap[instr.branch.defaultCase];
+    }
+    
+    for(uint32 i = 0; i < oldInstrArraysLength; ++i)
+    {
+        auto& target = proc->instrArrays[i];
+        if(target < instrMap.length)
+            target = instrMap[target];
+    }
+    
+    if(proc->prologueEnd < instrMap.length)
+        proc->prologueEnd = instrMap[proc->prologueEnd];
+    
+    proc->instrs.FreeAll();
+    proc->instrs = newInstrs;
+    proc->maxReg = newMaxReg;
+    
+    // Callee locals are now part of the caller's frame
+    Interp_ComputeFrameLayout(proc);
+    return true;
+}
+
+// Returns the procedure called by the instruction, if it can be inlined there
+Interp_Proc* Interp_GetInlineCandidate(Interp* interp, Interp_Proc* proc, InstrIdx callIdx)
+{
+    auto& call = proc->instrs[callIdx];
+    if(call.op != Op_Call) return 0;
+    
+    // The result of the call is one of the values of a
+    // logical operator, the codegen needs it to be the last instruction
+    if(call.bitfield & InstrBF_ViolatesSSA) return 0;
+    
+    // Find the definition of the target, in the same basic block
+    for(int i = callIdx - 1; i >= 0; --i)
+    {
+        auto& instr = proc->instrs[i];
+        if(instr.op == Op_Region || instr.op == Op_Branch) return 0;
+        if(!Interp_OpUsesDst[instr.op] || instr.dst != call.call.target) continue;
+        
+        // Indirect call
+        if(instr.op != Op_GetSymbolAddress) return 0;
+        
+        auto& symbol = interp->symbols[instr.symAddress.symbol];
+        if(symbol.type != Interp_ProcSym || symbol.procIdx == ProcIdx_Unused) return 0;
+        
+        auto callee = &interp->procs[symbol.procIdx];
+        if(callee == proc || !Interp_CanInline(interp, callee)) return 0;
+        
+        // Number of arguments, after being lowered according to the passing rules
+        auto procType = (Ast_ProcType*)interp->symbols[callee->symIdx].typeInfo;
+        int64 abiArgsCount = procType->args.length + max((int64)0, procType->retTypes.length - 1) +
+                             (callee->retRule == TB_PASSING_INDIRECT);
+        if(abiArgsCount != call.call.argCount) return 0;
+        
+        // Returns a parameter (indirect return), it can't be renamed
+        auto ret = callee->instrs.last();
+        if(!(ret.bitfield & InstrBF_RetVoid) && ret.unary.src < call.call.argCount) return 0;
+        
+        return callee;
+    }
+    
+    return 0;
+}
+
+// Only small leaf procedures with a single return at the
+// end are inlined, which is what accessors look like.
+bool Interp_CanInline(Interp* interp, Interp_Proc* callee)
+{
+    if(callee->instrs.length <= 0 || callee->instrs.length > Interp_InlineMaxInstrs)
+        return false;
+    
+    if(callee->instrs.last().op != Op_Ret) return false;
+    
+    for(int i = 0; i < callee->instrs.length - 1; ++i)
+    {
+        switch(callee->instrs[i].op)
+        {
+            case Op_Null:
+            case Op_Ret:
+            case Op_Call:
+            case Op_TailCall:
+            case Op_SysCall:
+            case Op_AtomicTestAndSet:
+            case Op_AtomicClear:
+            case Op_AtomicLoad:
+            case Op_AtomicExchange:
+            case Op_AtomicAdd:
+            case Op_AtomicSub:
+            case Op_AtomicAnd:
+            case Op_AtomicXor:
+            case Op_AtomicOr:
+            case Op_AtomicCompareExchange: return false;
+            default: break;
+        }
+    }
+    
+    return true;
+}
+
+void Interp_RemapInstrRegs(Interp_Instr* instr, Slice<RegIdx> regMap)
+{
+    if(Interp_OpUsesDst[instr->op])
+        instr->dst = regMap[instr->dst];
+    
+    switch(instr->op)
+    {
+        case Op_IntegerConst:
+        case Op_Float32Const:
+        case Op_Float64Const:
+        case Op_Region:
+        case Op_DebugBreak:
+        case Op_Local:
+        case Op_GetSymbolAddress: break;
+        case Op_Store:
+        {
+            instr->store.addr = regMap[instr->store.addr];
+            instr->store.val  = regMap[instr->store.val];
+            break;
+        }
+        case Op_Load: instr->load.addr = regMap[instr->load.addr]; break;
+        case Op_MemCpy:
+        {
+            instr->memcpy.dst   = regMap[instr->memcpy.dst];
+            instr->memcpy.src   = regMap[instr->memcpy.src];
+            instr->memcpy.count = regMap[instr->memcpy.count];
+            break;
+        }
+        case Op_MemSet:
+        {
+            instr->memset.dst   = regMap[instr->memset.dst];
+            instr->memset.val   = regMap[instr->memset.val];
+            instr->memset.count = regMap[instr->memset.count];
+            break;
+        }
+        case Op_Branch:
+        {
+            if(instr->branch.count > 0)
+                instr->branch.value = regMap[instr->branch.value];
+            break;
+        }
+        case Op_MemberAccess: instr->memacc.base = regMap[instr->memacc.base]; break;
+        case Op_ArrayAccess:
+        {
+            instr->arracc.base = regMap[instr->arracc.base];
+            instr->arracc.idx  = regMap[instr->arracc.idx];
+            break;
+        }
+        case Op_Select:
+        {
+            instr->sel.cond = regMap[instr->sel.cond];
+            instr->sel.a    = regMap[instr->sel.a];
+            instr->sel.b    = regMap[instr->sel.b];
+            break;
+        }
+        case Op_Ret:
+        {
+            if(!(instr->bitfield & InstrBF_RetVoid))
+                instr->unary.src = regMap[instr->unary.src];
+            break;
+        }
+        case Op_Truncate:
+        case Op_FloatExt:
+        case Op_SignExt:
+        case Op_ZeroExt:
+        case Op_Int2Ptr:
+        case Op_Ptr2Int:
+        case Op_Uint2Float:
+        case Op_Float2Uint:
+        case Op_Int2Float:
+        case Op_Float2Int:
+        case Op_Bitcast:
+        case Op_Not:
+        case Op_Negate: instr->unary.src = regMap[instr->unary.src]; break;
+        default:  // Binary operators
+        {
+            instr->bin.src1 = regMap[instr->bin.src1];
+            instr->bin.src2 = regMap[instr->bin.src2];
+            break;
+        }
+    }
+}
+
+// Virtual machine
+
+VirtualMachine Interp_InitVM(Interp* interp)
+{
+    VirtualMachine vm;
+    vm.interp       = interp;
+    vm.stackArena   = Arena_VirtualMemInit(GB(1), MB(2));
+    vm.regStack     = Arena_VirtualMemInit(GB(1), MB(2));
+    vm.globalsArena = Arena_VirtualMemInit(GB(1), MB(2));
+    
+    vm.globalAddrs.Init(max((int64)Array_MinCapacity, interp->symbols.length));
+    vm.globalAddrs.Resize(interp->symbols.length);
+    for_array(i, vm.globalAddrs)
+        vm.globalAddrs[i] = 0;
+    
+    vm.stackFrameAddress = 0;
+    vm.programCounter = 0;
+    
+    // Compiled procedures would not be profiled
+    vm.jit = Jit_Supported && !cmdLineArgs.noJit && !cmdLineArgs.vmProfile;
+    if(vm.jit)
+    {
+        vm.jitStates.Init(max((int64)Array_MinCapacity, interp->procs.length));
+        vm.jitStates.ResizeAndInit(interp->procs.length);
+        vm.jitCodeReserved = GB(1);
+        vm.jitCode = (uchar*)ReserveMemory(vm.jitCodeReserved);
+    }
+    
+    vm.profile = cmdLineArgs.vmProfile;
+    if(vm.profile)
+    {
+        vm.profileArena = Arena_VirtualMemInit(GB(1), MB(2));
+        vm.procProfiles.ResizeAndInit(&vm.profileArena, interp->procs.length);
+        for_array(i, vm.procProfiles)
+        {
+            auto& instrCounts = vm.procProfiles[i].instrCounts;
+            instrCounts.Resize(&vm.profileArena, interp->procs[i].instrs.length);
+            memset(instrCounts.ptr, 0, sizeof(uint64) * instrCounts.length);
+        }
+    }
+    
+    return vm;
+}
+
+void Interp_FreeVM(VirtualMachine* vm)
+{
+    Arena_Free(&vm->stackArena);
+    Arena_Free(&vm->regStack);
+    Arena_Free(&vm->globalsArena);
+    vm->globalAddrs.FreeAll();
+    
+    if(vm->profile)
+        Arena_Free(&vm->profileArena);
+    
+    if(vm->jit)
+    {
+        FreeMemory(vm->jitCode, vm->jitCodeReserved);
+        vm->jitStates.FreeAll();
+    }
+}
+
+Interp_Proc* Interp_FindProc(Interp* interp, char* name)
+{
+    for_array(i, interp->procs)
+    {
+        auto& proc = interp->procs[i];
+        if(interp->symbols[proc.symIdx].name == name)
+            return &proc;
+    }
+    
+    return 0;
+}
+
+void Interp_RuntimeError(VirtualMachine* vm, char* message)
+{
+    SetErrorColor();
+    fprintf(stderr, "Runtime Error");
+    ResetColor();
+    fprintf(stderr, ": %s\n", message);
+    vm->status = false;
+}
+
+// Profiling
+
+Interp_ProcProfile* Interp_ProfileBegin(VirtualMachine* vm, Interp_Proc* proc)
+{
+    if(!vm->profile) return 0;
+    
+    auto profile = &vm->procProfiles[proc - vm->interp->procs.ptr];
+    ++profile->calls;
+    
+#ifdef Profile
+    // Show up in the compiler's trace, nested inside Interp_ExecProc
+    auto& name = vm->interp->symbols[proc->symIdx].name;
+    Spall_Begin(name.ptr, name.length + 1);
+#endif
+    
+    return profile;
+}
+
+void Interp_ProfileEnd(Interp_ProcProfile* profile, uint64 enterTime, uint64 childCycles)
+{
+    uint64 inclusive = __rdtsc() - enterTime;
+    profile->inclusiveCycles += inclusive;
+    profile->exclusiveCycles += inclusive - min(inclusive, childCycles);
+    
+#ifdef Profile
+    Spall_End();
+#endif
+}
+
+void Interp_PrintVMProfile(VirtualMachine* vm)
+{
+    ScratchArena scratch;
+    auto interp = vm->interp;
+    auto& profiles = vm->procProfiles;
+    
+    // Sort procedures by exclusive time
+    Slice<int> order = { 0, 0 };
+    for_array(i, profiles)
+    {
+        if(profiles[i].calls > 0)
+            order.Append(scratch, i);
+    }
+    
+    {
+        int tmp;
+#define Tmp_Less(i, j) profiles[order[i]].exclusiveCycles > profiles[order[j]].exclusiveCycles
+#define Tmp_Swap(i, j) tmp = order[i], order[i] = order[j], order[j] = tmp
+        QSORT(order.length, Tmp_Less, Tmp_Swap);
+#undef Tmp_Swap
+#undef Tmp_Less
+    }
+    
+    const double msPerCycle = 1000.0 / GetRdtscFreq();
+    
+    printf("----- VM Profile -----\n");
+    printf("%12s %14s %14s %14s  %s\n", "Calls", "Instructions", "Inclusive", "Exclusive", "Procedure");
+    for_array(i, order)
+    {
+        auto& profile = profiles[order[i]];
+        auto& name = interp->symbols[interp->procs[order[i]].symIdx].name;
+        
+        uint64 instrsExecuted = 0;
+        for_array(j, profile.instrCounts)
+            instrsExecuted += profile.instrCounts[j];
+        
+        printf("%12llu %14llu %12.3lfms %12.3lfms  %.*s\n", profile.calls, instrsExecuted,
+               profile.inclusiveCycles * msPerCycle, profile.exclusiveCycles * msPerCycle,
+               (int)name.length, name.ptr);
+    }
+    
+    printf("\n");
+    
+    // Annotated listing
+    for_array(i, order)
+    {
+        Interp_PrintProc(&interp->procs[order[i]], interp->symbols, profiles[order[i]].instrCounts);
+    }
+    
+    printf("----------------------\n");
+}
+
+cforceinline bool Interp_IsFloat32(Interp_Type type)
+{
+    return type.type == InterpType_Float && type.data == FType_Flt32;
+}
+
+cforceinline double Interp_GetFloat(Interp_Register reg)
 {
+    return Interp_IsFloat32(reg.type) ? reg.float32Value : reg.float64Value;
+}
+
+cforceinline void Interp_SetFloat(Interp_Register* reg, Interp_Type type, double value)
+{
+    reg->value = 0;
+    reg->type = type;
+    if(Interp_IsFloat32(type))
+        reg->float32Value = (float)value;
+    else
+        reg->float64Value = value;
+}
+
+// Dispatch of Op_Branch, according to the lowering picked
+// by Interp_PatchBranch
+InstrIdx Interp_BranchTarget(Interp_Proc* proc, Interp_Instr* instr, int64 value)
+{
+    auto& branch = instr->branch;
+    
+    // Goto
+    if(branch.count == 0) return branch.defaultCase;
     
+    // Branches with a single case are ifs (see Interp_If)
+    if(branch.count == 1)
+        return value != 0 ? proc->instrArrays[branch.caseStart] : branch.defaultCase;
+    
+    int64* keys     = &proc->constArrays[branch.keyStart];
+    InstrIdx* cases = &proc->instrArrays[branch.caseStart];
+    
+    if(instr->bitfield & InstrBF_JumpTable)
+    {
+        // A single unsigned comparison handles both bounds
+        uint64 idx = (uint64)value - (uint64)keys[0];
+        return idx < branch.count ? cases[idx] : branch.defaultCase;
+    }
+    
+    if(instr->bitfield & InstrBF_BinarySearch)
+    {
+        int lo = 0;
+        int hi = branch.count;
+        while(lo < hi)
+        {
+            int mid = lo + (hi - lo) / 2;
+            if(keys[mid] < value)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+        
+        return lo < branch.count && keys[lo] == value ? cases[lo] : branch.defaultCase;
+    }
+    
+    for(int i = 0; i < branch.count; ++i)
+    {
+        if(keys[i] == value) return cases[i];
+    }
+    
+    return branch.defaultCase;
+}
+
+// Allocates registers and locals for the procedure, and copies
+// the arguments in the first registers
+bool Interp_PushFrame(VirtualMachine* vm, Interp_Proc* proc, Slice<Interp_Register> args, Interp_Register** outRegs, uchar** outFrame)
+{
+    int numRegs = proc->maxReg + 1;
+    auto regs = Arena_AllocArray(&vm->regStack, numRegs, Interp_Register);
+    if(!regs)
+    {
+        Interp_RuntimeError(vm, "Register stack overflow.");
+        return false;
+    }
+    
+    auto frame = (uchar*)Arena_Alloc(&vm->stackArena, max((uint32)1, proc->frameSize), 16);
+    if(!frame)
+    {
+        Interp_RuntimeError(vm, "Stack overflow.");
+        return false;
+    }
+    
+    Assert(args.length <= numRegs);
+    for_array(i, args)
+        regs[i] = args[i];
+    
+    *outRegs  = regs;
+    *outFrame = frame;
+    return true;
+}
+
+// Address of a global variable or procedure
+uchar* Interp_GetGlobalAddress(VirtualMachine* vm, SymIdx symIdx)
+{
+    auto& symbol = vm->interp->symbols[symIdx];
+    
+    // Procedures are identified by their symbol
+    if(symbol.type != Interp_GlobalSym)
+        return (uchar*)&symbol;
+    
+    // Globals are allocated the first time they're used
+    if(!vm->globalAddrs[symIdx])
+    {
+        auto type = symbol.typeInfo;
+        auto addr = (uchar*)Arena_Alloc(&vm->globalsArena, max((uint64)1, type->size), max((uint64)1, type->align));
+        memset(addr, 0, type->size);
+        vm->globalAddrs[symIdx] = addr;
+    }
+    
+    return vm->globalAddrs[symIdx];
+}
+
+Interp_Proc* Interp_GetCallee(VirtualMachine* vm, Interp_Register target)
+{
+    auto& symbols = vm->interp->symbols;
+    auto symbol = (Interp_Symbol*)target.ptrValue;
+    if(symbol < symbols.ptr || symbol >= symbols.ptr + symbols.length)
+    {
+        Interp_RuntimeError(vm, "Call through an invalid procedure pointer.");
+        return 0;
+    }
+    
+    if(symbol->type != Interp_ProcSym || symbol->procIdx == ProcIdx_Unused)
+    {
+        Interp_RuntimeError(vm, "Calling external procedures is not supported by the interpreter yet.");
+        return 0;
+    }
+    
+    return &vm->interp->procs[symbol->procIdx];
+}
+
+// NOTE: Atomics, syscalls and calls to external procedures
+// stop the VM with a runtime error.
+Interp_Register Interp_ExecProc(VirtualMachine* vm, Interp_Proc* proc, Slice<Interp_Register> args)
+{
+    ProfileFunc(prof);
+    
+    Interp_Register res;
+    res.value = 0;
+    res.type  = Interp_Void;
+    
+    // Push a new frame, it's popped on return
+    auto stackMark = Arena_TempBegin(&vm->stackArena);
+    auto regMark   = Arena_TempBegin(&vm->regStack);
+    defer({
+              Arena_TempEnd(stackMark);
+              Arena_TempEnd(regMark);
+          });
+    
+    Interp_Register* regs = 0;
+    uchar* frame = 0;
+    if(!Interp_PushFrame(vm, proc, args, &regs, &frame)) return res;
+    
+    // Hot procedures are compiled and then executed natively
+    if(vm->jit)
+    {
+        auto& jit = vm->jitStates[proc - vm->interp->procs.ptr];
+        ++jit.calls;
+        if(!jit.code && !jit.failed && jit.calls >= Jit_CallThreshold)
+        {
+            jit.code   = Jit_CompileProc(vm, proc);
+            jit.failed = !jit.code;
+        }
+        
+        if(jit.code)
+        {
+            if(!jit.code(regs, frame))
+            {
+                Interp_RuntimeError(vm, "Integer division by zero.");
+                return res;
+            }
+            
+            if(proc->retRule != TB_PASSING_IGNORE)
+            {
+                res.value = regs[0].value;
+                res.type  = proc->retType;
+            }
+            
+            return res;
+        }
+    }
+    
+    // Profiling, only if enabled
+    auto profile = Interp_ProfileBegin(vm, proc);
+    uint64* instrCounts = profile ? profile->instrCounts.ptr : 0;
+    uint64 enterTime   = profile ? __rdtsc() : 0;
+    uint64 childCycles = 0;
+    defer(if(profile) Interp_ProfileEnd(profile, enterTime, childCycles));
+    
+    Interp_Instr* instrs = proc->instrs.ptr;
+    InstrIdx pc = 0;
+    
+    // Helpers for operands
+#define Vm_Unary regs[instr->unary.src]
+#define Vm_Src1  regs[instr->bin.src1]
+#define Vm_Src2  regs[instr->bin.src2]
+#define Vm_Bits  Interp_IntBits(Vm_Src1.type)
+#define Vm_IntBin(expr) { \
+Interp_Type type = Vm_Src1.type; uint64 a = (uint64)Vm_Src1.value; uint64 b = (uint64)Vm_Src2.value; \
+dst.value = Interp_TruncBits((int64)(expr), Interp_IntBits(type)); dst.type = type; }
+#define Vm_SignedBin(expr) { \
+Interp_Type type = Vm_Src1.type; uint16 bits = Interp_IntBits(type); \
+int64 a = Interp_SignExtBits(Vm_Src1.value, bits); int64 b = Interp_SignExtBits(Vm_Src2.value, bits); \
+dst.value = Interp_TruncBits((int64)(expr), bits); dst.type = type; }
+#define Vm_FloatBin(expr) { \
+Interp_Type type = Vm_Src1.type; double a = Interp_GetFloat(Vm_Src1); double b = Interp_GetFloat(Vm_Src2); \
+Interp_SetFloat(&dst, type, (expr)); }
+#define Vm_Cmp(expr) { bool cmp = (expr); dst.value = cmp; dst.type = Interp_Bool; }
+    
+    while(true)
+    {
+        Interp_Instr* instr = &instrs[pc];
+        Interp_Register& dst = regs[instr->dst];
+        
+        if(instrCounts) ++instrCounts[pc];
+        
+        switch(instr->op)
+        {
+            case Op_Null: Assert(false && "Attempting to execute a null operation"); break;
+            case Op_IntegerConst:
+            {
+                dst.value = Interp_TruncBits(instr->imm.intVal, Interp_IntBits(instr->imm.type));
+                dst.type  = instr->imm.type;
+                break;
+            }
+            case Op_Float32Const: Interp_SetFloat(&dst, Interp_F32, instr->imm.floatVal); break;
+            case Op_Float64Const: Interp_SetFloat(&dst, Interp_F64, instr->imm.doubleVal); break;
+            case Op_Region: break;
+            case Op_Call:
+            {
+                auto callee = Interp_GetCallee(vm, regs[instr->call.target]);
+                if(!callee) return res;
+                
+                ScratchArena scratch;
+                Slice<Interp_Register> callArgs = { 0, 0 };
+                callArgs.Resize(scratch, instr->call.argCount);
+                for(int i = 0; i < instr->call.argCount; ++i)
+                    callArgs[i] = regs[proc->regArrays[instr->call.argStart + i]];
+                
+                uint64 callStart = profile ? __rdtsc() : 0;
+                auto ret = Interp_ExecProc(vm, callee, callArgs);
+                if(profile) childCycles += __rdtsc() - callStart;
+                if(!vm->status) return res;
+                
+                dst = ret;
+                break;
+            }
+            case Op_TailCall:
+            {
+                auto callee = Interp_GetCallee(vm, regs[instr->call.target]);
+                if(!callee) return res;
+                
+                // The arguments could live in the registers that are about to be overwritten
+                ScratchArena scratch;
+                Slice<Interp_Register> callArgs = { 0, 0 };
+                callArgs.Resize(scratch, instr->call.argCount);
+                for(int i = 0; i < instr->call.argCount; ++i)
+                    callArgs[i] = regs[proc->regArrays[instr->call.argStart + i]];
+                
+                if(instr->bitfield & InstrBF_SelfTailCall)
+                {
+                    // Same frame layout, just rerun the prologue with the new arguments
+                    for_array(i, callArgs)
+                        regs[i] = callArgs[i];
+                    
+                    pc = 0;
+                    continue;
+                }
+                
+                // Replace the current frame with the callee's
+                Arena_TempEnd(stackMark);
+                Arena_TempEnd(regMark);
+                if(!Interp_PushFrame(vm, callee, callArgs, &regs, &frame)) return res;
+                
+                proc   = callee;
+                instrs = proc->instrs.ptr;
+                pc     = 0;
+                
+                if(profile)
+                {
+                    Interp_ProfileEnd(profile, enterTime, childCycles);
+                    profile     = Interp_ProfileBegin(vm, proc);
+                    instrCounts = profile->instrCounts.ptr;
+                    enterTime   = __rdtsc();
+                    childCycles = 0;
+                }
+                
+                continue;
+            }
+            case Op_SysCall: Interp_RuntimeError(vm, "Syscalls are not supported by the interpreter yet."); return res;
+            case Op_Store:
+            {
+                auto& val = regs[instr->store.val];
+                memcpy(regs[instr->store.addr].ptrValue, &val.value, Interp_TypeSize(val.type));
+                break;
+            }
+            case Op_MemCpy:
+            {
+                memmove(regs[instr->memcpy.dst].ptrValue, regs[instr->memcpy.src].ptrValue,
+                        (size_t)regs[instr->memcpy.count].value);
+                break;
+            }
+            case Op_MemSet:
+            {
+                memset(regs[instr->memset.dst].ptrValue, (int)regs[instr->memset.val].value,
+                       (size_t)regs[instr->memset.count].value);
+                break;
+            }
+            case Op_AtomicTestAndSet:
+            case Op_AtomicClear:
+            case Op_AtomicLoad:
+            case Op_AtomicExchange:
+            case Op_AtomicAdd:
+            case Op_AtomicSub:
+            case Op_AtomicAnd:
+            case Op_AtomicXor:
+            case Op_AtomicOr:
+            case Op_AtomicCompareExchange:
+            {
+                Interp_RuntimeError(vm, "Atomics are not supported by the interpreter yet.");
+                return res;
+            }
+            case Op_DebugBreak: break;
+            case Op_Branch:
+            {
+                int64 value = instr->branch.count > 0 ? regs[instr->branch.value].value : 0;
+                pc = Interp_BranchTarget(proc, instr, value);
+                continue;
+            }
+            case Op_Ret:
+            {
+                if(!(instr->bitfield & InstrBF_RetVoid))
+                    res = Vm_Unary;
+                
+                return res;
+            }
+            case Op_Load:
+            {
+                Interp_Register loaded;
+                loaded.value = 0;
+                loaded.type  = instr->load.type;
+                memcpy(&loaded.value, regs[instr->load.addr].ptrValue, Interp_TypeSize(instr->load.type));
+                dst = loaded;
+                break;
+            }
+            case Op_Local:
+            {
+                // The frame is allocated on entry, see Interp_ComputeFrameLayout
+                dst.ptrValue = frame + instr->local.offset;
+                dst.type = Interp_Ptr;
+                break;
+            }
+            case Op_GetSymbolAddress:
+            {
+                dst.ptrValue = Interp_GetGlobalAddress(vm, instr->symAddress.symbol);
+                dst.type = Interp_Ptr;
+                break;
+            }
+            case Op_MemberAccess:
+            {
+                dst.value = regs[instr->memacc.base].value + instr->memacc.offset;
+                dst.type  = Interp_Ptr;
+                break;
+            }
+            case Op_ArrayAccess:
+            {
+                dst.value = regs[instr->arracc.base].value + regs[instr->arracc.idx].value * instr->arracc.stride;
+                dst.type  = Interp_Ptr;
+                break;
+            }
+            case Op_Truncate:
+            {
+                auto src = Vm_Unary;
+                if(instr->unary.type.type == InterpType_Float)
+                    Interp_SetFloat(&dst, instr->unary.type, Interp_GetFloat(src));
+                else
+                {
+                    dst.value = Interp_TruncBits(src.value, Interp_IntBits(instr->unary.type));
+                    dst.type  = instr->unary.type;
+                }
+                break;
+            }
+            case Op_FloatExt: Interp_SetFloat(&dst, instr->unary.type, Interp_GetFloat(Vm_Unary)); break;
+            case Op_SignExt:
+            {
+                auto src = Vm_Unary;
+                int64 extended = Interp_SignExtBits(src.value, Interp_IntBits(src.type));
+                dst.value = Interp_TruncBits(extended, Interp_IntBits(instr->unary.type));
+                dst.type  = instr->unary.type;
+                break;
+            }
+            case Op_ZeroExt:
+            case Op_Int2Ptr:
+            case Op_Ptr2Int:
+            case Op_Bitcast:
+            {
+                auto src = Vm_Unary;
+                uint16 bits = instr->unary.type.type == InterpType_Float ? (uint16)(Interp_TypeSize(instr->unary.type) * 8) : Interp_IntBits(instr->unary.type);
+                dst.value = Interp_TruncBits(src.value, bits);
+                dst.type  = instr->unary.type;
+                break;
+            }
+            case Op_Uint2Float: Interp_SetFloat(&dst, instr->unary.type, (double)(uint64)Vm_Unary.value); break;
+            case Op_Int2Float:
+            {
+                auto src = Vm_Unary;
+                Interp_SetFloat(&dst, instr->unary.type, (double)Interp_SignExtBits(src.value, Interp_IntBits(src.type)));
+                break;
+            }
+            case Op_Float2Uint:
+            {
+                uint64 converted = (uint64)Interp_GetFloat(Vm_Unary);
+                dst.value = Interp_TruncBits((int64)converted, Interp_IntBits(instr->unary.type));
+                dst.type  = instr->unary.type;
+                break;
+            }
+            case Op_Float2Int:
+            {
+                int64 converted = (int64)Interp_GetFloat(Vm_Unary);
+                dst.value = Interp_TruncBits(converted, Interp_IntBits(instr->unary.type));
+                dst.type  = instr->unary.type;
+                break;
+            }
+            case Op_Select: dst = regs[instr->sel.cond].value ? regs[instr->sel.a] : regs[instr->sel.b]; break;
+            case Op_Not:
+            {
+                auto src = Vm_Unary;
+                dst.value = Interp_TruncBits(~src.value, Interp_IntBits(src.type));
+                dst.type  = src.type;
+                break;
+            }
+            case Op_Negate:
+            {
+                auto src = Vm_Unary;
+                if(src.type.type == InterpType_Float)
+                    Interp_SetFloat(&dst, src.type, -Interp_GetFloat(src));
+                else
+                {
+                    dst.value = Interp_TruncBits((int64)(0 - (uint64)src.value), Interp_IntBits(src.type));
+                    dst.type  = src.type;
+                }
+                break;
+            }
+            case Op_And: Vm_IntBin(a & b); break;
+            case Op_Or:  Vm_IntBin(a | b); break;
+            case Op_Xor: Vm_IntBin(a ^ b); break;
+            case Op_Add: Vm_IntBin(a + b); break;
+            case Op_Sub: Vm_IntBin(a - b); break;
+            case Op_Mul: Vm_IntBin(a * b); break;
+            case Op_ShL: Vm_IntBin(a << (b & 63)); break;
+            case Op_ShR: Vm_IntBin(a >> (b & 63)); break;
+            case Op_Sar: Vm_SignedBin(a >> (b & 63)); break;
+            case Op_Rol:
+            {
+                uint16 bits = Vm_Bits;
+                Vm_IntBin(b % bits == 0 ? a : (a << (b % bits)) | (a >> (bits - b % bits)));
+                break;
+            }
+            case Op_Ror:
+            {
+                uint16 bits = Vm_Bits;
+                Vm_IntBin(b % bits == 0 ? a : (a >> (b % bits)) | (a << (bits - b % bits)));
+                break;
+            }
+            case Op_UDiv:
+            case Op_SDiv:
+            case Op_UMod:
+            case Op_SMod:
+            {
+                if(Vm_Src2.value == 0)
+                {
+                    Interp_RuntimeError(vm, "Integer division by zero.");
+                    return res;
+                }
+                
+                // (INT_MIN / -1) is undefined behavior in C, so it's handled separately
+                switch_nocheck(instr->op)
+                {
+                    case Op_UDiv: Vm_IntBin(a / b); break;
+                    case Op_UMod: Vm_IntBin(a % b); break;
+                    case Op_SDiv: Vm_SignedBin(b == -1 ? (int64)(0 - (uint64)a) : a / b); break;
+                    case Op_SMod: Vm_SignedBin(b == -1 ? 0 : a % b); break;
+                } switch_nocheck_end;
+                break;
+            }
+            case Op_FAdd: Vm_FloatBin(a + b); break;
+            case Op_FSub: Vm_FloatBin(a - b); break;
+            case Op_FMul: Vm_FloatBin(a * b); break;
+            case Op_FDiv: Vm_FloatBin(a / b); break;
+            case Op_CmpEq:
+            {
+                if(Vm_Src1.type.type == InterpType_Float)
+                    Vm_Cmp(Interp_GetFloat(Vm_Src1) == Interp_GetFloat(Vm_Src2))
+                else
+                    Vm_Cmp(Vm_Src1.value == Vm_Src2.value)
+                break;
+            }
+            case Op_CmpNe:
+            {
+                if(Vm_Src1.type.type == InterpType_Float)
+                    Vm_Cmp(Interp_GetFloat(Vm_Src1) != Interp_GetFloat(Vm_Src2))
+                else
+                    Vm_Cmp(Vm_Src1.value != Vm_Src2.value)
+                break;
+            }
+            case Op_CmpULT: Vm_Cmp((uint64)Vm_Src1.value <  (uint64)Vm_Src2.value); break;
+            case Op_CmpULE: Vm_Cmp((uint64)Vm_Src1.value <= (uint64)Vm_Src2.value); break;
+            case Op_CmpSLT: Vm_Cmp(Interp_SignExtBits(Vm_Src1.value, Vm_Bits) <  Interp_SignExtBits(Vm_Src2.value, Vm_Bits)); break;
+            case Op_CmpSLE: Vm_Cmp(Interp_SignExtBits(Vm_Src1.value, Vm_Bits) <= Interp_SignExtBits(Vm_Src2.value, Vm_Bits)); break;
+            case Op_CmpFLT: Vm_Cmp(Interp_GetFloat(Vm_Src1) <  Interp_GetFloat(Vm_Src2)); break;
+            case Op_CmpFLE: Vm_Cmp(Interp_GetFloat(Vm_Src1) <= Interp_GetFloat(Vm_Src2)); break;
+            default: Assert(false && "Unknown operation");
+        }
+        
+        ++pc;
+    }
+    
+#undef Vm_Cmp
+#undef Vm_FloatBin
+#undef Vm_SignedBin
+#undef Vm_IntBin
+#undef Vm_Bits
+#undef Vm_Src2
+#undef Vm_Src1
+#undef Vm_Unary
+    
+    return res;
 }
@@ -3,6 +3,7 @@
 
 #include "base.h"
 #include "memory_management.h"
+#include "dependency_graph.h"
 #include "tb.h"
 
 struct TB_Symbol;
@@ -54,6 +55,8 @@ X(Op_DebugBreak, "DebugBreak", false) \
 /* Can also be used as a goto (no condition and one case) */\
 X(Op_Branch, "Branch", false) \
 X(Op_Ret, "Ret", false) \
+/* Call which reuses the caller's frame, always followed by a Ret */ \
+X(Op_TailCall, "TailCall", true) \
 \
 X(Op_Load, "Load", true) \
 \
@@ -180,6 +183,8 @@ enum Interp_OpCodeEnum
     // Can also be used as a goto (no condition and one case)
     Op_Branch,
     Op_Ret,
+    // Call which reuses the caller's frame, always followed by a Ret
+    Op_TailCall,
     
     // Load
     Op_Load,
@@ -278,8 +283,28 @@ enum Interp_InstrBitfieldEnum
     InstrBF_RetVoid     = 1 << 0,
     InstrBF_ViolatesSSA = 1 << 1,  // This is used for logical operators
     InstrBF_MergeSSA    = 1 << 2,  // This is used for logical operators
+    
+    // Switch lowering (see Interp_PatchBranch). Keys of a switch
+    // are always sorted, these tell how the branch should be dispatched.
+    InstrBF_JumpTable    = 1 << 3,  // Keys are contiguous, indexed by (value - first key)
+    InstrBF_BinarySearch = 1 << 4,  // Keys are sparse, use a balanced compare tree
+    
+    InstrBF_SelfTailCall = 1 << 5,  // Tail call to the procedure itself, it's lowered to a jump
 };
 
+// Branches with fewer cases than this are lowered to a simple
+// compare chain, as that's faster than anything fancier.
+#define Interp_SwitchMinCases 4
+// A jump table is used only if at least 1 out of Interp_JumpTableMaxHoles
+// slots are actual cases, and if it's not too big. Otherwise binary search.
+#define Interp_JumpTableMaxHoles 2
+#define Interp_JumpTableMaxSize 4096
+
+// Only callees smaller than this (in instructions) are inlined,
+// and a caller can't grow by more than Interp_InlineMaxGrowth.
+#define Interp_InlineMaxInstrs 32
+#define Interp_InlineMaxGrowth 1024
+
 typedef uint8 InstrBitfield;
 
 enum InterpTypeKindEnum
@@ -320,6 +345,35 @@ cforceinline bool operator !=(Interp_Type type1, Interp_Type type2)
         || type1.data  != type2.data;
 }
 
+// Integer registers always hold values truncated to the width
+// of their type (and zero extended to 64 bits). Signed operations
+// sign extend their operands first.
+cforceinline uint16 Interp_IntBits(Interp_Type type)
+{
+    if(type.type == InterpType_Ptr || type.data == 0 || type.data > 64) return 64;
+    return type.data;
+}
+
+cforceinline int64 Interp_TruncBits(int64 value, uint16 bits)
+{
+    if(bits >= 64) return value;
+    return (int64)((uint64)value & ((1ULL << bits) - 1));
+}
+
+cforceinline int64 Interp_SignExtBits(int64 value, uint16 bits)
+{
+    if(bits >= 64) return value;
+    int shift = 64 - bits;
+    return (int64)((uint64)value << shift) >> shift;
+}
+
+cforceinline uint64 Interp_TypeSize(Interp_Type type)
+{
+    if(type.type == InterpType_Float) return type.data == FType_Flt32 ? 4 : 8;
+    if(type.type == InterpType_Ptr)   return 8;
+    return max((uint16)8, Interp_IntBits(type)) / 8;
+}
+
 #define Interp_Void     Interp_Type{ InterpType_Int,   0, 0 }
 #define Interp_Int8     Interp_Type{ InterpType_Int,   0, 8 }
 #define Interp_Int16    Interp_Type{ InterpType_Int,   0, 16 }
@@ -352,6 +406,9 @@ struct Interp_Symbol
     String name;             // Null terminated
     TypeInfo* typeInfo;
     
+    // Only used by procedures with a body
+    ProcIdx procIdx = ProcIdx_Unused;
+    
     // Codegen info
     TB_Symbol* tildeSymbol;
     // LLVMValueRef
@@ -388,6 +445,7 @@ struct Interp_Instr
         struct
         {
             uint32 size, align;
+            uint32 offset;  // From the start of the frame, see Interp_ComputeFrameLayout
         } local;
         struct
         {
@@ -435,6 +493,15 @@ struct Interp_Instr
             int64 offset;
         } memacc;  // Member access
         struct
+        {
+            RegIdx base, idx;
+            uint64 stride;
+        } arracc;  // Array access, base + idx * stride (idx is 64-bit)
+        struct
+        {
+            RegIdx cond, a, b;
+        } sel;  // Select, a if cond is not 0, b otherwise
+        struct
         {
             SymIdx symbol;
         } symAddress;
@@ -464,11 +531,20 @@ struct Interp_Proc
     
     Array<Interp_Instr> instrs;
     
+    // Instructions before this one only set up the arguments.
+    // Self tail calls jump right after it.
+    InstrIdx prologueEnd = 0;
+    bool hasSelfTailCall = false;
+    
+    // Size of all locals in the procedure
+    uint32 frameSize = 0;
+    
     // NOTE: Used for getting the passing rules for arguments and return values
     TB_Module* module;
     
     // Additional information for codegen
     SymIdx symIdx;
+    Dg_Idx entityIdx = Dg_Null;  // Of the procedure definition
     
     // Function description used for codegen
     Array<Interp_Type> argTypes;
@@ -486,6 +562,9 @@ struct Interp_Register
         int32 int32Value;
         int64 int64Value;
         int64 value;
+        float float32Value;
+        double float64Value;
+        void* ptrValue;
     };
     
     Interp_Type type;
@@ -501,17 +580,71 @@ struct Interp
     
     Array<Interp_Symbol> symbols;
     Array<Interp_Proc> procs;
+    
+    // Outlives the graph, used to attribute the cost of codegen
+    Slice<Dg_Entity> entities;
+};
+
+// Collected by the virtual machine when profiling is enabled
+struct Interp_ProcProfile
+{
+    uint64 calls = 0;
+    
+    // NOTE: Inclusive time of recursive procedures
+    // is counted once per active call
+    uint64 inclusiveCycles = 0;
+    uint64 exclusiveCycles = 0;
+    
+    // Number of times each instruction was executed
+    Slice<uint64> instrCounts = { 0, 0 };
+};
+
+// Procedures called often enough are compiled to native code, see jit.h.
+// They return false on runtime errors, the return value is written
+// in the first register.
+typedef bool (*Interp_JitProc)(Interp_Register* regs, uchar* frame);
+
+struct Interp_JitState
+{
+    uint32 calls = 0;
+    bool failed = false;  // Contains unsupported instructions, don't retry
+    Interp_JitProc code = 0;
 };
 
 struct VirtualMachine
 {
+    Interp* interp;
+    
+    // Memory for Op_Local, one frame per call
     Arena stackArena;
     
-    Array<Interp_Register> registers;
+    // Register windows, one per call. This is an arena
+    // (and not an Array) so that a frame's registers
+    // don't move when a callee pushes its own.
+    Arena regStack;
+    
+    // Storage for global variables, allocated
+    // the first time their address is taken
+    Arena globalsArena;
+    Array<uchar*> globalAddrs;
     
-    uchar* retStack;
     size_t stackFrameAddress;
     size_t programCounter;
+    
+    // Tiering, one entry for each procedure.
+    // Executable memory is committed as needed.
+    bool jit = false;
+    Array<Interp_JitState> jitStates;
+    uchar* jitCode = 0;
+    size_t jitCodeReserved = 0;
+    size_t jitCodeOffset = 0;
+    
+    // Profiling, one entry for each procedure
+    bool profile = false;
+    Arena profileArena;
+    Slice<Interp_ProcProfile> procProfiles = { 0, 0 };
+    
+    bool status = true;
 };
 
 // Bytecode instruction generation
@@ -582,6 +715,10 @@ void Interp_ConvertWhile(Interp_Builder* builder, Ast_While* stmt);
 void Interp_ConvertDoWhile(Interp_Builder* builder, Ast_DoWhile* stmt);
 void Interp_ConvertSwitch(Interp_Builder* builder, Ast_Switch* stmt);
 void Interp_ConvertReturn(Interp_Builder* builder, Ast_Return* stmt);
+bool Interp_IsTailCallCompatible(Interp_Builder* builder, Ast_FuncCall* call);
+void Interp_ApplyTailCalls(Interp_Builder* builder);
+bool Interp_LocalsEscape(Interp_Proc* proc);
+void Interp_ComputeFrameLayout(Interp_Proc* proc);
 void Interp_ConvertSimpleJump(Interp_Builder* builder, Array<InstrIdx>* toPatch);
 void Interp_PatchJumps(Interp_Builder* builder, InstrIdx region, Array<InstrIdx>* toPatch);
 Interp_Val Interp_ConvertIdent(Interp_Builder* builder, Ast_IdentExpr* expr);
@@ -594,5 +731,23 @@ Interp_Val Interp_ConvertSubscript(Interp_Builder* builder, Ast_Subscript* expr)
 Interp_Val Interp_ConvertMemberAccess(Interp_Builder* builder, Ast_MemberAccess* expr);
 Interp_Val Interp_ConvertConstValue(Interp_Builder* builder, Ast_ConstValue* expr);
 
+// Inlining
+void Interp_InlineProcs(Interp* interp);
+bool Interp_InlineCalls(Interp* interp, Interp_Proc* proc);
+Interp_Proc* Interp_GetInlineCandidate(Interp* interp, Interp_Proc* proc, InstrIdx callIdx);
+bool Interp_CanInline(Interp* interp, Interp_Proc* callee);
+void Interp_RemapInstrRegs(Interp_Instr* instr, Slice<RegIdx> regMap);
+
 // Code execution
-void Interp_ExecProc(Interp_Proc* proc);
\ No newline at end of file
+VirtualMachine Interp_InitVM(Interp* interp);
+void Interp_FreeVM(VirtualMachine* vm);
+Interp_Proc* Interp_FindProc(Interp* interp, char* name);
+Interp_Register Interp_ExecProc(VirtualMachine* vm, Interp_Proc* proc, Slice<Interp_Register> args);
+bool Interp_PushFrame(VirtualMachine* vm, Interp_Proc* proc, Slice<Interp_Register> args, Interp_Register** outRegs, uchar** outFrame);
+Interp_Proc* Interp_GetCallee(VirtualMachine* vm, Interp_Register target);
+uchar* Interp_GetGlobalAddress(VirtualMachine* vm, SymIdx symIdx);
+InstrIdx Interp_BranchTarget(Interp_Proc* proc, Interp_Instr* instr, int64 value);
+void Interp_RuntimeError(VirtualMachine* vm, char* message);
+Interp_ProcProfile* Interp_ProfileBegin(VirtualMachine* vm, Interp_Proc* proc);
+void Interp_ProfileEnd(Interp_ProcProfile* profile, uint64 enterTime, uint64 childCycles);
+void Interp_PrintVMProfile(VirtualMachine* vm);
\ No newline at end of file
@@ -0,0 +1,516 @@
+
+#include "base.h"
+#include "jit.h"
+#include "os/os_agnostic.h"
+
+Interp_JitProc Jit_CompileProc(VirtualMachine* vm, Interp_Proc* proc)
+{
+    ProfileFunc(prof);
+    
+    if(!Jit_Supported) return 0;
+    
+    ScratchArena scratch;
+    
+    Jit_Emitter emitter;
+    auto e = &emitter;
+    defer({
+              e->code.FreeAll();
+              e->fixups.FreeAll();
+          });
+    
+    e->regTypes.Resize(scratch, proc->maxReg + 1);
+    e->regDefined.Resize(scratch, proc->maxReg + 1);
+    for_array(i, e->regDefined)
+        e->regDefined[i] = false;
+    
+    Jit_InitParamTypes(e, vm, proc);
+    
+    // Move the arguments where the templates expect them
+#ifdef _WIN32
+    Jit_Bytes(e, 0x49, 0x89, 0xCA);  // mov r10, rcx
+    Jit_Bytes(e, 0x49, 0x89, 0xD3);  // mov r11, rdx
+#else
+    Jit_Bytes(e, 0x49, 0x89, 0xFA);  // mov r10, rdi
+    Jit_Bytes(e, 0x49, 0x89, 0xF3);  // mov r11, rsi
+#endif
+    
+    Slice<uint32> instrOffsets = { 0, 0 };
+    instrOffsets.Resize(scratch, proc->instrs.length);
+    for_array(i, proc->instrs)
+    {
+        instrOffsets[i] = e->code.length;
+        if(!Jit_EmitInstr(e, vm, proc, &proc->instrs[i]))
+            return 0;
+    }
+    
+    return Jit_Finalize(e, vm, instrOffsets);
+}
+
+// NOTE: Types of registers are only known at runtime in the interpreter,
+// but since values only flow through registers inside of a statement
+// (or through the arguments), a linear scan is enough to know them here.
+bool Jit_EmitInstr(Jit_Emitter* e, VirtualMachine* vm, Interp_Proc* proc, Interp_Instr* instr)
+{
+    auto& types   = e->regTypes;
+    auto& defined = e->regDefined;
+    
+    // Operands have to be integers or pointers
+#define Jit_Operand(reg) if(!defined[reg] || types[reg].type == InterpType_Float) return false;
+#define Jit_Result(type) { Jit_StoreReg(e, instr->dst, Jit_RAX); types[instr->dst] = (type); defined[instr->dst] = true; }
+    
+    switch(instr->op)
+    {
+        // Not supported, the procedure stays in the interpreter
+        default: return false;
+        case Op_Region:
+        case Op_DebugBreak: break;
+        case Op_IntegerConst:
+        {
+            auto type = instr->imm.type;
+            if(type.type == InterpType_Float) return false;
+            
+            Jit_MovImm(e, Jit_RAX, Interp_TruncBits(instr->imm.intVal, Interp_IntBits(type)));
+            Jit_Result(type);
+            break;
+        }
+        case Op_Local:
+        {
+            Jit_Bytes(e, 0x49, 0x8D, 0x83);  // lea rax, [r11 + offset]
+            Jit_Emit32(e, instr->local.offset);
+            Jit_Result(Interp_Ptr);
+            break;
+        }
+        case Op_GetSymbolAddress:
+        {
+            // Addresses don't change during the lifetime of the VM
+            uchar* addr = Interp_GetGlobalAddress(vm, instr->symAddress.symbol);
+            Jit_MovImm(e, Jit_RAX, (uint64)addr);
+            Jit_Result(Interp_Ptr);
+            break;
+        }
+        case Op_MemberAccess:
+        {
+            Jit_Operand(instr->memacc.base);
+            Jit_LoadReg(e, Jit_RAX, instr->memacc.base);
+            Jit_MovImm(e, Jit_RCX, instr->memacc.offset);
+            Jit_Bytes(e, 0x48, 0x01, 0xC8);  // add rax, rcx
+            Jit_Result(Interp_Ptr);
+            break;
+        }
+        case Op_ArrayAccess:
+        {
+            Jit_Operand(instr->arracc.base);
+            Jit_Operand(instr->arracc.idx);
+            Jit_LoadReg(e, Jit_RAX, instr->arracc.idx);
+            Jit_MovImm(e, Jit_RCX, instr->arracc.stride);
+            Jit_Bytes(e, 0x48, 0x0F, 0xAF, 0xC1);  // imul rax, rcx
+            Jit_LoadReg(e, Jit_RCX, instr->arracc.base);
+            Jit_Bytes(e, 0x48, 0x01, 0xC8);        // add rax, rcx
+            Jit_Result(Interp_Ptr);
+            break;
+        }
+        case Op_Load:
+        {
+            auto type = instr->load.type;
+            if(type.type == InterpType_Float) return false;
+            
+            Jit_Operand(instr->load.addr);
+            Jit_LoadReg(e, Jit_RCX, instr->load.addr);
+            switch(Interp_TypeSize(type))
+            {
+                default: return false;
+                case 1: Jit_Bytes(e, 0x0F, 0xB6, 0x01); break;        // movzx eax, byte [rcx]
+                case 2: Jit_Bytes(e, 0x0F, 0xB7, 0x01); break;        // movzx eax, word [rcx]
+                case 4: Jit_Bytes(e, 0x8B, 0x01); break;              // mov eax, [rcx]
+                case 8: Jit_Bytes(e, 0x48, 0x8B, 0x01); break;        // mov rax, [rcx]
+            }
+            
+            Jit_Result(type);
+            break;
+        }
+        case Op_Store:
+        {
+            Jit_Operand(instr->store.addr);
+            Jit_Operand(instr->store.val);
+            Jit_LoadReg(e, Jit_RCX, instr->store.addr);
+            Jit_LoadReg(e, Jit_RAX, instr->store.val);
+            switch(Interp_TypeSize(types[instr->store.val]))
+            {
+                default: return false;
+                case 1: Jit_Bytes(e, 0x88, 0x01); break;              // mov [rcx], al
+                case 2: Jit_Bytes(e, 0x66, 0x89, 0x01); break;        // mov [rcx], ax
+                case 4: Jit_Bytes(e, 0x89, 0x01); break;              // mov [rcx], eax
+                case 8: Jit_Bytes(e, 0x48, 0x89, 0x01); break;        // mov [rcx], rax
+            }
+            
+            break;
+        }
+        case Op_Truncate:
+        case Op_ZeroExt:
+        case Op_Int2Ptr:
+        case Op_Ptr2Int:
+        case Op_Bitcast:
+        case Op_SignExt:
+        {
+            auto type = instr->unary.type;
+            if(type.type == InterpType_Float) return false;
+            
+            Jit_Operand(instr->unary.src);
+            Jit_LoadReg(e, Jit_RAX, instr->unary.src);
+            if(instr->op == Op_SignExt)
+                Jit_SignExt(e, Jit_RAX, Interp_IntBits(types[instr->unary.src]));
+            
+            Jit_Trunc(e, Interp_IntBits(type));
+            Jit_Result(type);
+            break;
+        }
+        case Op_Not:
+        case Op_Negate:
+        {
+            Jit_Operand(instr->unary.src);
+            auto type = types[instr->unary.src];
+            
+            Jit_LoadReg(e, Jit_RAX, instr->unary.src);
+            if(instr->op == Op_Not)
+                Jit_Bytes(e, 0x48, 0xF7, 0xD0)  // not rax
+            else
+                Jit_Bytes(e, 0x48, 0xF7, 0xD8)  // neg rax
+            
+            Jit_Trunc(e, Interp_IntBits(type));
+            Jit_Result(type);
+            break;
+        }
+        case Op_And:
+        case Op_Or:
+        case Op_Xor:
+        case Op_Add:
+        case Op_Sub:
+        case Op_Mul:
+        case Op_ShL:
+        case Op_ShR:
+        case Op_Sar:
+        {
+            Jit_Operand(instr->bin.src1);
+            Jit_Operand(instr->bin.src2);
+            auto type = types[instr->bin.src1];
+            uint16 bits = Interp_IntBits(type);
+            
+            Jit_LoadReg(e, Jit_RAX, instr->bin.src1);
+            Jit_LoadReg(e, Jit_RCX, instr->bin.src2);
+            switch_nocheck(instr->op)
+            {
+                case Op_And: Jit_Bytes(e, 0x48, 0x21, 0xC8); break;        // and rax, rcx
+                case Op_Or:  Jit_Bytes(e, 0x48, 0x09, 0xC8); break;        // or rax, rcx
+                case Op_Xor: Jit_Bytes(e, 0x48, 0x31, 0xC8); break;        // xor rax, rcx
+                case Op_Add: Jit_Bytes(e, 0x48, 0x01, 0xC8); break;        // add rax, rcx
+                case Op_Sub: Jit_Bytes(e, 0x48, 0x29, 0xC8); break;        // sub rax, rcx
+                case Op_Mul: Jit_Bytes(e, 0x48, 0x0F, 0xAF, 0xC1); break;  // imul rax, rcx
+                // The shift count is masked by 63, same as the interpreter
+                case Op_ShL: Jit_Bytes(e, 0x48, 0xD3, 0xE0); break;        // shl rax, cl
+                case Op_ShR: Jit_Bytes(e, 0x48, 0xD3, 0xE8); break;        // shr rax, cl
+                case Op_Sar:
+                {
+                    Jit_SignExt(e, Jit_RAX, bits);
+                    Jit_Bytes(e, 0x48, 0xD3, 0xF8);  // sar rax, cl
+                    break;
+                }
+            } switch_nocheck_end;
+            
+            Jit_Trunc(e, bits);
+            Jit_Result(type);
+            break;
+        }
+        case Op_UDiv:
+        case Op_SDiv:
+        case Op_UMod:
+        case Op_SMod:
+        {
+            Jit_Operand(instr->bin.src1);
+            Jit_Operand(instr->bin.src2);
+            auto type = types[instr->bin.src1];
+            uint16 bits = Interp_IntBits(type);
+            
+            Jit_LoadReg(e, Jit_RAX, instr->bin.src1);
+            Jit_LoadReg(e, Jit_RCX, instr->bin.src2);
+            
+            // Division by zero is reported by the interpreter
+            Jit_Bytes(e, 0x48, 0x85, 0xC9);  // test rcx, rcx
+            Jit_JumpIf(e, Jit_CondE, InstrIdx_Unused);
+            
+            // Same results as the interpreter for (INT_MIN / -1), instead of a trap
+            switch_nocheck(instr->op)
+            {
+                case Op_UDiv:
+                case Op_UMod:
+                {
+                    Jit_Bytes(e, 0x31, 0xD2);        // xor edx, edx
+                    Jit_Bytes(e, 0x48, 0xF7, 0xF1);  // div rcx
+                    break;
+                }
+                case Op_SDiv:
+                {
+                    Jit_SignExt(e, Jit_RAX, bits);
+                    Jit_SignExt(e, Jit_RCX, bits);
+                    Jit_Bytes(e, 0x48, 0x83, 0xF9, 0xFF);  // cmp rcx, -1
+                    Jit_Bytes(e, 0x75, 0x05);              // jne .div
+                    Jit_Bytes(e, 0x48, 0xF7, 0xD8);        // neg rax
+                    Jit_Bytes(e, 0xEB, 0x05);              // jmp .end
+                    Jit_Bytes(e, 0x48, 0x99);              // .div: cqo
+                    Jit_Bytes(e, 0x48, 0xF7, 0xF9);        // idiv rcx
+                    break;                                 // .end:
+                }
+                case Op_SMod:
+                {
+                    Jit_SignExt(e, Jit_RAX, bits);
+                    Jit_SignExt(e, Jit_RCX, bits);
+                    Jit_Bytes(e, 0x48, 0x83, 0xF9, 0xFF);  // cmp rcx, -1
+                    Jit_Bytes(e, 0x75, 0x04);              // jne .div
+                    Jit_Bytes(e, 0x31, 0xC0);              // xor eax, eax
+                    Jit_Bytes(e, 0xEB, 0x08);              // jmp .end
+                    Jit_Bytes(e, 0x48, 0x99);              // .div: cqo
+                    Jit_Bytes(e, 0x48, 0xF7, 0xF9);        // idiv rcx
+                    Jit_Bytes(e, 0x48, 0x89, 0xD0);        // mov rax, rdx
+                    break;                                 // .end:
+                }
+            } switch_nocheck_end;
+            
+            if(instr->op == Op_UMod)
+                Jit_Bytes(e, 0x48, 0x89, 0xD0);  // mov rax, rdx
+            
+            Jit_Trunc(e, bits);
+            Jit_Result(type);
+            break;
+        }
+        case Op_CmpEq:
+        case Op_CmpNe:
+        case Op_CmpULT:
+        case Op_CmpULE:
+        case Op_CmpSLT:
+        case Op_CmpSLE:
+        {
+            Jit_Operand(instr->bin.src1);
+            Jit_Operand(instr->bin.src2);
+            uint16 bits = Interp_IntBits(types[instr->bin.src1]);
+            
+            Jit_LoadReg(e, Jit_RAX, instr->bin.src1);
+            Jit_LoadReg(e, Jit_RCX, instr->bin.src2);
+            
+            Jit_Cond cond = Jit_CondE;
+            switch_nocheck(instr->op)
+            {
+                case Op_CmpEq:  cond = Jit_CondE;  break;
+                case Op_CmpNe:  cond = Jit_CondNE; break;
+                case Op_CmpULT: cond = Jit_CondB;  break;
+                case Op_CmpULE: cond = Jit_CondBE; break;
+                case Op_CmpSLT: cond = Jit_CondL;  break;
+                case Op_CmpSLE: cond = Jit_CondLE; break;
+            } switch_nocheck_end;
+            
+            if(instr->op == Op_CmpSLT || instr->op == Op_CmpSLE)
+            {
+                Jit_SignExt(e, Jit_RAX, bits);
+                Jit_SignExt(e, Jit_RCX, bits);
+            }
+            
+            Jit_Bytes(e, 0x48, 0x39, 0xC8);           // cmp rax, rcx
+            Jit_Bytes(e, 0x0F, (uchar)(0x90 | cond), 0xC0);  // setcc al
+            Jit_Bytes(e, 0x0F, 0xB6, 0xC0);           // movzx eax, al
+            Jit_Result(Interp_Bool);
+            break;
+        }
+        case Op_Branch:
+        {
+            auto& branch = instr->branch;
+            if(branch.count > 0)
+            {
+                Jit_Operand(branch.value);
+                Jit_LoadReg(e, Jit_RAX, branch.value);
+            }
+            
+            if(branch.count == 1)  // If
+            {
+                Jit_Bytes(e, 0x48, 0x85, 0xC0);  // test rax, rax
+                Jit_JumpIf(e, Jit_CondNE, proc->instrArrays[branch.caseStart]);
+            }
+            else
+            {
+                // @performance Jump tables and binary search are
+                // not worth it for a baseline compiler
+                for(int i = 0; i < branch.count; ++i)
+                {
+                    Jit_MovImm(e, Jit_RCX, proc->constArrays[branch.keyStart + i]);
+                    Jit_Bytes(e, 0x48, 0x39, 0xC8);  // cmp rax, rcx
+                    Jit_JumpIf(e, Jit_CondE, proc->instrArrays[branch.caseStart + i]);
+                }
+            }
+            
+            Jit_Jump(e, branch.defaultCase);
+            break;
+        }
+        case Op_Ret:
+        {
+            if(!(instr->bitfield & InstrBF_RetVoid))
+            {
+                Jit_Operand(instr->unary.src);
+                Jit_LoadReg(e, Jit_RAX, instr->unary.src);
+                Jit_StoreReg(e, 0, Jit_RAX);
+            }
+            
+            Jit_Bytes(e, 0xB8, 0x01, 0x00, 0x00, 0x00);  // mov eax, 1
+            Jit_Bytes(e, 0xC3);                          // ret
+            break;
+        }
+    }
+    
+#undef Jit_Result
+#undef Jit_Operand
+    
+    return true;
+}
+
+// Types of the ABI arguments, see Interp_ConvertProc
+void Jit_InitParamTypes(Jit_Emitter* e, VirtualMachine* vm, Interp_Proc* proc)
+{
+    auto procType = (Ast_ProcType*)vm->interp->symbols[proc->symIdx].typeInfo;
+    int retArgs = max((int64)0, procType->retTypes.length - 1) + (proc->retRule == TB_PASSING_INDIRECT);
+    
+    for(int i = 0; i < retArgs; ++i)
+    {
+        e->regTypes[i]   = Interp_Ptr;
+        e->regDefined[i] = true;
+    }
+    
+    for_array(i, procType->args)
+    {
+        RegIdx reg = retArgs + i;
+        if(reg >= e->regTypes.length) break;
+        
+        if(proc->argRules[i] == TB_PASSING_INDIRECT)
+            e->regTypes[reg] = Interp_Ptr;
+        else
+            e->regTypes[reg] = Interp_ConvertType(procType->args[i]->type);
+        
+        e->regDefined[reg] = true;
+    }
+}
+
+Interp_JitProc Jit_Finalize(Jit_Emitter* e, VirtualMachine* vm, Slice<uint32> instrOffsets)
+{
+    // Shared exit for runtime errors
+    uint32 errorExit = e->code.length;
+    Jit_Bytes(e, 0x31, 0xC0);  // xor eax, eax
+    Jit_Bytes(e, 0xC3);        // ret
+    
+    for_array(i, e->fixups)
+    {
+        auto fixup = e->fixups[i];
+        uint32 target = fixup.target == InstrIdx_Unused ? errorExit : instrOffsets[fixup.target];
+        int32 rel = (int32)(target - (fixup.at + 4));
+        memcpy(&e->code[fixup.at], &rel, sizeof(rel));
+    }
+    
+    // Each procedure gets its own pages, so that pages which
+    // are already executable never have to be written to again
+    const size_t pageSize = KB(4);
+    size_t size = (e->code.length + pageSize - 1) & ~(pageSize - 1);
+    if(vm->jitCodeOffset + size > vm->jitCodeReserved) return 0;
+    
+    uchar* code = vm->jitCode + vm->jitCodeOffset;
+    vm->jitCodeOffset += size;
+    
+    CommitMemory(code, size);
+    memcpy(code, e->code.ptr, e->code.length);
+    ProtectMemoryExecutable(code, size);
+    return (Interp_JitProc)code;
+}
+
+// Encoding
+
+void Jit_EmitBytes(Jit_Emitter* e, uchar* bytes, int count)
+{
+    for(int i = 0; i < count; ++i)
+        e->code.Append(bytes[i]);
+}
+
+void Jit_Emit32(Jit_Emitter* e, uint32 value)
+{
+    Jit_EmitBytes(e, (uchar*)&value, sizeof(value));
+}
+
+void Jit_Emit64(Jit_Emitter* e, uint64 value)
+{
+    Jit_EmitBytes(e, (uchar*)&value, sizeof(value));
+}
+
+// mov dst, [r10 + reg * sizeof(Interp_Register)]
+void Jit_LoadReg(Jit_Emitter* e, Jit_X64Reg dst, RegIdx reg)
+{
+    Jit_Bytes(e, 0x49, 0x8B, (uchar)(0x82 | (dst << 3)));
+    Jit_Emit32(e, reg * sizeof(Interp_Register));
+}
+
+// mov [r10 + reg * sizeof(Interp_Register)], src
+void Jit_StoreReg(Jit_Emitter* e, RegIdx reg, Jit_X64Reg src)
+{
+    Jit_Bytes(e, 0x49, 0x89, (uchar)(0x82 | (src << 3)));
+    Jit_Emit32(e, reg * sizeof(Interp_Register));
+}
+
+void Jit_MovImm(Jit_Emitter* e, Jit_X64Reg dst, uint64 imm)
+{
+    Jit_Bytes(e, 0x48, (uchar)(0xB8 + dst));  // mov dst, imm64
+    Jit_Emit64(e, imm);
+}
+
+// Truncates rax to the given width (zero extended), like Interp_TruncBits.
+// NOTE: This uses rcx for widths other than 8, 16, 32 and 64
+void Jit_Trunc(Jit_Emitter* e, uint16 bits)
+{
+    switch(bits)
+    {
+        case 64: break;
+        case 32: Jit_Bytes(e, 0x89, 0xC0); break;        // mov eax, eax
+        case 16: Jit_Bytes(e, 0x0F, 0xB7, 0xC0); break;  // movzx eax, ax
+        case 8:  Jit_Bytes(e, 0x0F, 0xB6, 0xC0); break;  // movzx eax, al
+        default:
+        {
+            Jit_MovImm(e, Jit_RCX, (1ULL << bits) - 1);
+            Jit_Bytes(e, 0x48, 0x21, 0xC8);  // and rax, rcx
+            break;
+        }
+    }
+}
+
+// Sign extends the register from the given width, like Interp_SignExtBits
+void Jit_SignExt(Jit_Emitter* e, Jit_X64Reg reg, uint16 bits)
+{
+    uchar modrm = (uchar)(0xC0 | (reg << 3) | reg);
+    switch(bits)
+    {
+        case 64: break;
+        case 32: Jit_Bytes(e, 0x48, 0x63, modrm); break;        // movsxd reg, reg32
+        case 16: Jit_Bytes(e, 0x48, 0x0F, 0xBF, modrm); break;  // movsx reg, reg16
+        case 8:  Jit_Bytes(e, 0x48, 0x0F, 0xBE, modrm); break;  // movsx reg, reg8
+        default:
+        {
+            uchar shift = (uchar)(64 - bits);
+            Jit_Bytes(e, 0x48, 0xC1, (uchar)(0xE0 | reg), shift);  // shl reg, shift
+            Jit_Bytes(e, 0x48, 0xC1, (uchar)(0xF8 | reg), shift);  // sar reg, shift
+            break;
+        }
+    }
+}
+
+void Jit_Jump(Jit_Emitter* e, InstrIdx target)
+{
+    Jit_Bytes(e, 0xE9);  // jmp rel32
+    e->fixups.Append({ (uint32)e->code.length, target });
+    Jit_Emit32(e, 0);
+}
+
+void Jit_JumpIf(Jit_Emitter* e, Jit_Cond cond, InstrIdx target)
+{
+    Jit_Bytes(e, 0x0F, (uchar)(0x80 | cond));  // jcc rel32
+    e->fixups.Append({ (uint32)e->code.length, target });
+    Jit_Emit32(e, 0);
+}
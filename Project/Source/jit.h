@@ -0,0 +1,81 @@
+
+#pragma once
+
+#include "base.h"
+#include "interpreter.h"
+
+// NOTE: Baseline JIT for the bytecode interpreter. Each instruction
+// is translated to a fixed x86-64 template which reads its operands from
+// the register window and writes the result back, so there is no register
+// allocation. This is still way faster than the interpreter's dispatch.
+// Only leaf procedures operating on integers and pointers are supported,
+// anything else keeps running in the interpreter.
+
+// Procedures are compiled after being called this many times
+#define Jit_CallThreshold 64
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define Jit_Supported true
+#else
+#define Jit_Supported false
+#endif
+
+// x86-64 registers used by the templates. These are volatile in
+// both the System V and the Windows calling conventions, so
+// nothing needs to be saved.
+enum Jit_X64RegEnum
+{
+    Jit_RAX = 0,
+    Jit_RCX = 1,
+    Jit_RDX = 2,
+    // R10 holds the address of the register window
+    // R11 holds the address of the frame
+};
+typedef uint8 Jit_X64Reg;
+
+// x86-64 condition codes
+enum Jit_CondEnum
+{
+    Jit_CondB  = 0x2,
+    Jit_CondE  = 0x4,
+    Jit_CondNE = 0x5,
+    Jit_CondBE = 0x6,
+    Jit_CondL  = 0xC,
+    Jit_CondLE = 0xE,
+};
+typedef uint8 Jit_Cond;
+
+struct Jit_Fixup
+{
+    uint32 at;        // Offset of the rel32 to patch
+    InstrIdx target;  // Region to jump to, or InstrIdx_Unused for the error exit
+};
+
+struct Jit_Emitter
+{
+    Array<uchar> code;
+    Array<Jit_Fixup> fixups;
+    
+    // Type of each register, known statically
+    Slice<Interp_Type> regTypes;
+    Slice<bool> regDefined;
+};
+
+Interp_JitProc Jit_CompileProc(VirtualMachine* vm, Interp_Proc* proc);
+bool Jit_EmitInstr(Jit_Emitter* e, VirtualMachine* vm, Interp_Proc* proc, Interp_Instr* instr);
+void Jit_InitParamTypes(Jit_Emitter* e, VirtualMachine* vm, Interp_Proc* proc);
+Interp_JitProc Jit_Finalize(Jit_Emitter* e, VirtualMachine* vm, Slice<uint32> instrOffsets);
+
+// Encoding
+void Jit_EmitBytes(Jit_Emitter* e, uchar* bytes, int count);
+void Jit_Emit32(Jit_Emitter* e, uint32 value);
+void Jit_Emit64(Jit_Emitter* e, uint64 value);
+void Jit_LoadReg(Jit_Emitter* e, Jit_X64Reg dst, RegIdx reg);
+void Jit_StoreReg(Jit_Emitter* e, RegIdx reg, Jit_X64Reg src);
+void Jit_MovImm(Jit_Emitter* e, Jit_X64Reg dst, uint64 imm);
+void Jit_Trunc(Jit_Emitter* e, uint16 bits);
+void Jit_SignExt(Jit_Emitter* e, Jit_X64Reg reg, uint16 bits);
+void Jit_Jump(Jit_Emitter* e, InstrIdx target);
+void Jit_JumpIf(Jit_Emitter* e, Jit_Cond cond, InstrIdx target);
+
+#define Jit_Bytes(emitter, ...) { uchar bytes_[] = { __VA_ARGS__ }; Jit_EmitBytes(emitter, bytes_, sizeof(bytes_)); }
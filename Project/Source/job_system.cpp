@@ -0,0 +1,395 @@
+
+#include "job_system.h"
+#include "os/os_agnostic.h"
+
+Job_System jobSystem;
+
+static void Job_WorkerLoop(void* userData);
+static void Job_ForBatchProc(void* userData);
+static void Job_TaskProc(void* userData);
+
+void Job_Init(int numThreads)
+{
+    ProfileFunc(prof);
+    
+    if(numThreads <= 0) numThreads = OS_GetNumLogicalCores();
+    numThreads = clamp(numThreads, 1, Job_MaxWorkers);
+    
+    jobSystem.numWorkers = numThreads;
+    jobSystem.wakeSem    = OS_CreateSemaphore();
+    jobSystem.startTicks = __rdtsc();
+    
+    // The main thread keeps its own ThreadContext
+    jobSystem.workers[0].idx    = 0;
+    jobSystem.workers[0].thread = 0;
+    
+    for(int i = 1; i < numThreads; ++i)
+    {
+        Job_Worker* worker = &jobSystem.workers[i];
+        worker->idx    = i;
+        worker->thread = OS_StartThread(Job_WorkerLoop, worker);
+    }
+}
+
+void Job_Shutdown()
+{
+    if(jobSystem.numWorkers == 0) return;
+    
+    AtomicStoreRelease32(&jobSystem.quit, 1);
+    OS_SignalSemaphore(jobSystem.wakeSem, jobSystem.numWorkers - 1);
+    
+    for(uint32 i = 1; i < jobSystem.numWorkers; ++i)
+        OS_JoinThread(jobSystem.workers[i].thread);
+    
+    for(uint32 i = 0; i < jobSystem.numWorkers; ++i)
+    {
+        Job_Worker* worker = &jobSystem.workers[i];
+        for(int j = 0; j < Job_NumArenaKinds; ++j)
+        {
+            if(worker->arenaInitted[j])
+                Arena_Free(&worker->arenas[j]);
+            
+            worker->arenaInitted[j] = false;
+        }
+    }
+    
+    OS_FreeSemaphore(jobSystem.wakeSem);
+    jobSystem.wakeSem    = 0;
+    jobSystem.numWorkers = 0;
+    jobSystem.quit       = 0;
+}
+
+static void Job_WorkerLoop(void* userData)
+{
+    Job_Worker* worker = (Job_Worker*)userData;
+    
+    ThreadCtx_Init(&worker->threadCtx, GB(2), KB(32));
+    worker->threadCtx.workerIdx = worker->idx;
+    SetThreadContext(&worker->threadCtx);
+    
+    while(true)
+    {
+        OS_WaitSemaphore(jobSystem.wakeSem);
+        if(AtomicLoadAcquire32(&jobSystem.quit)) break;
+        
+        Job_TryRunOne();
+    }
+    
+    for(int i = 0; i < ThreadCtx_NumScratchArenas; ++i)
+        Arena_Free(&worker->threadCtx.scratchPool[i]);
+    
+#ifdef Profile
+    QuitSpallThread();
+#endif
+}
+
+void Job_Submit(Job_Proc proc, void* userData, Job_Counter* counter)
+{
+    Job job = { proc, userData, counter };
+    Job_Submit(&job, 1, counter);
+}
+
+void Job_Submit(Job* jobs, int count, Job_Counter* counter)
+{
+    if(count <= 0) return;
+    
+    if(counter) AtomicAdd32(&counter->pending, count);
+    for(int i = 0; i < count; ++i)
+        jobs[i].counter = counter;
+    
+    // No worker threads, just run everything here
+    if(jobSystem.numWorkers <= 1)
+    {
+        for(int i = 0; i < count; ++i)
+            Job_Run(jobs[i]);
+        
+        return;
+    }
+    
+    int numQueued = 0;
+    Spinlock_Lock(&jobSystem.lock);
+    while(numQueued < count && jobSystem.tail - jobSystem.head < Job_QueueSize)
+    {
+        jobSystem.queue[jobSystem.tail % Job_QueueSize] = jobs[numQueued];
+        ++jobSystem.tail;
+        ++numQueued;
+    }
+    Spinlock_Unlock(&jobSystem.lock);
+    
+    OS_SignalSemaphore(jobSystem.wakeSem, numQueued);
+    
+    // The queue is full, so the pool is busy anyway
+    for(int i = numQueued; i < count; ++i)
+        Job_Run(jobs[i]);
+}
+
+bool Job_TryRunOne()
+{
+    Job job;
+    bool found = false;
+    
+    Spinlock_Lock(&jobSystem.lock);
+    if(jobSystem.head != jobSystem.tail)
+    {
+        job = jobSystem.queue[jobSystem.head % Job_QueueSize];
+        ++jobSystem.head;
+        found = true;
+    }
+    Spinlock_Unlock(&jobSystem.lock);
+    
+    if(found) Job_Run(job);
+    return found;
+}
+
+void Job_Run(Job job)
+{
+    Job_Worker* worker = Job_CurrentWorker();
+    
+    // NOTE: Jobs can run other jobs while they wait,
+    // only the outermost one is timed so nothing is counted twice
+    bool outermost = worker->runDepth == 0;
+    ++worker->runDepth;
+    
+    uint64 start = __rdtsc();
+    job.proc(job.userData);
+    if(outermost) worker->busyTicks += __rdtsc() - start;
+    
+    --worker->runDepth;
+    ++worker->numJobs;
+    
+    if(job.counter) AtomicDecrement32(&job.counter->pending);
+}
+
+void Job_Wait(Job_Counter* counter)
+{
+    // NOTE: Spin for a bit first since most waits are short, then
+    // start yielding so that the threads running the remaining jobs
+    // get to finish them when there are more threads than cores
+    int misses = 0;
+    while(AtomicLoadAcquire32(&counter->pending) > 0)
+    {
+        if(Job_TryRunOne())
+        {
+            misses = 0;
+            continue;
+        }
+        
+        if(++misses < Job_WaitSpinCount) CpuPause();
+        else                              OS_YieldThread();
+    }
+}
+
+struct Job_ForBatch
+{
+    Job_ForProc proc;
+    void* userData;
+    int64 start;
+    int64 end;
+};
+
+static void Job_ForBatchProc(void* userData)
+{
+    auto batch = (Job_ForBatch*)userData;
+    batch->proc(batch->start, batch->end, batch->userData);
+}
+
+void Job_ParallelFor(int64 count, int64 batchSize, Job_ForProc proc, void* userData)
+{
+    if(count <= 0) return;
+    if(batchSize <= 0) batchSize = 1;
+    
+    int64 numBatches = (count + batchSize - 1) / batchSize;
+    if(numBatches == 1 || jobSystem.numWorkers <= 1)
+    {
+        proc(0, count, userData);
+        return;
+    }
+    
+    ScratchArena scratch;
+    auto batches = Arena_AllocArrayPack(scratch.arena(), numBatches, Job_ForBatch);
+    auto jobs    = Arena_AllocArrayPack(scratch.arena(), numBatches, Job);
+    for(int64 i = 0; i < numBatches; ++i)
+    {
+        batches[i].proc     = proc;
+        batches[i].userData = userData;
+        batches[i].start    = i * batchSize;
+        batches[i].end      = min(count, (i + 1) * batchSize);
+        
+        jobs[i] = { Job_ForBatchProc, &batches[i] };
+    }
+    
+    Job_Counter counter;
+    Job_Submit(jobs, (int)numBatches, &counter);
+    Job_Wait(&counter);
+}
+
+Job_Worker* Job_CurrentWorker()
+{
+    auto threadCtx = (ThreadContext*)GetThreadContext();
+    return &jobSystem.workers[threadCtx ? threadCtx->workerIdx : 0];
+}
+
+Arena* Job_WorkerArena(Job_ArenaKind kind)
+{
+    Job_Worker* worker = Job_CurrentWorker();
+    if(!worker->arenaInitted[kind])
+    {
+        worker->arenas[kind] = Arena_VirtualMemInit(GB(4), MB(2));
+        Arena_SetRetainSize(&worker->arenas[kind], MB(16));
+        worker->arenaInitted[kind] = true;
+    }
+    
+    return &worker->arenas[kind];
+}
+
+void Job_ResetWorkerArenas()
+{
+    for(uint32 i = 0; i < jobSystem.numWorkers; ++i)
+    {
+        Job_Worker* worker = &jobSystem.workers[i];
+        for(int j = 0; j < Job_NumArenaKinds; ++j)
+        {
+            if(worker->arenaInitted[j])
+                Arena_FreeAll(&worker->arenas[j]);
+        }
+    }
+}
+
+void Job_RecordArenaStats()
+{
+    static char* names[Job_NumArenaKinds] =
+    {
+        "Worker AST", "Worker Entity", "Worker Type", "Worker Bytecode"
+    };
+    
+    for(uint32 i = 0; i < jobSystem.numWorkers; ++i)
+    {
+        Job_Worker* worker = &jobSystem.workers[i];
+        for(int j = 0; j < Job_NumArenaKinds; ++j)
+        {
+            if(worker->arenaInitted[j])
+                Arena_RecordStats(names[j], &worker->arenas[j]);
+        }
+        
+        // The main thread's scratch arenas are recorded by the caller
+        if(i == 0) continue;
+        
+        for(int j = 0; j < ThreadCtx_NumScratchArenas; ++j)
+            Arena_RecordStats("Scratch", &worker->threadCtx.scratchPool[j]);
+    }
+}
+
+void Job_PrintStats()
+{
+    double totalSeconds = 1.0 / GetRdtscFreq() * (__rdtsc() - jobSystem.startTicks);
+    
+    printf("Job system (%d threads, %.3fs):\n", jobSystem.numWorkers, totalSeconds);
+    printf("    %-10s %10s %10s %12s\n", "Worker", "Jobs", "Busy", "Utilization");
+    for(uint32 i = 0; i < jobSystem.numWorkers; ++i)
+    {
+        Job_Worker* worker = &jobSystem.workers[i];
+        double busySeconds = 1.0 / GetRdtscFreq() * worker->busyTicks;
+        double utilization = totalSeconds > 0.0 ? busySeconds / totalSeconds * 100.0 : 0.0;
+        
+        char name[16];
+        if(i == 0) snprintf(name, sizeof(name), "main");
+        else       snprintf(name, sizeof(name), "%d", i);
+        
+        printf("    %-10s %10llu %9.3fs %11.1f%%\n", name, (unsigned long long)worker->numJobs,
+               busySeconds, utilization);
+    }
+}
+
+// Task graphs
+Job_TaskGraph Job_MakeGraph(Arena* arena)
+{
+    Job_TaskGraph graph;
+    graph.arena = arena;
+    return graph;
+}
+
+uint32 Job_AddTask(Job_TaskGraph* graph, Job_Proc proc, void* userData)
+{
+    Job_Task task;
+    task.proc        = proc;
+    task.userData    = userData;
+    task.pendingDeps = 0;
+    task.successors  = { 0, 0 };
+    task.graph       = 0;
+    graph->tasks.Append(graph->arena, task);
+    return graph->tasks.length - 1;
+}
+
+void Job_AddDependency(Job_TaskGraph* graph, uint32 task, uint32 dependsOn)
+{
+    Assert(task < graph->tasks.length && dependsOn < graph->tasks.length);
+    graph->edges.Append(graph->arena, { dependsOn, task });
+}
+
+void Job_RunGraph(Job_TaskGraph* graph)
+{
+    ProfileFunc(prof);
+    
+    auto& tasks = graph->tasks;
+    auto& edges = graph->edges;
+    if(tasks.length == 0) return;
+    
+    graph->numCompleted = 0;
+    
+    // Build the successor lists
+    for_array(i, tasks)
+    {
+        tasks[i].pendingDeps       = 0;
+        tasks[i].successors.length = 0;
+        tasks[i].graph             = graph;
+    }
+    
+    for_array(i, edges)
+    {
+        ++tasks[edges[i].from].successors.length;
+        ++tasks[edges[i].to].pendingDeps;
+    }
+    
+    for_array(i, tasks)
+    {
+        tasks[i].successors.ptr    = Arena_AllocArrayPack(graph->arena, tasks[i].successors.length, uint32);
+        tasks[i].successors.length = 0;
+    }
+    
+    for_array(i, edges)
+    {
+        Job_Task& from = tasks[edges[i].from];
+        from.successors.ptr[from.successors.length++] = edges[i].to;
+    }
+    
+    // Start from the tasks without dependencies, the rest
+    // are submitted by the last task they depend on
+    ScratchArena scratch;
+    Slice<Job> roots = { 0, 0 };
+    for_array(i, tasks)
+    {
+        if(tasks[i].pendingDeps == 0)
+            roots.Append(scratch.arena(), { Job_TaskProc, &tasks[i] });
+    }
+    
+    Assert(roots.length > 0 && "Task graph has a cycle");
+    Job_Submit(roots.ptr, roots.length, &graph->counter);
+    Job_Wait(&graph->counter);
+    
+    Assert(graph->numCompleted == tasks.length && "Task graph has a cycle");
+}
+
+static void Job_TaskProc(void* userData)
+{
+    auto task = (Job_Task*)userData;
+    task->proc(task->userData);
+    
+    Job_TaskGraph* graph = task->graph;
+    AtomicIncrement32(&graph->numCompleted);
+    for_array(i, task->successors)
+    {
+        Job_Task* next = &graph->tasks[task->successors[i]];
+        if(AtomicDecrement32(&next->pendingDeps) == 0)
+            Job_Submit(Job_TaskProc, next, &graph->counter);
+    }
+}
@@ -0,0 +1,147 @@
+
+#pragma once
+
+#include "base.h"
+#include "memory_management.h"
+
+// NOTE: Compiler-wide job system. A fixed pool of worker threads
+// is started once, and every stage that wants to go wide (parsing,
+// typechecking, bytecode, codegen) submits jobs to the same pool.
+// Each worker owns a ThreadContext, so ScratchArena works as usual
+// inside of jobs, and a few long-lived arenas for the results of the
+// stages, which are only reserved the first time they're used and
+// are kept across jobs. The main thread is worker 0, it runs jobs
+// while it waits for them, so the pool never deadlocks on nested
+// waits (e.g. a parallel-for inside of a job).
+
+#define Job_MaxWorkers    64
+#define Job_QueueSize     4096  // Jobs are run inline if the queue is full
+#define Job_WaitSpinCount 64    // Failed attempts at running a job before yielding
+
+typedef void (*Job_Proc)(void* userData);
+// Processes the elements in [start, end)
+typedef void (*Job_ForProc)(int64 start, int64 end, void* userData);
+
+// Counts the jobs which haven't finished yet,
+// used to wait for a group of jobs
+struct Job_Counter
+{
+    volatile uint32 pending = 0;
+};
+
+struct Job
+{
+    Job_Proc proc;
+    void* userData;
+    Job_Counter* counter;  // Set by Job_Submit
+};
+
+enum Job_ArenaKind
+{
+    Job_AstArena = 0,
+    Job_EntityArena,  // Only used for the entity array of the current job
+    Job_TypeArena,
+    Job_BytecodeArena,
+    
+    Job_NumArenaKinds
+};
+
+struct alignas(64) Job_Worker
+{
+    uint32 idx;
+    void* thread;  // 0 for the main thread
+    
+    ThreadContext threadCtx;  // Unused for the main thread, it has its own
+    Arena arenas[Job_NumArenaKinds];
+    bool arenaInitted[Job_NumArenaKinds];
+    
+    // Stats
+    uint32 runDepth;
+    uint64 busyTicks;
+    uint64 numJobs;
+};
+
+struct Job_System
+{
+    Job_Worker workers[Job_MaxWorkers];
+    uint32 numWorkers = 0;  // Including the main thread
+    
+    // Ring buffer, protected by the lock
+    Spinlock lock;
+    Job queue[Job_QueueSize];
+    uint32 head = 0;
+    uint32 tail = 0;
+    
+    void* wakeSem = 0;  // Signaled once per queued job
+    volatile uint32 quit = 0;
+    uint64 startTicks = 0;
+};
+
+extern Job_System jobSystem;
+
+// Starts numThreads-1 workers (the main thread is the other one),
+// if numThreads is 0 it uses one thread per logical core.
+// Must be called from the main thread after its ThreadContext is set.
+void Job_Init(int numThreads);
+void Job_Shutdown();
+
+// Submission
+void Job_Submit(Job_Proc proc, void* userData, Job_Counter* counter);
+void Job_Submit(Job* jobs, int count, Job_Counter* counter);
+// Runs other jobs while waiting
+void Job_Wait(Job_Counter* counter);
+bool Job_TryRunOne();
+void Job_Run(Job job);
+
+// Splits [0, count) in batches of batchSize elements and runs them
+// on the pool, returns when all of them are done
+void Job_ParallelFor(int64 count, int64 batchSize, Job_ForProc proc, void* userData);
+
+// Workers
+Job_Worker* Job_CurrentWorker();
+// Per-worker arena of the given kind for the current thread,
+// reserved the first time it's requested
+Arena* Job_WorkerArena(Job_ArenaKind kind);
+// Frees the contents of all workers' arenas, while no jobs are running
+void Job_ResetWorkerArenas();
+// Adds the workers' arenas (and their scratch arenas) to the -mem report
+void Job_RecordArenaStats();
+void Job_PrintStats();
+
+// Task graphs: tasks only start once all of the tasks they depend on
+// are done. The graph is built on one thread, then run with Job_RunGraph.
+struct Job_Task
+{
+    Job_Proc proc;
+    void* userData;
+    
+    volatile uint32 pendingDeps;
+    Slice<uint32> successors;
+    
+    struct Job_TaskGraph* graph;
+};
+
+struct Job_TaskEdge
+{
+    uint32 from;
+    uint32 to;
+};
+
+struct Job_TaskGraph
+{
+    Arena* arena;
+    ArenaArray<Job_Task> tasks;
+    ArenaArray<Job_TaskEdge> edges;
+    Job_Counter counter;
+    
+    // Tasks in a cycle are never submitted, so Job_RunGraph
+    // checks that all of them ran
+    volatile uint32 numCompleted = 0;
+};
+
+Job_TaskGraph Job_MakeGraph(Arena* arena);
+uint32 Job_AddTask(Job_TaskGraph* graph, Job_Proc proc, void* userData);
+// "task" will only start after "dependsOn" is done
+void Job_AddDependency(Job_TaskGraph* graph, uint32 task, uint32 dependsOn);
+// Returns when all tasks in the graph are done. The graph can't have cycles
+void Job_RunGraph(Job_TaskGraph* graph);
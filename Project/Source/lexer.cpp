@@ -152,21 +152,11 @@ static void EatAllWhitespace(Tokenizer* t)
     bool loop = true;
     while(loop)
     {
-        if(IsNewline(t->at[0]))
-        {
-            t->startOfCurLine = t->at - t->fileContents + 1;
-            ++t->curLineNum;
-            ++t->at;
-        }
-        else if(IsWhitespace(t->at[0])) ++t->at;
+        if(IsWhitespace(t->at[0])) ++t->at;
         else if(t->at[0] == '/' && t->at[1] == '/')
         {
             // Handle comments
-            while(!IsNewline(t->at[0])) ++t->at;
-            
-            t->startOfCurLine = t->at - t->fileContents + 1;
-            ++t->curLineNum;
-            ++t->at;
+            while(!IsNewline(t->at[0]) && t->at[0] != 0) ++t->at;
         }
         // Multiline comments
         else if(t->at[0] == '/' && t->at[1] == '*')
@@ -179,11 +169,6 @@ static void EatAllWhitespace(Tokenizer* t)
                 // Stop if we got to EOF 
                 if(t->at[0] == 0)
                     return;
-                if(IsNewline(t->at[0]))
-                {
-                    t->startOfCurLine = t->at - t->fileContents + 1;
-                    ++t->curLineNum;
-                }
                 
                 if(t->at[0] == '*' && t->at[1] == '/')
                 {
@@ -206,67 +191,145 @@ static void EatAllWhitespace(Tokenizer* t)
     }
 }
 
+// NOTE: Rough average of characters per token in typical code,
+// used to reserve the token arrays up front. If it's exceeded the
+// arrays just grow.
+#define Lexer_CharsPerTokenEstimate 3
+#define Lexer_CharsPerLineEstimate 32
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define Lexer_SSE2
+#endif
+
 static void LexFile(Tokenizer* t)
 {
     ProfileFunc(prof);
     
+    size_t fileSize = strlen(t->fileContents);
+    ReserveTokens(t, fileSize / Lexer_CharsPerTokenEstimate + 16);
+    // Null token
+    PushToken(t, Tok_Error, 0, 0, 0);
+    
     while(true)
     {
         // TODO: Intern operators here, ...
         
-        Token tok = GetToken(t);
-        t->tokens.Append(t->arena, tok);
+        TokenIdx tok = GetToken(t);
         
-        if(tok.type == Tok_EOF || tok.type == Tok_Error)
+        TokenType type = TokType(t, tok);
+        if(type == Tok_EOF || type == Tok_Error)
             break;
     }
+    
+    BuildLineIndex(t, fileSize);
+}
+
+// NOTE: Line numbers are only needed for diagnostics, so the lexer
+// doesn't keep track of them. Instead, the newlines are found afterwards
+// in a separate pass, 16 bytes at a time, which is much cheaper than a
+// branch on each character of the main loop. It's done right after lexing
+// (and not on the first error) so that diagnostics can be printed from
+// any thread without synchronization.
+static void BuildLineIndex(Tokenizer* t, size_t fileSize)
+{
+    ProfileFunc(prof);
+    
+    char* src = t->fileContents;
+    t->lineStarts.Reserve(t->arena, fileSize / Lexer_CharsPerLineEstimate + 16);
+    t->lineStarts.Append(t->arena, 0);
+    
+    size_t i = 0;
+#ifdef Lexer_SSE2
+    const __m128i newline = _mm_set1_epi8('\n');
+    for(; i + 16 <= fileSize; i += 16)
+    {
+        __m128i chunk = _mm_loadu_si128((__m128i*)(src + i));
+        uint32 mask = (uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline));
+        while(mask != 0)
+        {
+            t->lineStarts.Append(t->arena, (uint32)(i + LowestSetBit(mask) + 1));
+            mask &= mask - 1;
+        }
+    }
+#endif
+    
+    // Remaining bytes
+    for(; i < fileSize; ++i)
+    {
+        if(IsNewline(src[i]))
+            t->lineStarts.Append(t->arena, (uint32)(i + 1));
+    }
+}
+
+static void ReserveTokens(Tokenizer* t, uint32 capacity)
+{
+    if(capacity <= t->tokCapacity) return;
+    
+    uint32 oldCap = t->tokCapacity;
+    t->tokTypes    = (uint16*)Arena_ResizeLastAlloc(t->arena, t->tokTypes,    sizeof(uint16) * oldCap, sizeof(uint16) * capacity, alignof(uint16));
+    t->tokOffsets  = (uint32*)Arena_ResizeLastAlloc(t->arena, t->tokOffsets,  sizeof(uint32) * oldCap, sizeof(uint32) * capacity, alignof(uint32));
+    t->tokLengths  = (uint32*)Arena_ResizeLastAlloc(t->arena, t->tokLengths,  sizeof(uint32) * oldCap, sizeof(uint32) * capacity, alignof(uint32));
+    t->tokPayloads = (uint32*)Arena_ResizeLastAlloc(t->arena, t->tokPayloads, sizeof(uint32) * oldCap, sizeof(uint32) * capacity, alignof(uint32));
+    t->tokCapacity = capacity;
+}
+
+static TokenIdx PushToken(Tokenizer* t, TokenType type, uint32 offset, uint32 length, uint32 payload)
+{
+    if(t->numTokens >= t->tokCapacity)
+        ReserveTokens(t, t->tokCapacity * 2);
+    
+    TokenIdx idx = t->numTokens;
+    t->tokTypes[idx]    = (uint16)type;
+    t->tokOffsets[idx]  = offset;
+    t->tokLengths[idx]  = length;
+    t->tokPayloads[idx] = payload;
+    ++t->numTokens;
+    return idx;
 }
 
-static Token GetToken(Tokenizer* t)
+static TokenIdx GetToken(Tokenizer* t)
 {
     EatAllWhitespace(t);
     
-    Token result;
-    result.type    = Tok_Error;
-    result.sl      = t->startOfCurLine;
-    result.lineNum = t->curLineNum;
-    result.sc      = t->at - t->fileContents;
-    result.ec      = result.sc;
-    result.text    = { t->at, 1 };
-    result.ident.hash = 0;
+    TokenType type = Tok_Error;
+    uint32 offset  = t->at - t->fileContents;
+    uint32 length  = 1;
+    uint32 payload = 0;
     
     if(t->at[0] == 0)  // String terminator
     {
-        result.type = Tok_EOF;
-        result.ec = result.sc;
+        type = Tok_EOF;
+        length = 0;
     }
     else if(IsAllowedForStartIdent(t->at[0]))  // Identifiers or keywords
     {
-        result.type = Tok_Ident;
+        type = Tok_Ident;
         for(int i = 1; IsAllowedForMiddleIdent(t->at[i]); ++i)
-            ++result.text.length;
+            ++length;
         
         bool isKeyword = false;
-        TokenType match = MatchKeywords(t, result.text.length);
+        TokenType match = MatchKeywords(t, length);
         if(match != (TokenType)-1)
         {
             isKeyword = true;
-            result.type = match;
+            type = match;
         }
         
-        t->at += result.text.length;
-        result.ec = result.sc + result.text.length - 1;
+        // Intern the identifier for faster string comparisons
+        if(!isKeyword) payload = Atom_Intern({ t->at, (int64)length });
         
-        // Fill in the hash for faster string comparisons
-        if(!isKeyword) result.ident.hash = HashString(result.text);
+        t->at += length;
     }
     else if(IsNumeric(t->at[0]))  // Numbers
     {
         // Determine which type of number it is
-        int length = 0;
+        length = 0;
         bool32 isFloatingPoint = false;
         bool32 isDoublePrecision = false;
         
+        TokenLiteral literal;
+        literal.intValue = 0;
+        
         do
         {
             ++length;
@@ -282,9 +345,9 @@ static Token GetToken(Tokenizer* t)
         {
             if(t->at[length] == 'd')
             {
-                result.type = Tok_DoubleNum;
+                type = Tok_DoubleNum;
                 char* endPtr;
-                result.doubleValue = strtod(t->at, &endPtr);
+                literal.doubleValue = strtod(t->at, &endPtr);
                 Assert(endPtr == t->at + length);
                 
                 isDoublePrecision = true;
@@ -292,9 +355,9 @@ static Token GetToken(Tokenizer* t)
             }
             else
             {
-                result.type = Tok_FloatNum;
+                type = Tok_FloatNum;
                 char* endPtr;
-                result.floatValue = strtof(t->at, &endPtr);
+                literal.floatValue = strtof(t->at, &endPtr);
                 Assert(endPtr == t->at + length);
                 
                 // Eat the optional 'f' at the end of single precision floating point
@@ -304,57 +367,51 @@ static Token GetToken(Tokenizer* t)
         }
         else
         {
-            result.type = Tok_IntNum;
+            type = Tok_IntNum;
             char* endPtr;
-            result.intValue = strtoll(t->at, &endPtr, 10);
+            literal.intValue = strtoll(t->at, &endPtr, 10);
             if(endPtr == t->at)
             {
                 SetErrorColor();
                 fprintf(stderr, "Error");
                 ResetColor();
                 fprintf(stderr, ": Unidentified token\n");
-                result.type = Tok_Error;
-                result.doubleValue = 0.0f;
+                type = Tok_Error;
             }
             else
                 Assert(endPtr == t->at + length);
             
         }
         
+        if(type != Tok_Error)
+        {
+            payload = t->tokLiterals.length;
+            t->tokLiterals.Append(t->arena, literal);
+        }
+        
         t->at += length;
-        result.text.length = length;
-        result.ec = result.sc + result.text.length - 1;
     }
     else  // Anything else (operators, parentheses, etc)
     {
         bool found = false;
-        String foundStr = { 0, 0 };
         for(int i = 0; i < StArraySize(operatorStrings); ++i)
         {
-            if(StringBeginsWith(result.text.ptr, operatorStrings[i]))
+            if(StringBeginsWith(t->at, operatorStrings[i]))
             {
-                result.text.length = operatorStrings[i].length;
-                result.type = operatorTypes[i];
+                length = operatorStrings[i].length;
+                type = operatorTypes[i];
                 found = true;
                 break;
             }
         }
         
-        if(found)
-        {
-            t->at += result.text.length;
-            result.ec = result.sc + result.text.length - 1;
-        }
-        else
-        {
-            result.type = (TokenType)t->at[0];
-            result.text.length = 1;
-            result.ec   = result.sc;
-            ++t->at;
-        }
+        if(!found)
+            type = (TokenType)t->at[0];
+        
+        t->at += length;
     }
     
-    return result;
+    return PushToken(t, type, offset, length, payload);
 }
 
 bool MatchAlpha(char* stream, char* str, int tokenLength)
@@ -488,11 +545,38 @@ TokenType MatchKeywords(Tokenizer* t, int tokenLength)
     return res;
 }
 
-void PrintFileLine(Token* token, char* fileContents)
+uint32 GetTokLine(Tokenizer* t, TokenIdx tok, uint32* outLineStart)
 {
+    uint32 offset = t->tokOffsets[tok];
+    
+    // Binary search for the last line starting before the token
+    int64 lo = 0;
+    int64 hi = t->lineStarts.length - 1;
+    while(lo < hi)
+    {
+        int64 mid = (lo + hi + 1) / 2;
+        if(t->lineStarts[mid] <= offset)
+            lo = mid;
+        else
+            hi = mid - 1;
+    }
+    
+    *outLineStart = t->lineStarts[lo];
+    return lo + 1;
+}
+
+void PrintFileLine(Tokenizer* t, TokenIdx token)
+{
+    char* fileContents = t->fileContents;
+    
+    uint32 sl = 0;
+    GetTokLine(t, token, &sl);
+    uint32 sc = t->tokOffsets[token];
+    uint32 ec = t->tokLengths[token] > 0 ? sc + t->tokLengths[token] - 1 : sc;
+    
     fprintf(stderr, "    > ");
     bool endOfLine = false;
-    int i = token->sl;
+    int i = sl;
     while(!endOfLine)
     {
         if(fileContents[i] == '\t')
@@ -506,11 +590,11 @@ void PrintFileLine(Token* token, char* fileContents)
             fileContents[i] == 0;
     }
     
-    int length = i - token->sl;
+    int length = i - sl;
     
     fprintf(stderr, "\n    > ");
     
-    for(int i = token->sl; i < token->sc; ++i)
+    for(int i = sl; i < sc; ++i)
     {
         if(fileContents[i] == '\t')
             fprintf(stderr, "    ");
@@ -520,7 +604,7 @@ void PrintFileLine(Token* token, char* fileContents)
     
     fprintf(stderr, "^");
     
-    for(int i = token->sc; i < token->ec - 1; ++i)
+    for(int i = sc; i < (int)ec - 1; ++i)
     {
         if(fileContents[i] == '\t')
             fprintf(stderr, "----");
@@ -528,25 +612,27 @@ void PrintFileLine(Token* token, char* fileContents)
             fprintf(stderr, "-");
     }
     
-    if(token->sc != token->ec)
+    if(sc != ec)
         fprintf(stderr, "^\n");
     else
         fprintf(stderr, "\n");
 }
 
-void CompileError(Tokenizer* t, Token* token, String message)
+void CompileError(Tokenizer* t, TokenIdx token, String message)
 {
-    if(token->type == Tok_EOF || token->type == Tok_Error)
+    TokenType type = TokType(t, token);
+    if(type == Tok_EOF || type == Tok_Error)
     {
         printf("Reached unexpected EOF\n");
         return;
     }
     
-    char* fileContents = t->fileContents;
     t->lastCompileErrorNumChars = 0;
     
+    uint32 lineStart = 0;
+    uint32 lineNum = GetTokLine(t, token, &lineStart);
     t->lastCompileErrorNumChars += fprintf(stderr, "%.*s", (int)t->path.length, t->path.ptr); 
-    fprintf(stderr, "(%d,%d): ", token->lineNum, token->sc - token->sl + 1);
+    fprintf(stderr, "(%d,%d): ", lineNum, t->tokOffsets[token] - lineStart + 1);
     
     SetErrorColor();
     fprintf(stderr, "Error");
@@ -554,32 +640,33 @@ void CompileError(Tokenizer* t, Token* token, String message)
     
     fprintf(stderr, ": %.*s\n", (int)message.length, message.ptr);
     
-    PrintFileLine(token, fileContents);
+    PrintFileLine(t, token);
     
     t->compileErrorPrinted = true;
 }
 
-void CompileErrorContinue(Tokenizer* t, Token* token, String message)
+void CompileErrorContinue(Tokenizer* t, TokenIdx token, String message)
 {
     if(!t->compileErrorPrinted)
         return;
     t->compileErrorPrinted = false;
     
-    if(token->type == Tok_EOF || token->type == Tok_Error)
+    TokenType type = TokType(t, token);
+    if(type == Tok_EOF || type == Tok_Error)
     {
         printf("Reached unexpected EOF\n");
         return;
     }
     
-    char* fileContents = t->fileContents;
-    
     for(int i = 0; i < t->lastCompileErrorNumChars; ++i)
         fprintf(stderr, " ");
     
-    fprintf(stderr, "(%d,%d): Note: ", token->lineNum, token->sc - token->sl + 1);
+    uint32 lineStart = 0;
+    uint32 lineNum = GetTokLine(t, token, &lineStart);
+    fprintf(stderr, "(%d,%d): Note: ", lineNum, t->tokOffsets[token] - lineStart + 1);
     fprintf(stderr, "%.*s\n", (int)message.length, message.ptr);
     
-    PrintFileLine(token, fileContents);
+    PrintFileLine(t, token);
 }
 
 String TokTypeToString(TokenType tokType, Arena* dest)
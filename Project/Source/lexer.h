@@ -2,7 +2,7 @@
 #pragma once
 
 #include "base.h"
-//#include "atom.h"
+#include "atom.h"
 
 // NOTE(Leo): ASCII characters are reserved in the enum
 // space, so that they can be used as token types. For instance,
@@ -98,41 +98,44 @@ enum TokenType
     Tok_Error,
 };
 
-struct Token
+// Value of a number literal token, stored in
+// a side table referenced by the token's payload
+union TokenLiteral
 {
-    TokenType type = Tok_Error;
-    
-    uint32 sl, sc;  // Start of line, starting character
-    uint32 ec;      // end character
-    uint32 lineNum;
-    
-    union
-    {
-        String text;
-        HashedString ident;
-    };
-    
-    // Additional information
-    union
-    {
-        int64 intValue;
-        float floatValue;
-        double doubleValue;
-    };
+    int64 intValue;
+    float floatValue;
+    double doubleValue;
 };
 
+// Index of a token in the tokenizer's stream. Index 0 is never
+// a real token, so it can be used as a null token.
+typedef uint32 TokenIdx;
+
 struct Tokenizer
 {
     String path = { 0, 0 };
     
     char* fileContents;
     char* at;
-    uint32 startOfCurLine = 0;
-    uint32 curLineNum = 1;
     int commentNestLevel = 0;
     
     Arena* arena;
-    Slice<Token> tokens = { 0, 0 };
+    
+    // Token stream, stored as a structure of arrays so that
+    // the parser's lookahead (which mostly looks at the types)
+    // only touches a few cache lines.
+    uint16* tokTypes    = 0;
+    uint32* tokOffsets  = 0;  // Offset of the first character in the file
+    uint32* tokLengths  = 0;
+    uint32* tokPayloads = 0;  // Atom for identifiers, index in tokLiterals for numbers
+    uint32 numTokens    = 0;
+    uint32 tokCapacity  = 0;
+    ArenaArray<TokenLiteral> tokLiterals;
+    
+    // Offset of the start of each line, filled in by BuildLineIndex
+    // after lexing. Line and column numbers are only computed from
+    // this when printing diagnostics.
+    ArenaArray<uint32> lineStarts;
     
     // Used for the not very good "Continue" functions
     bool compileErrorPrinted = false;
@@ -141,7 +144,9 @@ struct Tokenizer
 
 Tokenizer InitTokenizer(Arena* arena, Arena* internArena, char* fileContents, String path);
 
-static Token GetToken(Tokenizer* t);
+static TokenIdx GetToken(Tokenizer* t);
+static TokenIdx PushToken(Tokenizer* t, TokenType type, uint32 offset, uint32 length, uint32 payload);
+static void ReserveTokens(Tokenizer* t, uint32 capacity);
 
 inline bool IsAlphabetic(char c);
 inline bool IsNumeric(char c);
@@ -156,12 +161,25 @@ TokenType MatchKeywords(Tokenizer* t, int tokenLength);
 bool MatchAlpha(char* stream, char* str, int tokenLength);
 
 static void LexFile(Tokenizer* t);
+static void BuildLineIndex(Tokenizer* t, size_t fileSize);
 
 inline bool IsTokIdent(TokenType tokType) { return tokType >= Tok_IdentBegin && tokType <= Tok_IdentEnd; }
 
-void EatToken(Tokenizer* t);
-Token* PeekToken(Tokenizer* t, int lookahead);
-inline Token* PeekNextToken(Tokenizer* t) { return PeekToken(t, 1); }
+// Token accessors
+cforceinline TokenType TokType(Tokenizer* t, TokenIdx tok) { return (TokenType)t->tokTypes[tok]; }
+cforceinline String TokText(Tokenizer* t, TokenIdx tok) { return { t->fileContents + t->tokOffsets[tok], (int64)t->tokLengths[tok] }; }
+cforceinline TokenLiteral TokLiteral(Tokenizer* t, TokenIdx tok) { return t->tokLiterals[t->tokPayloads[tok]]; }
+cforceinline InternedString TokIdent(Tokenizer* t, TokenIdx tok)
+{
+    InternedString result;
+    result.str  = TokText(t, tok);
+    result.atom = t->tokPayloads[tok];
+    return result;
+}
+
+// Returns the line number (starting from 1) of the token,
+// and the offset of the start of that line
+uint32 GetTokLine(Tokenizer* t, TokenIdx tok, uint32* outLineStart);
 
-void CompileError(Tokenizer* t, Token* token, String message);
-void CompileErrorContinue(Tokenizer* t, Token* token, String message);
+void CompileError(Tokenizer* t, TokenIdx token, String message);
+void CompileErrorContinue(Tokenizer* t, TokenIdx token, String message);
@@ -8,6 +8,14 @@
 #include "interpreter.h"
 #include "bytecode_builder.h"
 #include "cmdline_args.h"
+#include "benchmarks.h"
+#include "perf_regress.h"
+#include "job_system.h"
+#include "corpus_gen.h"
+#include "compile_stats.h"
+#include "snapshot.h"
+#include "incremental.h"
+#include "os/os_agnostic.h"
 
 #include "tilde_codegen.h"
 
@@ -21,22 +29,13 @@ struct FilePaths
     Array<char*> objFiles;
 };
 
-// Times measured in number of ticks returned by __rdtsc()
-struct Timings
-{
-    double frontend = 0;
-    double irGen = 0;
-    double backend = 0;
-    double linker = 0;
-};
-
 Timings timings;
+Counters counters;
 
 FilePaths ParseCmdLineArgs(Slice<char*> args);
 void PrintHelp();
 template<typename t>
 void PrintArg(char* argName, char* desc, t defVal, int lpad, int rpad);
-void PrintTimings();
 
 // TODO: @cleanup Push some of the stuff here to the proper modules
 int main(int argCount, char** argValue)
@@ -55,6 +54,56 @@ int main(int argCount, char** argValue)
         if(noFiles)
             return 0;
     }
+    else if(cmdLineArgs.bench)
+    {
+        OS_Init();
+        
+        ThreadContext threadCtx;
+        ThreadCtx_Init(&threadCtx, GB(2), KB(32));
+        SetThreadContext(&threadCtx);
+        
+        Job_Init(cmdLineArgs.numThreads);
+        defer(Job_Shutdown());
+        
+        Bench_RunAll();
+        return 0;
+    }
+    else if(cmdLineArgs.genCorpus[0] != '\0')
+    {
+        OS_Init();
+        OS_OutputColorInit();
+        
+        Arena arena = Arena_VirtualMemInit(GB(4), MB(2));
+        defer(Arena_Free(&arena));
+        
+        String corpus = Corpus_Generate(&arena, Corpus_DefaultParams(cmdLineArgs.corpusScale));
+        if(!Corpus_WriteFile(cmdLineArgs.genCorpus, corpus))
+        {
+            SetErrorColor();
+            fprintf(stderr, "Error");
+            ResetColor();
+            fprintf(stderr, ": Could not write to the file %s.\n", cmdLineArgs.genCorpus);
+            return 1;
+        }
+        
+        printf("Generated %s (%lld bytes).\n", cmdLineArgs.genCorpus, (long long)corpus.length);
+        return 0;
+    }
+    else if(cmdLineArgs.perfBaseline[0] != '\0')
+    {
+        OS_Init();
+        OS_OutputColorInit();
+        
+        ThreadContext threadCtx;
+        ThreadCtx_Init(&threadCtx, GB(2), KB(32));
+        SetThreadContext(&threadCtx);
+        
+        Job_Init(cmdLineArgs.numThreads);
+        defer(Job_Shutdown());
+        
+        bool ok = Perf_RunAll(filePaths.srcFiles, cmdLineArgs.perfBaseline, cmdLineArgs.perfRuns, cmdLineArgs.perfUpdate);
+        return ok ? 0 : 1;
+    }
     else if(noFiles)
     {
         OS_OutputColorInit();
@@ -69,6 +118,9 @@ int main(int argCount, char** argValue)
     // OS-specific initialization
     OS_Init();
     
+    if(cmdLineArgs.hugePages)
+        Arena_EnableHugePages(true);
+    
 #ifdef Profile
     InitSpall();
     defer(QuitSpall());
@@ -77,16 +129,29 @@ int main(int argCount, char** argValue)
     // Start of application
     ProfileFunc(prof);
     
-    uint64 frontendTimeStart = __rdtsc();
+    uint64 frontendTimeStart = GetMonotonicTimeNs();
     
     // Main thread context
     ThreadContext threadCtx;
     ThreadCtx_Init(&threadCtx, GB(2), KB(32));
     SetThreadContext(&threadCtx);
     
-    char* fileContents = ReadEntireFileIntoMemoryAndNullTerminate(filePaths.srcFiles[0]);
-    if(!fileContents)
+    Job_Init(cmdLineArgs.numThreads);
+    defer({
+              if(cmdLineArgs.jobStats) Job_PrintStats();
+              Job_Shutdown();
+          });
+    
+    MappedFile srcFile = MapFileReadOnly(filePaths.srcFiles[0]);
+    if(!srcFile.ptr)
+    {
+        printf("Usage Error: Could not find the file %s\n", filePaths.srcFiles[0]);
         return 1;
+    }
+    
+    // NOTE: The AST points into the file contents
+    defer(UnmapFile(srcFile));
+    char* fileContents = srcFile.ptr;
     
     size_t size = GB(1);
     size_t commitSize = MB(2);
@@ -94,45 +159,132 @@ int main(int argCount, char** argValue)
     Arena internArena = Arena_VirtualMemInit(size, commitSize);
     Arena entityArena = Arena_VirtualMemInit(size, commitSize);
     
+    defer({
+              if(cmdLineArgs.mem)
+              {
+                  Arena_RecordStats("AST", &astArena);
+                  Arena_RecordStats("Intern", &internArena);
+                  Arena_RecordStats("Entity", &entityArena);
+                  for(int i = 0; i < ThreadCtx_NumScratchArenas; ++i)
+                      Arena_RecordStats("Scratch", &threadCtx.scratchPool[i]);
+                  Job_RecordArenaStats();
+                  
+                  Arena_PrintStats();
+              }
+          });
+    
     Tokenizer tokenizer = InitTokenizer(&astArena, &internArena, fileContents, { filePaths.srcFiles[0], (int64)strlen(filePaths.srcFiles[0]) });
     Parser parser = { &astArena, &tokenizer };
     parser.entityArena = &entityArena;
     
-    // Main stuff
-    LexFile(&tokenizer);
-    Ast_FileScope* fileAst = ParseFile(&parser);
-    
-    if(!parser.status)
+    Interp interp;
+    Ast_FileScope* fileAst = 0;
+    bool status = true;
+    defer(if(cmdLineArgs.entityCosts > 0) Dg_PrintEntityCosts(parser.entities, cmdLineArgs.entityCosts));
+    
+    // NOTE: The interp points into the snapshot, if it's used
+    String src = { fileContents, (int64)srcFile.size };
+    MappedFile snapshot = { 0 };
+    defer(UnmapFile(snapshot));
+    bool resumed = false;
+    if(cmdLineArgs.snapshot[0] != '\0')
+        resumed = Snap_Load(cmdLineArgs.snapshot, src, &interp, &snapshot);
+    
+    if(!resumed)
     {
-        printf("There were syntax errors!\n");
-        return 1;
-    }
-    
+        // Main stuff
+        uint64 lexStart = GetMonotonicTimeNs();
+        LexFile(&tokenizer);
+        timings.lex += SecondsSince(lexStart);
+        counters.tokens += tokenizer.numTokens;
+        
+        uint64 parseStart = GetMonotonicTimeNs();
+        fileAst = ParseFile(&parser);
+        timings.parse += SecondsSince(parseStart);
+        counters.entities += parser.entities.length;
+        
+        if(!parser.status)
+        {
+            printf("There were syntax errors!\n");
+            return 1;
+        }
+        
 #ifdef Debug
-    fflush(stdout);
-    fflush(stderr);
+        fflush(stdout);
+        fflush(stderr);
 #endif
-    
-    // Main program loop
-    Interp interp;
-    bool status = MainDriver(&parser, &interp, fileAst);
-    
-    timings.frontend += 1.0 / GetRdtscFreq() * (__rdtsc() - frontendTimeStart);
-    
-    if(!status)
+        
+        Incr_Cache incr;
+        bool incremental = cmdLineArgs.incremental[0] != '\0' && Incr_Prepare(&incr, &parser, cmdLineArgs.incremental);
+        defer(if(incremental) Incr_Free(&incr));
+        
+        // Main program loop
+        status = MainDriver(&parser, &interp, fileAst, incremental ? &incr : 0);
+        
+        timings.frontend += SecondsSince(frontendTimeStart);
+        
+        if(!status)
+        {
+            printf("There were semantic errors!\n");
+            return 1;
+        }
+        
+        // NOTE: The cache has the bytecode before inlining, which
+        // only depends on the procedure itself and the declarations it uses
+        if(incremental && !Incr_WriteCache(&incr, &parser, &interp, cmdLineArgs.incremental))
+        {
+            SetErrorColor();
+            fprintf(stderr, "Warning");
+            ResetColor();
+            fprintf(stderr, ": Could not write the incremental compilation cache to %s.\n", cmdLineArgs.incremental);
+        }
+        
+#ifdef Debug
+        fflush(stdout);
+        fflush(stderr);
+#endif
+        
+        if(cmdLineArgs.optLevel >= 1)
+            Interp_InlineProcs(&interp);
+        
+        if(cmdLineArgs.snapshot[0] != '\0' && !Snap_Write(cmdLineArgs.snapshot, src, &interp))
+        {
+            SetErrorColor();
+            fprintf(stderr, "Warning");
+            ResetColor();
+            fprintf(stderr, ": Could not write the snapshot to %s.\n", cmdLineArgs.snapshot);
+        }
+    }
+    else
     {
-        printf("There were semantic errors!\n");
-        return 1;
+        timings.frontend += SecondsSince(frontendTimeStart);
     }
     
-#ifdef Debug
-    fflush(stdout);
-    fflush(stderr);
-#endif
+    if(cmdLineArgs.run)
+    {
+        Interp_Proc* mainProc = Interp_FindProc(&interp, "main");
+        if(!mainProc)
+        {
+            SetErrorColor();
+            fprintf(stderr, "Error");
+            ResetColor();
+            fprintf(stderr, ": No main procedure was found.\n");
+            return 1;
+        }
+        
+        VirtualMachine vm = Interp_InitVM(&interp);
+        defer(Interp_FreeVM(&vm));
+        
+        Interp_Register ret = Interp_ExecProc(&vm, mainProc, { 0, 0 });
+        if(vm.profile) Interp_PrintVMProfile(&vm);
+        
+        return vm.status ? (int)ret.value : 1;
+    }
     
-    Tc_CodegenAndLink(fileAst, &interp, filePaths.objFiles);
+    Tc_CodegenAndLink(fileAst, &interp, filePaths.objFiles, !cmdLineArgs.noLink);
     
-    if(cmdLineArgs.time) PrintTimings();
+    if(cmdLineArgs.timeJson)  PrintTimingsJson();
+    else if(cmdLineArgs.time) PrintTimings();
     
     return !status;
 }
@@ -306,3 +458,45 @@ void PrintTimings()
     
     printf("-------------------\n");
 }
+
+void PrintTimingsJson()
+{
+    // Indexed by CompPhase
+    char* phaseKeys[] = { "uninit", "typecheck", "compute_size", "bytecode", "run" };
+    static_assert(StArraySize(phaseKeys) == CompPhase_EnumSize, "Missing key for a CompPhase");
+    
+    const double total = timings.frontend + timings.irGen + timings.backend + timings.linker;
+    
+    printf("{\n");
+    printf("    \"timings\": {\n");
+    printf("        \"frontend\": %.9f,\n", timings.frontend);
+    printf("        \"lex\": %.9f,\n", timings.lex);
+    printf("        \"parse\": %.9f,\n", timings.parse);
+    for(int i = CompPhase_Uninit + 1; i < CompPhase_EnumSize; ++i)
+        printf("        \"%s\": %.9f,\n", phaseKeys[i], timings.phases[i]);
+    printf("        \"cycle_detection\": %.9f,\n", timings.cycleDetection);
+    printf("        \"ir_gen\": %.9f,\n", timings.irGen);
+    printf("        \"backend\": %.9f,\n", timings.backend);
+    printf("        \"linker\": %.9f,\n", timings.linker);
+    printf("        \"total\": %.9f\n", total);
+    printf("    },\n");
+    
+    printf("    \"counters\": {\n");
+    printf("        \"tokens\": %llu,\n", (unsigned long long)counters.tokens);
+    printf("        \"ast_nodes\": %llu,\n", (unsigned long long)counters.astNodes);
+    printf("        \"entities\": %llu,\n", (unsigned long long)counters.entities);
+    printf("        \"yields\": {");
+    for(int i = CompPhase_Uninit + 1; i < CompPhase_EnumSize; ++i)
+    {
+        printf(" \"%s\": %llu", phaseKeys[i], (unsigned long long)counters.yields[i]);
+        if(i < CompPhase_EnumSize - 1) printf(",");
+    }
+    printf(" },\n");
+    printf("        \"driver_rounds\": %llu,\n", (unsigned long long)counters.driverRounds);
+    printf("        \"bytecode_instrs\": %llu,\n", (unsigned long long)counters.bytecodeInstrs);
+    printf("        \"procs\": %llu,\n", (unsigned long long)counters.procs);
+    printf("        \"cached_procs\": %llu,\n", (unsigned long long)counters.cachedProcs);
+    printf("        \"bytes_emitted\": %llu\n", (unsigned long long)counters.bytesEmitted);
+    printf("    }\n");
+    printf("}\n");
+}
@@ -48,9 +48,29 @@ void Arena_Init(Arena* arena,
     arena->offset     = 0;
     arena->prevOffset = 0;
     arena->commitSize = commitSize;
+    arena->committed  = commitSize > 0 ? 0 : backingBufferLength;
+    arena->retainSize = Arena_RetainAll;
+    arena->block      = 0;
+    arena->totalCommitted = arena->committed;
+    arena->peakCommitted  = arena->committed;
     
     if(commitSize > 0)
-        CommitMemory(backingBuffer, commitSize);
+        Arena_Commit(arena, commitSize);
+}
+
+static bool arenaHugePages = false;
+
+void Arena_EnableHugePages(bool enable)
+{
+    arenaHugePages = enable;
+}
+
+uchar* Arena_Reserve(size_t size)
+{
+    if(arenaHugePages)
+        return (uchar*)ReserveMemoryHuge(size);
+    
+    return (uchar*)ReserveMemory(size);
 }
 
 Arena Arena_VirtualMemInit(size_t reserveSize, size_t commitSize)
@@ -58,19 +78,133 @@ Arena Arena_VirtualMemInit(size_t reserveSize, size_t commitSize)
     Assert(commitSize > 0);
     
     Arena result;
-    result.buffer     = (uchar*)ReserveMemory(reserveSize);
+    result.buffer     = Arena_Reserve(reserveSize);
     result.length     = reserveSize;
     result.offset     = 0;
     result.prevOffset = 0;
     result.commitSize = commitSize;
+    result.committed  = 0;
+    result.retainSize = Arena_RetainAll;
+    result.block      = 0;
+    result.totalCommitted = 0;
+    result.peakCommitted  = 0;
     
     Assert(result.buffer);
-    CommitMemory(result.buffer, commitSize);
+    Arena_Commit(&result, commitSize);
     
     return result;
 }
 
-// TODO: Handle buffer overflow
+void Arena_Free(Arena* arena)
+{
+    while(arena->block)
+        Arena_PopBlock(arena);
+    
+    FreeMemory(arena->buffer, arena->length);
+    arena->buffer     = 0;
+    arena->length     = 0;
+    arena->offset     = 0;
+    arena->prevOffset = 0;
+    arena->committed  = 0;
+    arena->totalCommitted = 0;
+}
+
+// Commits the memory of the current block up to (at least) offset "end".
+// @performance Only the range past the high-water mark is committed,
+// instead of recommitting everything from the start of the buffer
+void Arena_Commit(Arena* arena, size_t end)
+{
+    if(arena->commitSize == 0 || end <= arena->committed)
+        return;
+    
+    size_t newCommitted = (size_t)AlignForward((uintptr)end, arena->commitSize);
+    if(newCommitted > arena->length)
+        newCommitted = arena->length;
+    
+    CommitMemory(arena->buffer + arena->committed, newCommitted - arena->committed);
+    arena->totalCommitted += newCommitted - arena->committed;
+    arena->peakCommitted   = max(arena->peakCommitted, arena->totalCommitted);
+    arena->committed = newCommitted;
+}
+
+// Decommits the memory of the current block which is
+// both unused and above the retained size
+void Arena_Decommit(Arena* arena)
+{
+    if(arena->commitSize == 0)
+        return;
+    
+    size_t keep = max(arena->offset, arena->retainSize);
+    keep = (size_t)AlignForward((uintptr)keep, arena->commitSize);
+    if(keep >= arena->committed)
+        return;
+    
+    DecommitMemory(arena->buffer + keep, arena->committed - keep);
+    arena->totalCommitted -= arena->committed - keep;
+    arena->committed = keep;
+}
+
+void Arena_SetRetainSize(Arena* arena, size_t retainSize)
+{
+    arena->retainSize = retainSize;
+}
+
+// Reserves a new block which can fit at least "size" bytes with the given
+// alignment, and makes it the current one. The previous block is kept alive
+// until the arena is reset past this point, so previous allocations stay valid.
+bool Arena_PushBlock(Arena* arena, size_t size, size_t align)
+{
+    // Stack-allocated arenas can't grow
+    if(arena->commitSize == 0)
+        return false;
+    
+    Arena_Block saved;
+    saved.prev       = arena->block;
+    saved.buffer     = arena->buffer;
+    saved.length     = arena->length;
+    saved.offset     = arena->offset;
+    saved.prevOffset = arena->prevOffset;
+    saved.committed  = arena->committed;
+    
+    // New blocks are at least as big as the first one
+    size_t headerSize = sizeof(Arena_Block);
+    size_t needed = headerSize + size + align;
+    size_t reserveSize = max(arena->length, needed);
+    reserveSize = (size_t)AlignForward((uintptr)reserveSize, arena->commitSize);
+    
+    uchar* newBuffer = Arena_Reserve(reserveSize);
+    if(!newBuffer)
+        return false;
+    
+    arena->buffer     = newBuffer;
+    arena->length     = reserveSize;
+    arena->offset     = headerSize;
+    arena->prevOffset = headerSize;
+    arena->committed  = 0;
+    Arena_Commit(arena, headerSize);
+    
+    arena->block  = (Arena_Block*)newBuffer;
+    *arena->block = saved;
+    return true;
+}
+
+// Releases the current block and restores the previous one
+void Arena_PopBlock(Arena* arena)
+{
+    Assert(arena->block);
+    
+    Arena_Block saved = *arena->block;
+    arena->totalCommitted -= arena->committed;
+    FreeMemory(arena->buffer, arena->length);
+    
+    arena->block      = saved.prev;
+    arena->buffer     = saved.buffer;
+    arena->length     = saved.length;
+    arena->offset     = saved.offset;
+    arena->prevOffset = saved.prevOffset;
+    arena->committed  = saved.committed;
+}
+
 void* Arena_Alloc(Arena* arena, size_t size, size_t align)
 {
     uintptr curPtr = (uintptr) arena->buffer + (uintptr) arena->offset;
@@ -79,35 +213,33 @@ void* Arena_Alloc(Arena* arena, size_t size, size_t align)
     // Convert to relative offset
     offset -= (uintptr) arena->buffer;
     
-    // Check to see if the backing memory has space left
-    if(offset + size <= arena->length)
+    // Check to see if the backing memory has space left,
+    // otherwise chain a new block
+    if(offset + size > arena->length)
     {
-        uintptr nextOffset = offset + size;
-        
-        if(arena->commitSize > 0)
+        if(!Arena_PushBlock(arena, size, align))
         {
-            uintptr commitAligned = nextOffset - (nextOffset %
-                                                  arena->commitSize); 
-            if(commitAligned > arena->offset)
-            {
-                size_t toCommit = commitAligned + arena->commitSize;
-                CommitMemory(arena->buffer, toCommit);
-            }
+            Assert(false && "Arena exceeded memory limit");
+            return 0;
         }
         
-        void* ptr = &arena->buffer[offset];
-        arena->offset  = nextOffset;
-        arena->prevOffset = offset;
-        
-        // Zero new memory for debugging
+        curPtr = (uintptr) arena->buffer + (uintptr) arena->offset;
+        offset = AlignForward(curPtr, align) - (uintptr) arena->buffer;
+    }
+    
+    uintptr nextOffset = offset + size;
+    Arena_Commit(arena, nextOffset);
+    
+    void* ptr = &arena->buffer[offset];
+    arena->offset  = nextOffset;
+    arena->prevOffset = offset;
+    
+    // Zero new memory for debugging
 #ifdef Debug
-        memset(ptr, 0, size);
+    memset(ptr, 0, size);
 #endif
-        
-        return ptr;
-    }
     
-    return 0;
+    return ptr;
 }
 
 void* Arena_ResizeLastAlloc(Arena* arena, void* oldMemory, size_t oldSize, size_t newSize, size_t align)
@@ -117,46 +249,32 @@ void* Arena_ResizeLastAlloc(Arena* arena, void* oldMemory, size_t oldSize, size_
     
     if(!oldMem || oldSize == 0)
         return Arena_Alloc(arena, newSize, align);
-    else if(arena->buffer <= oldMem && oldMem < (arena->buffer + arena->length))
+    
+    // Grow or shrink in place if this was the last allocation
+    // and there's enough space left in the current block
+    if((arena->buffer + arena->prevOffset) == oldMem &&
+       arena->prevOffset + newSize <= arena->length)
     {
-        if((arena->buffer + arena->prevOffset) == oldMem)
+        arena->offset = arena->prevOffset + newSize;
+        if(newSize > oldSize)
         {
-            auto prevOffset = arena->offset;
-            arena->offset = arena->prevOffset + newSize;
-            if(newSize > oldSize)
-            {
-                // Commit if needed
-                if(arena->commitSize > 0)
-                {
-                    uintptr commitAligned = arena->offset - (arena->offset %
-                                                             arena->commitSize); 
-                    if(commitAligned > prevOffset)
-                    {
-                        size_t toCommit = commitAligned + arena->commitSize;
-                        CommitMemory(arena->buffer, toCommit);
-                    }
-                }
-                
-                // Zero new memory for debugging
+            Arena_Commit(arena, arena->offset);
+            
+            // Zero new memory for debugging
 #ifdef Debug
-                memset(&arena->buffer[arena->prevOffset + oldSize], 0, newSize - oldSize);
+            memset(&arena->buffer[arena->prevOffset + oldSize], 0, newSize - oldSize);
 #endif
-            }
-            
-            return oldMemory;
-        }
-        else
-        {
-            void* newMemory = Arena_Alloc(arena, newSize, align);
-            size_t copySize = oldSize < newSize ? oldSize : newSize;
-            // Copy across old memory to the new memory
-            memmove(newMemory, oldMemory, copySize);
-            return newMemory;
         }
+        
+        return oldMemory;
     }
     
-    Assert(false && "Arena exceeded memory limit");
-    return 0;
+    // NOTE: The old memory might also be in a previous block
+    void* newMemory = Arena_Alloc(arena, newSize, align);
+    size_t copySize = oldSize < newSize ? oldSize : newSize;
+    // Copy across old memory to the new memory
+    memmove(newMemory, oldMemory, copySize);
+    return newMemory;
 }
 
 template<typename t>
@@ -189,6 +307,45 @@ char* Arena_PushStringAndNullTerminate(Arena* arena, String str)
     return result;
 }
 
+Array<Arena_Stats> arenaStats;
+
+void Arena_RecordStats(char* name, Arena* arena)
+{
+    for_array(i, arenaStats)
+    {
+        if(strcmp(arenaStats[i].name, name) == 0)
+        {
+            arenaStats[i].committed += arena->totalCommitted;
+            arenaStats[i].peak      += arena->peakCommitted;
+            return;
+        }
+    }
+    
+    arenaStats.Append({ name, arena->totalCommitted, arena->peakCommitted });
+}
+
+void Arena_PrintStats()
+{
+    const int pad = 19;
+    size_t totalCommitted = 0;
+    size_t totalPeak = 0;
+    
+    printf("----- Memory -----\n");
+    printf("%-*s%12s %12s\n", pad, "Arena", "Committed", "Peak");
+    for_array(i, arenaStats)
+    {
+        auto& stats = arenaStats[i];
+        printf("%-*s%10.2fMB %10.2fMB\n", pad, stats.name,
+               (double)stats.committed / MB(1), (double)stats.peak / MB(1));
+        totalCommitted += stats.committed;
+        totalPeak      += stats.peak;
+    }
+    
+    printf("%-*s%10.2fMB %10.2fMB\n", pad, "Total:",
+           (double)totalCommitted / MB(1), (double)totalPeak / MB(1));
+    printf("------------------\n");
+}
+
 cforceinline static uintptr AlignForward(uintptr ptr, size_t align)
 {
     Assert(IsPowerOf2(align));
@@ -49,6 +49,8 @@ new (Arena_Alloc((arenaPtr), sizeof(type), alignof(type))) type
 new (Arena_Alloc((arenaPtr), sizeof(type), (alignment))) type
 
 
+struct Arena_Block;
+
 struct Arena
 {
     uchar* buffer;
@@ -60,14 +62,51 @@ struct Arena
     // commitSize, if == 0, then it never
     // commits (useful for stack-allocated arenas)
     size_t commitSize;
+    
+    // High-water mark of the committed memory
+    // in the current block, only the delta is
+    // committed when it's exceeded
+    size_t committed;
+    
+    // When the arena is reset, committed memory
+    // above this size is decommitted (never,
+    // by default). See Arena_SetRetainSize
+    size_t retainSize;
+    
+    // Stats (across all blocks)
+    size_t totalCommitted;
+    size_t peakCommitted;
+    
+    // When the reserved memory runs out, a new block
+    // is reserved and chained to the previous one.
+    // The state of the previous block is stored
+    // at the start of the current one (null if
+    // this is the first block)
+    Arena_Block* block;
 };
 
+struct Arena_Block
+{
+    Arena_Block* prev;
+    uchar* buffer;
+    size_t length;
+    size_t offset;
+    size_t prevOffset;
+    size_t committed;
+};
+
+#define Arena_RetainAll ((size_t)-1)
+
+void Arena_PopBlock(Arena* arena);
+void Arena_Decommit(Arena* arena);
+
 // Can be used like:
 // TempArenaMemory tempGaurd = Arena_TempBegin(arena);
 // defer(Arena_TempEnd(tempGuard);
 struct TempArenaMemory
 {
     Arena* arena;
+    uchar* buffer;
     size_t offset;
     size_t prevOffset;
 };
@@ -76,6 +115,7 @@ inline TempArenaMemory Arena_TempBegin(Arena* arena)
 {
     TempArenaMemory tmp;
     tmp.arena      = arena;
+    tmp.buffer     = arena->buffer;
     tmp.offset     = arena->offset;
     tmp.prevOffset = arena->prevOffset;
     return tmp;
@@ -85,8 +125,17 @@ inline void Arena_TempEnd(TempArenaMemory tmp)
 {
     Assert(tmp.offset >= 0);
     Assert(tmp.prevOffset >= 0);
+    
+    // Release the blocks chained after
+    // the beginning of this temp memory
+    while(tmp.arena->buffer != tmp.buffer)
+        Arena_PopBlock(tmp.arena);
+    
     tmp.arena->offset     = tmp.offset;
     tmp.arena->prevOffset = tmp.prevOffset;
+    
+    if(tmp.arena->committed > tmp.arena->retainSize)
+        Arena_Decommit(tmp.arena);
 }
 
 // Serves as a helper for obtaining a scratch
@@ -131,6 +180,8 @@ uintptr AlignForward(uintptr ptr, size_t align);
 void Arena_Init(Arena* arena, void* backingBuffer,
                 size_t backingBufferLength, size_t commitSize);
 Arena Arena_VirtualMemInit(size_t reserveSize, size_t commitSize);
+void Arena_Commit(Arena* arena, size_t end);
+bool Arena_PushBlock(Arena* arena, size_t size, size_t align);
 void* Arena_Alloc(Arena* arena,
                   size_t size, size_t align = Default_Alignment);
 void* Arena_ResizeLastAlloc(Arena* arena, void* oldMemory,
@@ -147,6 +198,37 @@ char* Arena_PushString(Arena* arena, void* toCopy, size_t size);
 // by setting the buffer offsets to zero
 inline void Arena_FreeAll(Arena* arena)
 {
+    while(arena->block)
+        Arena_PopBlock(arena);
+    
     arena->offset     = 0;
     arena->prevOffset = 0;
-}
\ No newline at end of file
+    
+    if(arena->committed > arena->retainSize)
+        Arena_Decommit(arena);
+}
+
+// Releases all the memory reserved by an arena
+// created with Arena_VirtualMemInit
+void Arena_Free(Arena* arena);
+
+// Memory usage report
+struct Arena_Stats
+{
+    char* name;
+    size_t committed;
+    size_t peak;
+};
+
+// Sets the amount of committed memory that is kept when the
+// arena is reset. Anything above is given back to the OS.
+void Arena_SetRetainSize(Arena* arena, size_t retainSize);
+// If enabled, arenas created with Arena_VirtualMemInit from
+// now on (and their chained blocks) are backed by huge pages.
+// Their commit size should be a multiple of 2MB.
+void Arena_EnableHugePages(bool enable);
+uchar* Arena_Reserve(size_t size);
+// Takes a snapshot of the arena's memory usage. Arenas
+// with the same name are added together.
+void Arena_RecordStats(char* name, Arena* arena);
+void Arena_PrintStats();
@@ -34,8 +34,10 @@ extern "C"
     typedef bool BOOL;
 #if defined(_WIN64)
     typedef unsigned __int64 ULONG_PTR;
+    typedef __int64 LONG_PTR;
 #else
     typedef unsigned long ULONG_PTR;
+    typedef long LONG_PTR;
 #endif
     typedef ULONG_PTR SIZE_T;
 	typedef unsigned long DWORD;
@@ -51,6 +53,7 @@ extern "C"
 #define near
 #define NEAR near
 #define DUMMYSTRUCTNAME
+#define DUMMYUNIONNAME
     typedef int (FAR WINAPI *FARPROC)();
     typedef unsigned char BYTE;
     typedef BYTE far *LPBYTE;
@@ -91,8 +94,10 @@ extern "C"
     
 #define MEM_COMMIT     0x00001000
 #define MEM_RESERVE    0x00002000
+#define MEM_DECOMMIT   0x00004000
 #define MEM_RELEASE    0x00008000
 #define PAGE_READWRITE 0x04
+#define PAGE_EXECUTE_READ 0x20
     
     WINBASEAPI
         _Ret_maybenull_
@@ -115,6 +120,32 @@ extern "C"
                     _In_ DWORD dwFreeType
                     );
     
+    WINBASEAPI
+        BOOL
+        WINAPI
+        VirtualProtect(
+                       _In_ LPVOID lpAddress,
+                       _In_ SIZE_T dwSize,
+                       _In_ DWORD flNewProtect,
+                       _Out_ DWORD* lpflOldProtect
+                       );
+    
+    WINBASEAPI
+        BOOL
+        WINAPI
+        FlushInstructionCache(
+                              _In_ HANDLE hProcess,
+                              _In_reads_bytes_opt_(dwSize) LPCVOID lpBaseAddress,
+                              _In_ SIZE_T dwSize
+                              );
+    
+    WINBASEAPI
+        HANDLE
+        WINAPI
+        GetCurrentProcess(
+                          VOID
+                          );
+    
     void ASSERT(BOOL cond);
     
 #ifndef _M_CEE_PURE
@@ -491,10 +522,161 @@ extern "C"
 #define CreateProcess  CreateProcessA
 #endif // !UNICODE
     
+    // Files
+    
+#define GENERIC_READ          0x80000000L
+#define FILE_SHARE_READ       0x00000001
+#define OPEN_EXISTING         3
+#define FILE_ATTRIBUTE_NORMAL 0x00000080
+#define INVALID_HANDLE_VALUE  ((HANDLE)(LONG_PTR)-1)
+#define PAGE_READONLY         0x02
+#define FILE_MAP_READ         0x0004
+#define PAGE_WRITECOPY        0x08
+#define FILE_MAP_COPY         0x0001
+    
+    typedef DWORD* LPDWORD;
+    
+    typedef struct _SYSTEM_INFO {
+        union {
+            DWORD dwOemId;
+            struct {
+                WORD wProcessorArchitecture;
+                WORD wReserved;
+            } DUMMYSTRUCTNAME;
+        } DUMMYUNIONNAME;
+        DWORD dwPageSize;
+        LPVOID lpMinimumApplicationAddress;
+        LPVOID lpMaximumApplicationAddress;
+        ULONG_PTR dwActiveProcessorMask;
+        DWORD dwNumberOfProcessors;
+        DWORD dwProcessorType;
+        DWORD dwAllocationGranularity;
+        WORD wProcessorLevel;
+        WORD wProcessorRevision;
+    } SYSTEM_INFO, *LPSYSTEM_INFO;
+    
+    WINBASEAPI
+        VOID
+        WINAPI
+        GetSystemInfo(
+                      _Out_ LPSYSTEM_INFO lpSystemInfo
+                      );
+    
+    WINBASEAPI
+        HANDLE
+        WINAPI
+        CreateFileA(
+                    _In_ LPCSTR lpFileName,
+                    _In_ DWORD dwDesiredAccess,
+                    _In_ DWORD dwShareMode,
+                    _In_opt_ LPSECURITY_ATTRIBUTES lpSecurityAttributes,
+                    _In_ DWORD dwCreationDisposition,
+                    _In_ DWORD dwFlagsAndAttributes,
+                    _In_opt_ HANDLE hTemplateFile
+                    );
+    
+    WINBASEAPI
+        BOOL
+        WINAPI
+        GetFileSizeEx(
+                      _In_ HANDLE hFile,
+                      _Out_ LARGE_INTEGER* lpFileSize
+                      );
+    
+    WINBASEAPI
+        BOOL
+        WINAPI
+        ReadFile(
+                 _In_ HANDLE hFile,
+                 _Out_writes_bytes_to_opt_(nNumberOfBytesToRead, *lpNumberOfBytesRead) LPVOID lpBuffer,
+                 _In_ DWORD nNumberOfBytesToRead,
+                 _Out_opt_ LPDWORD lpNumberOfBytesRead,
+                 _Inout_opt_ void* lpOverlapped
+                 );
+    
+    WINBASEAPI
+        HANDLE
+        WINAPI
+        CreateFileMappingA(
+                           _In_ HANDLE hFile,
+                           _In_opt_ LPSECURITY_ATTRIBUTES lpFileMappingAttributes,
+                           _In_ DWORD flProtect,
+                           _In_ DWORD dwMaximumSizeHigh,
+                           _In_ DWORD dwMaximumSizeLow,
+                           _In_opt_ LPCSTR lpName
+                           );
+    
+    WINBASEAPI
+        LPVOID
+        WINAPI
+        MapViewOfFile(
+                      _In_ HANDLE hFileMappingObject,
+                      _In_ DWORD dwDesiredAccess,
+                      _In_ DWORD dwFileOffsetHigh,
+                      _In_ DWORD dwFileOffsetLow,
+                      _In_ SIZE_T dwNumberOfBytesToMap
+                      );
+    
+    WINBASEAPI
+        BOOL
+        WINAPI
+        UnmapViewOfFile(
+                        _In_ LPCVOID lpBaseAddress
+                        );
+    
+    // Threads
+    
+    typedef DWORD (WINAPI *LPTHREAD_START_ROUTINE)(LPVOID lpThreadParameter);
+    
+    WINBASEAPI
+        _Ret_maybenull_
+        HANDLE
+        WINAPI
+        CreateThread(
+                     _In_opt_ LPSECURITY_ATTRIBUTES lpThreadAttributes,
+                     _In_ SIZE_T dwStackSize,
+                     _In_ LPTHREAD_START_ROUTINE lpStartAddress,
+                     _In_opt_ LPVOID lpParameter,
+                     _In_ DWORD dwCreationFlags,
+                     _Out_opt_ LPDWORD lpThreadId
+                     );
+    
+    WINBASEAPI
+        BOOL
+        WINAPI
+        SwitchToThread(
+                       VOID
+                       );
+    
+    WINBASEAPI
+        DWORD
+        WINAPI
+        GetCurrentThreadId(
+                           VOID
+                           );
+    
+    WINBASEAPI
+        DWORD
+        WINAPI
+        GetCurrentProcessId(
+                            VOID
+                            );
+    
     // Synchronization
     
 #define INFINITE 0xFFFFFFFF
     
+    WINBASEAPI
+        _Ret_maybenull_
+        HANDLE
+        WINAPI
+        CreateSemaphoreA(
+                         _In_opt_ LPSECURITY_ATTRIBUTES lpSemaphoreAttributes,
+                         _In_ LONG lInitialCount,
+                         _In_ LONG lMaximumCount,
+                         _In_opt_ LPCSTR lpName
+                         );
+    
     WINBASEAPI
         BOOL
         WINAPI
@@ -9,15 +9,61 @@ void OS_OutputColorInit();
 
 // Memory utilities
 void* ReserveMemory(size_t size);
+// Reserves memory aligned to 2MB, and asks the OS to back it with
+// huge pages where possible. Commits should be in 2MB blocks.
+void* ReserveMemoryHuge(size_t size);
 void CommitMemory(void* mem, size_t size);
 void FreeMemory(void* mem, size_t size);
+// Gives the physical pages back to the OS, while
+// keeping the address range reserved
+void DecommitMemory(void* mem, size_t size);
+// Turns committed pages into read-only executable
+// pages (e.g. for JIT compiled code)
+void ProtectMemoryExecutable(void* mem, size_t size);
+
+// File utilities
+// Maps a file read-only in memory, without copying it. The
+// contents are always followed by a zero byte, so they can be
+// used as a null-terminated string. ptr is null on failure.
+struct MappedFile
+{
+    char* ptr;
+    size_t size;        // Size of the file, not counting the terminator
+    size_t mappedSize;
+    bool isCopy;        // The file had to be copied, see MapFileReadOnly
+};
+
+MappedFile MapFileReadOnly(char* path);
+// Maps a file in memory, writes go to private copies of the pages
+// and never reach the file. There's no terminator. ptr is null on
+// failure (or if the file is empty).
+MappedFile MapFileCopyOnWrite(char* path);
+void UnmapFile(MappedFile file);
 
 void SetThreadContext(void* ptr);
 void* GetThreadContext();
 
+// Threads and synchronization
+typedef void (*OS_ThreadProc)(void* userData);
+void* OS_StartThread(OS_ThreadProc proc, void* userData);
+void OS_JoinThread(void* thread);
+// Gives the rest of the time slice to another thread
+void OS_YieldThread();
+uint32 OS_GetThreadId();
+uint32 OS_GetProcessId();
+int OS_GetNumLogicalCores();
+
+// Counting semaphore, starting from 0
+void* OS_CreateSemaphore();
+void OS_FreeSemaphore(void* sem);
+void OS_SignalSemaphore(void* sem, int count);
+void OS_WaitSemaphore(void* sem);
+
 // Timing utilities
 // This function should cache the result
 static inline uint64 GetRdtscFreq();
+// Monotonic clock, in nanoseconds from an arbitrary point
+uint64 GetMonotonicTimeNs();
 
 // Printing utilities
 void SetErrorColor();
@@ -2,6 +2,15 @@
 #include "base.h"
 #include "os_agnostic.h"
 #include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/syscall.h>
 
 void* ReserveMemory(size_t size)
 {
@@ -14,6 +23,34 @@ void* ReserveMemory(size_t size)
     return result;
 }
 
+void* ReserveMemoryHuge(size_t size)
+{
+    ProfileFunc(prof);
+    
+    // NOTE: MAP_HUGETLB is not used because it requires a preallocated
+    // pool of huge pages, and the whole range would be backed immediately.
+    // Transparent huge pages work with reserve/commit instead, as long as
+    // the range is aligned.
+    const size_t hugePageSize = MB(2);
+    size_t reserveSize = size + hugePageSize;
+    uchar* base = (uchar*)mmap(0, reserveSize, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, (off_t)0);
+    Assert(base != MAP_FAILED && "mmap failed!");
+    if(base == MAP_FAILED)
+        return 0;
+    
+    // Trim the excess so that the start is aligned
+    uchar* result = (uchar*)(((uintptr)base + hugePageSize - 1) & ~(uintptr)(hugePageSize - 1));
+    size_t before = result - base;
+    size_t after  = reserveSize - before - size;
+    if(before > 0) munmap(base, before);
+    if(after > 0)  munmap(result + size, after);
+    
+#ifdef MADV_HUGEPAGE
+    madvise(result, size, MADV_HUGEPAGE);
+#endif
+    return result;
+}
+
 void CommitMemory(void* mem, size_t size)
 {
     int result = mprotect(mem, size, PROT_READ | PROT_WRITE);
@@ -21,7 +58,198 @@ void CommitMemory(void* mem, size_t size)
 }
 
 void FreeMemory(void* mem, size_t size)
+{
+    int result = munmap(mem, size);
+    Assert(!result && "munmap failed!");
+}
+
+void DecommitMemory(void* mem, size_t size)
 {
     int result = madvise(mem, size, MADV_DONTNEED);
     Assert(result != -1 && "madvise failed!");
-}
\ No newline at end of file
+}
+
+void ProtectMemoryExecutable(void* mem, size_t size)
+{
+    int result = mprotect(mem, size, PROT_READ | PROT_EXEC);
+    Assert(!result && "mprotect failed!");
+}
+
+// File utilities
+MappedFile MapFileReadOnly(char* path)
+{
+    ProfileFunc(prof);
+    
+    MappedFile result = { 0 };
+    
+    int fd = open(path, O_RDONLY);
+    if(fd == -1) return result;
+    defer(close(fd));
+    
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) == -1) return result;
+    
+    // NOTE: The bytes after the end of the file in its last page
+    // are zero, but if the size is a multiple of the page size there
+    // are none. Reserving one extra (anonymous, zeroed) page and mapping
+    // the file over the start of it guarantees the terminator without
+    // ever copying the file.
+    size_t size = (size_t)fileStat.st_size;
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t mappedSize = (size + pageSize - 1) / pageSize * pageSize + pageSize;
+    
+    void* base = mmap(0, mappedSize, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, (off_t)0);
+    if(base == MAP_FAILED) return result;
+    
+    if(size > 0)
+    {
+        void* file = mmap(base, size, PROT_READ, MAP_PRIVATE | MAP_FIXED, fd, (off_t)0);
+        if(file == MAP_FAILED)
+        {
+            munmap(base, mappedSize);
+            return result;
+        }
+    }
+    
+    result.ptr = (char*)base;
+    result.size = size;
+    result.mappedSize = mappedSize;
+    return result;
+}
+
+MappedFile MapFileCopyOnWrite(char* path)
+{
+    ProfileFunc(prof);
+    
+    MappedFile result = { 0 };
+    
+    int fd = open(path, O_RDONLY);
+    if(fd == -1) return result;
+    defer(close(fd));
+    
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) == -1 || fileStat.st_size <= 0) return result;
+    
+    size_t size = (size_t)fileStat.st_size;
+    void* mem = mmap(0, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, (off_t)0);
+    if(mem == MAP_FAILED) return result;
+    
+    result.ptr = (char*)mem;
+    result.size = size;
+    result.mappedSize = size;
+    return result;
+}
+
+void UnmapFile(MappedFile file)
+{
+    if(!file.ptr) return;
+    
+    int result = munmap(file.ptr, file.mappedSize);
+    Assert(!result && "munmap failed!");
+}
+
+// Thread context
+static thread_local void* linuxThreadContext = 0;
+
+void SetThreadContext(void* ptr)
+{
+    linuxThreadContext = ptr;
+}
+
+void* GetThreadContext()
+{
+    return linuxThreadContext;
+}
+
+// Threads and synchronization
+struct Linux_ThreadStart
+{
+    OS_ThreadProc proc;
+    void* userData;
+};
+
+static void* Linux_ThreadEntry(void* arg)
+{
+    Linux_ThreadStart start = *(Linux_ThreadStart*)arg;
+    free(arg);
+    
+    start.proc(start.userData);
+    return 0;
+}
+
+void* OS_StartThread(OS_ThreadProc proc, void* userData)
+{
+    auto start = (Linux_ThreadStart*)malloc(sizeof(Linux_ThreadStart));
+    start->proc = proc;
+    start->userData = userData;
+    
+    pthread_t thread;
+    int result = pthread_create(&thread, 0, Linux_ThreadEntry, start);
+    Assert(!result && "pthread_create failed!");
+    if(result)
+    {
+        free(start);
+        return 0;
+    }
+    
+    return (void*)(uintptr)thread;
+}
+
+void OS_JoinThread(void* thread)
+{
+    pthread_join((pthread_t)(uintptr)thread, 0);
+}
+
+void OS_YieldThread()
+{
+    sched_yield();
+}
+
+uint32 OS_GetThreadId()
+{
+    return (uint32)syscall(SYS_gettid);
+}
+
+uint32 OS_GetProcessId()
+{
+    return (uint32)getpid();
+}
+
+int OS_GetNumLogicalCores()
+{
+    long result = sysconf(_SC_NPROCESSORS_ONLN);
+    return result > 0 ? (int)result : 1;
+}
+
+void* OS_CreateSemaphore()
+{
+    auto sem = (sem_t*)malloc(sizeof(sem_t));
+    int result = sem_init(sem, 0, 0);
+    Assert(!result && "sem_init failed!");
+    return sem;
+}
+
+void OS_FreeSemaphore(void* sem)
+{
+    sem_destroy((sem_t*)sem);
+    free(sem);
+}
+
+void OS_SignalSemaphore(void* sem, int count)
+{
+    for(int i = 0; i < count; ++i)
+        sem_post((sem_t*)sem);
+}
+
+void OS_WaitSemaphore(void* sem)
+{
+    while(sem_wait((sem_t*)sem) == -1 && errno == EINTR);
+}
+
+// Timing utilities
+uint64 GetMonotonicTimeNs()
+{
+    timespec time;
+    clock_gettime(CLOCK_MONOTONIC, &time);
+    return (uint64)time.tv_sec * 1000000000 + (uint64)time.tv_nsec;
+}
@@ -46,6 +46,14 @@ void* ReserveMemory(size_t size)
     return result;
 }
 
+void* ReserveMemoryHuge(size_t size)
+{
+    // NOTE: Large pages on Windows require the SeLockMemoryPrivilege
+    // and can't be reserved and committed separately, so this just falls
+    // back to regular pages.
+    return ReserveMemory(size);
+}
+
 void CommitMemory(void* mem, size_t size)
 {
     ProfileFunc(prof);
@@ -60,6 +68,126 @@ void FreeMemory(void* mem, size_t size)
     Assert(result && "VirtualFree failed!");
 }
 
+void DecommitMemory(void* mem, size_t size)
+{
+    bool result = VirtualFree(mem, size, MEM_DECOMMIT);
+    Assert(result && "VirtualFree failed!");
+}
+
+void ProtectMemoryExecutable(void* mem, size_t size)
+{
+    DWORD oldProtect;
+    bool result = VirtualProtect(mem, size, PAGE_EXECUTE_READ, &oldProtect);
+    Assert(result && "VirtualProtect failed!");
+    
+    FlushInstructionCache(GetCurrentProcess(), mem, size);
+}
+
+// File utilities
+MappedFile MapFileReadOnly(char* path)
+{
+    ProfileFunc(prof);
+    
+    MappedFile result = { 0 };
+    
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if(file == INVALID_HANDLE_VALUE) return result;
+    defer(CloseHandle(file));
+    
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(file, &fileSize)) return result;
+    size_t size = (size_t)fileSize.QuadPart;
+    
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    
+    // NOTE: The rest of the last page of a view is zero filled, so
+    // there's a terminator for free, unless the size is a multiple of the
+    // page size (empty files can't be mapped at all). Views can't be placed
+    // in front of a reserved page like on Linux, so in that case the file
+    // is just copied.
+    if(size % sysInfo.dwPageSize != 0)
+    {
+        HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+        if(mapping)
+        {
+            void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);  // The view keeps the mapping alive
+            
+            if(view)
+            {
+                result.ptr = (char*)view;
+                result.size = size;
+                result.mappedSize = size;
+                return result;
+            }
+        }
+    }
+    
+    char* copy = (char*)VirtualAlloc(0, size + 1, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if(!copy) return result;
+    
+    size_t read = 0;
+    while(read < size)
+    {
+        DWORD toRead = (DWORD)min(size - read, (size_t)GB(1));
+        DWORD numRead = 0;
+        if(!ReadFile(file, copy + read, toRead, &numRead, 0) || numRead == 0)
+        {
+            VirtualFree(copy, 0, MEM_RELEASE);
+            return result;
+        }
+        
+        read += numRead;
+    }
+    
+    copy[size] = 0;
+    result.ptr = copy;
+    result.size = size;
+    result.mappedSize = size + 1;
+    result.isCopy = true;
+    return result;
+}
+
+MappedFile MapFileCopyOnWrite(char* path)
+{
+    ProfileFunc(prof);
+    
+    MappedFile result = { 0 };
+    
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
+    if(file == INVALID_HANDLE_VALUE) return result;
+    defer(CloseHandle(file));
+    
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0) return result;
+    
+    HANDLE mapping = CreateFileMappingA(file, 0, PAGE_WRITECOPY, 0, 0, 0);
+    if(!mapping) return result;
+    
+    void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+    CloseHandle(mapping);  // The view keeps the mapping alive
+    if(!view) return result;
+    
+    result.ptr = (char*)view;
+    result.size = (size_t)fileSize.QuadPart;
+    result.mappedSize = result.size;
+    return result;
+}
+
+void UnmapFile(MappedFile file)
+{
+    if(!file.ptr) return;
+    
+    bool result;
+    if(file.isCopy)
+        result = VirtualFree(file.ptr, 0, MEM_RELEASE);
+    else
+        result = UnmapViewOfFile(file.ptr);
+    
+    Assert(result && "Failed to unmap file!");
+}
+
 // Thread context
 void SetThreadContext(void* ptr)
 {
@@ -73,6 +201,84 @@ void* GetThreadContext()
     return (void*)TlsGetValue(win32ThreadContextIdx);
 }
 
+// Threads and synchronization
+struct Win32_ThreadStart
+{
+    OS_ThreadProc proc;
+    void* userData;
+};
+
+static DWORD WINAPI Win32_ThreadEntry(LPVOID arg)
+{
+    Win32_ThreadStart start = *(Win32_ThreadStart*)arg;
+    free(arg);
+    
+    start.proc(start.userData);
+    return 0;
+}
+
+void* OS_StartThread(OS_ThreadProc proc, void* userData)
+{
+    auto start = (Win32_ThreadStart*)malloc(sizeof(Win32_ThreadStart));
+    start->proc = proc;
+    start->userData = userData;
+    
+    HANDLE thread = CreateThread(0, 0, Win32_ThreadEntry, start, 0, 0);
+    Assert(thread && "CreateThread failed!");
+    if(!thread) free(start);
+    return thread;
+}
+
+void OS_JoinThread(void* thread)
+{
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+void OS_YieldThread()
+{
+    SwitchToThread();
+}
+
+uint32 OS_GetThreadId()
+{
+    return (uint32)GetCurrentThreadId();
+}
+
+uint32 OS_GetProcessId()
+{
+    return (uint32)GetCurrentProcessId();
+}
+
+int OS_GetNumLogicalCores()
+{
+    SYSTEM_INFO sysInfo;
+    GetSystemInfo(&sysInfo);
+    return sysInfo.dwNumberOfProcessors > 0 ? (int)sysInfo.dwNumberOfProcessors : 1;
+}
+
+void* OS_CreateSemaphore()
+{
+    HANDLE sem = CreateSemaphoreA(0, 0, 0x7FFFFFFF, 0);
+    Assert(sem && "CreateSemaphore failed!");
+    return sem;
+}
+
+void OS_FreeSemaphore(void* sem)
+{
+    CloseHandle(sem);
+}
+
+void OS_SignalSemaphore(void* sem, int count)
+{
+    if(count > 0) ReleaseSemaphore(sem, count, 0);
+}
+
+void OS_WaitSemaphore(void* sem)
+{
+    WaitForSingleObject(sem, INFINITE);
+}
+
 // Timing and profiling utilities
 uint64 GetRdtscFreq()
 {
@@ -124,6 +330,21 @@ uint64 GetRdtscFreq()
     return tscFreq;
 }
 
+uint64 GetMonotonicTimeNs()
+{
+    static LARGE_INTEGER frequency = { 0 };
+    if(frequency.QuadPart == 0)
+        QueryPerformanceFrequency(&frequency);
+    
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    
+    // Split to avoid overflowing
+    uint64 freq  = (uint64)frequency.QuadPart;
+    uint64 ticks = (uint64)counter.QuadPart;
+    return ticks / freq * 1000000000 + ticks % freq * 1000000000 / freq;
+}
+
 void SetErrorColor()
 {
     assert(win32ConsoleScreenBufferInitted);
@@ -3,6 +3,8 @@
 #include "lexer.h"
 #include "memory_management.h"
 #include "dependency_graph.h"
+#include "compile_stats.h"
+#include "job_system.h"
 #include "parser.h"
 
 // @architecture Do we want to do a conversion between syntactic declarators
@@ -10,31 +12,92 @@
 // update: it seems that it is not needed, the structure is pretty much the same
 // anyways
 
+// Nodes made by the calling thread, summed up into
+// counters.astNodes by ParseFile (and by the parse jobs)
+static thread_local uint64 astNodesMade = 0;
+
+Ast_Pool astPools[Ast_NumPools];
+
+void Ast_InitPools()
+{
+    for(int i = 0; i < Ast_NumPools; ++i)
+    {
+        if(!astPools[i].base)
+            astPools[i].base = (char*)ReserveMemory(Ast_PoolReserveSize);
+    }
+}
+
+void Ast_ResetPools()
+{
+    for(int i = 0; i < Ast_NumPools; ++i)
+    {
+        if(astPools[i].base && astPools[i].numChunks > 0)
+            DecommitMemory(astPools[i].base, (size_t)astPools[i].numChunks * Ast_PoolChunkSize);
+        
+        astPools[i].numChunks = 0;
+    }
+}
+
+void* Ast_PoolAlloc(Ast_PoolCursor* cursor, Ast_PoolKind pool, size_t size)
+{
+    size = (size + Ast_PoolGranularity - 1) & ~(size_t)(Ast_PoolGranularity - 1);
+    Assert(size <= Ast_PoolChunkSize);
+    
+    if(cursor->at + size > cursor->end)
+    {
+        Ast_Pool* p = &astPools[pool];
+        uint32 chunkIdx = AtomicIncrement32(&p->numChunks) - 1;
+        if((uint64)(chunkIdx + 1) * Ast_PoolChunkSize > Ast_PoolReserveSize)
+        {
+            SetErrorColor();
+            fprintf(stderr, "Error");
+            ResetColor();
+            fprintf(stderr, ": Ran out of memory for the AST.\n");
+            exit(1);
+        }
+        
+        char* chunk = p->base + (uint64)chunkIdx * Ast_PoolChunkSize;
+        CommitMemory(chunk, Ast_PoolChunkSize);
+        
+        // Offset 0 is the null handle
+        cursor->at  = chunkIdx == 0 ? chunk + Ast_PoolGranularity : chunk;
+        cursor->end = chunk + Ast_PoolChunkSize;
+    }
+    
+    void* result = cursor->at;
+    cursor->at += size;
+    return result;
+}
+
 template<typename t>
-t* Ast_MakeNode(Arena* arena, Token* token)
+t* Ast_MakeNode(Parser* p, TokenIdx token)
 {
-    // Call the constructor for the node,
-    // Pack the nodes for better cache locality
-    t* result = Arena_AllocAndInitPack(arena, t);
+    // Call the constructor for the node, in
+    // the pool for its kind of node
+    const Ast_PoolKind pool = Ast_PoolOf((t*)0);
+    t* result = new (Ast_PoolAlloc(&p->pools[pool], pool, sizeof(t))) t;
     result->where = token;
+    ++astNodesMade;
     
     return result;
 }
 
-Ast_Node* Ast_MakeNode(Arena* arena, Token* token, Ast_NodeKind kind)
+Ast_Node* Ast_MakeNode(Parser* p, TokenIdx token, Ast_NodeKind kind)
 {
-    // Pack the nodes for better cache locality
-    auto result   = Arena_AllocAndInitPack(arena, Ast_Node);
+    Ast_PoolKind pool = Ast_PoolOfKind(kind);
+    auto result   = new (Ast_PoolAlloc(&p->pools[pool], pool, sizeof(Ast_Node))) Ast_Node;
     result->kind  = kind;
     result->where = token;
+    ++astNodesMade;
     
     return result;
 }
 
 template<typename t>
-t* Ast_MakeEntityNode(Parser* p, Token* token)
+t* Ast_MakeEntityNode(Parser* p, TokenIdx token)
 {
-    auto result   = Arena_AllocAndInitPack(p->arena, t);
+    const Ast_PoolKind pool = Ast_PoolOf((t*)0);
+    auto result   = new (Ast_PoolAlloc(&p->pools[pool], pool, sizeof(t))) t;
     result->where = token;
     
     Dg_NewNode(result, p->entityArena, &p->entities);
@@ -42,7 +105,7 @@ t* Ast_MakeEntityNode(Parser* p, Token* token)
 }
 
 template<typename t>
-t Ast_InitNode(Token* token)
+t Ast_InitNode(TokenIdx token)
 {
     t result;
     result.where = token;
@@ -61,14 +124,14 @@ void AddDeclToScope(Ast_Block* block, Ast_Declaration* decl)
         
         for_array(i, block->decls)
         {
-            block->declsTable.Add(block->decls[i]->name.hash, block->decls[i]);
+            block->declsTable.Add(block->decls[i]->name.atom, block->decls[i]);
         }
         
-        block->declsTable.Add(decl->name.hash, decl);
+        block->declsTable.Add(decl->name.atom, decl);
     }
     else if(block->flags & Block_UseHashTable)
     {
-        block->declsTable.Add(decl->name.hash, decl);
+        block->declsTable.Add(decl->name.atom, decl);
     }
     
     block->decls.Append(decl);
@@ -77,17 +140,38 @@ void AddDeclToScope(Ast_Block* block, Ast_Declaration* decl)
 Ast_FileScope* ParseFile(Parser* p)
 {
     ProfileFunc(prof);
-    ScratchArena scratch;
+    
+    Ast_InitPools();
     
     auto root = Arena_AllocAndInitPack(p->arena, Ast_FileScope);
     root->scope.enclosing = 0;
     p->fileScope = &root->scope;
+    
+    if(p->tokenizer->numTokens >= Parser_MinParallelTokens && jobSystem.numWorkers > 1)
+    {
+        if(ParseFileParallel(p, root))
+            return root;
+    }
+    
+    ScratchArena scratch;
+    
     p->scope = p->fileScope;
     defer(p->scope = p->scope->enclosing);
     
-    Slice<Ast_Node*> result = { 0, 0 };
-    p->at = p->tokenizer->tokens.ptr;
+    uint64 nodesStart = astNodesMade;
+    
+    ChunkedArray<Ast_Node*> nodes;
+    p->at = 1;  // Skip the null token
+    ParseTopLevelDecls(p, scratch, &nodes);
     
+    root->scope.stmts = nodes.CopyToArena(p->arena);
+    counters.astNodes += astNodesMade - nodesStart;
+    return root;
+}
+
+// Parses until the EOF token
+void ParseTopLevelDecls(Parser* p, Arena* nodesArena, ChunkedArray<Ast_Node*>* outNodes)
+{
     bool quit = false;
     while(!quit)
     {
@@ -95,7 +179,7 @@ Ast_FileScope* ParseFile(Parser* p)
         
         Ast_DeclSpec declSpecs = ParseDeclSpecs(p);
         
-        switch_nocheck(p->at->type)
+        switch_nocheck(TokType(p, p->at))
         {
             case ';':          ++p->at; break;
             case Tok_Proc:     node = ParseProc(p, declSpecs); break;
@@ -113,13 +197,199 @@ Ast_FileScope* ParseFile(Parser* p)
         } switch_nocheck_end;
         
         if(!quit && node)
-            result.Append(scratch.arena(), node);
+            outNodes->Append(nodesArena, node);
     }
+}
+
+// NOTE: This only needs to agree with ParseTopLevelDecls on where
+// declarations end for correct code. If it's wrong (e.g. an anonymous
+// struct as a return type) the job which got the broken range fails,
+// and the file is just parsed again sequentially.
+Slice<TokenIdx> ScanTopLevelDecls(Parser* p, Arena* arena)
+{
+    ProfileFunc(prof);
     
-    result = result.CopyToArena(p->arena);
+    Slice<TokenIdx> starts = { 0, 0 };
     
-    root->scope.stmts = result;
-    return root;
+    TokenIdx tok = 1;  // Skip the null token
+    while(TokType(p, tok) != Tok_EOF)
+    {
+        starts.Append(arena, tok);
+        
+        while(Ast_TokTypeToDeclSpec(TokType(p, tok)) != 0) ++tok;
+        
+        TokenType first = TokType(p, tok);
+        bool hasBody = first == Tok_Proc || first == Tok_Operator || first == Tok_Struct;
+        
+        int braceLevel = 0;
+        int parenLevel = 0;
+        bool endOfDecl = false;
+        while(!endOfDecl)
+        {
+            TokenType type = TokType(p, tok);
+            if(type == Tok_EOF)
+            {
+                if(braceLevel != 0) return { 0, 0 };
+                break;
+            }
+            
+            ++tok;
+            switch_nocheck(type)
+            {
+                case '(': ++parenLevel; break;
+                case ')': --parenLevel; break;
+                case '{': ++braceLevel; break;
+                case '}':
+                {
+                    --braceLevel;
+                    if(braceLevel < 0) return { 0, 0 };
+                    endOfDecl = braceLevel == 0 && parenLevel == 0 && hasBody;
+                    break;
+                }
+                case ';': endOfDecl = braceLevel == 0 && parenLevel == 0; break;
+            } switch_nocheck_end;
+        }
+    }
+    
+    starts.Append(arena, tok);
+    return starts;
+}
+
+// Returns false if the file has to be parsed sequentially instead,
+// e.g. if there were syntax errors (which are printed by that parse)
+bool ParseFileParallel(Parser* p, Ast_FileScope* root)
+{
+    ProfileFunc(prof);
+    ScratchArena scratch;
+    
+    Slice<TokenIdx> starts = ScanTopLevelDecls(p, scratch);
+    if(starts.length <= 2) return false;
+    
+    // Group contiguous declarations so that each job has a few
+    // times fewer tokens than a fair share, for load balancing
+    uint32 numTokens = p->tokenizer->numTokens;
+    uint32 tokensPerJob = max(numTokens / (jobSystem.numWorkers * 4), (uint32)Parser_MinTokensPerJob);
+    
+    Slice<Parser_Job> jobs = { 0, 0 };
+    TokenIdx jobStart = starts[0];
+    for(int i = 1; i < starts.length; ++i)
+    {
+        bool last = i == starts.length - 1;
+        if(starts[i] - jobStart >= tokensPerJob || last)
+        {
+            Parser_Job job = {};
+            job.mainParser = p;
+            job.start = jobStart;
+            job.end = starts[i];
+            jobs.Append(scratch, job);
+            jobStart = starts[i];
+        }
+    }
+    
+    if(jobs.length <= 1) return false;
+    
+    Job_Counter counter;
+    for_array(i, jobs)
+        Job_Submit(Parser_JobProc, &jobs[i], &counter);
+    Job_Wait(&counter);
+    
+    defer({
+              for_array(i, jobs)
+              {
+                  jobs[i].scope.decls.FreeAll();
+                  if(jobs[i].scope.flags & Block_UseHashTable)
+                      jobs[i].scope.declsTable.Free();
+              }
+          });
+    
+    for_array(i, jobs)
+    {
+        if(!jobs[i].status) return false;
+    }
+    
+    // Stitch the results together, in source order
+    int64 numEntities = 0;
+    int64 numNodes = 0;
+    for_array(i, jobs)
+    {
+        numEntities += jobs[i].entities.length;
+        numNodes += jobs[i].nodes.length;
+    }
+    
+    p->entities.ResizeAndInit(p->entityArena, (uint32)numEntities);
+    root->scope.stmts.ptr = Arena_AllocArrayPack(p->arena, numNodes, Ast_Node*);
+    root->scope.stmts.length = numNodes;
+    
+    int64 entityOffset = 0;
+    int64 nodeOffset = 0;
+    for_array(i, jobs)
+    {
+        Parser_Job& job = jobs[i];
+        for_array(j, job.entities)
+        {
+            Dg_Entity& entity = p->entities[entityOffset + j];
+            entity = job.entities[j];
+            entity.node->entityIdx = (Dg_Idx)(entityOffset + j);
+            
+            if(entity.node->kind == AstKind_ProcDef)
+            {
+                auto procDef = (Ast_ProcDef*)entity.node;
+                if(procDef->block.enclosing == &job.scope)
+                    procDef->block.enclosing = p->fileScope;
+            }
+        }
+        
+        for_array(j, job.scope.decls)
+            AddDeclToScope(p->fileScope, job.scope.decls[j]);
+        
+        memcpy(root->scope.stmts.ptr + nodeOffset, job.nodes.ptr, sizeof(Ast_Node*) * job.nodes.length);
+        
+        entityOffset += job.entities.length;
+        nodeOffset += job.nodes.length;
+        counters.astNodes += job.numAstNodes;
+    }
+    
+    return true;
+}
+
+void Parser_JobProc(void* userData)
+{
+    ProfileFunc(prof);
+    ScratchArena scratch;
+    
+    auto job = (Parser_Job*)userData;
+    Parser* mainParser = job->mainParser;
+    
+    // NOTE: The parser stops at EOF tokens, and it also overwrites the
+    // current token with EOF on errors, so each job gets its own copy of the
+    // token types of its range, terminated by EOF. It's indexed with the
+    // usual token indices, since those are stored in the AST, so the
+    // tokenizer gets a pointer to where token 0 would be.
+    // @UB This is technically UB, but most compilers handle it as expected.
+    uint32 rangeLength = job->end - job->start;
+    uint16* types = Arena_AllocArray(scratch, rangeLength + 1, uint16);
+    memcpy(types, mainParser->tokenizer->tokTypes + job->start, sizeof(uint16) * rangeLength);
+    types[rangeLength] = Tok_EOF;
+    
+    Tokenizer tokenizer = *mainParser->tokenizer;
+    tokenizer.tokTypes = types - job->start;
+    
+    Parser p = { Job_WorkerArena(Job_AstArena), &tokenizer };
+    p.entityArena = Job_WorkerArena(Job_EntityArena);
+    p.silent = true;
+    p.at = job->start;
+    p.fileScope = &job->scope;
+    p.scope = &job->scope;
+    
+    uint64 nodesStart = astNodesMade;
+    
+    ChunkedArray<Ast_Node*> nodes;
+    ParseTopLevelDecls(&p, scratch, &nodes);
+    
+    job->status = p.status;
+    job->nodes = nodes.CopyToArena(p.arena);
+    job->entities = p.entities;
+    job->numAstNodes = astNodesMade - nodesStart;
 }
 
 Ast_ProcDecl* ParseProc(Parser* p, Ast_DeclSpec specs)
@@ -127,28 +397,28 @@ Ast_ProcDecl* ParseProc(Parser* p, Ast_DeclSpec specs)
     ProfileFunc(prof);
     ScratchArena scratch;
     
-    bool isOperator = p->at->type == Tok_Operator;
+    bool isOperator = TokType(p, p->at) == Tok_Operator;
     
-    if(p->at->type != Tok_Proc && p->at->type != Tok_Operator)
+    if(TokType(p, p->at) != Tok_Proc && TokType(p, p->at) != Tok_Operator)
         ExpectedTokenError(p, p->at, Tok_Proc);
     
     auto procDecl = Ast_MakeEntityNode<Ast_ProcDecl>(p, p->at);
     procDecl->declSpecs = specs;
     
-    Token* ident = 0;
+    TokenIdx ident = 0;
     TypeInfo* typeInfo = ParseType(p, &ident);
     Assert(typeInfo->typeId == Typeid_Proc);
-    if(!isOperator && !IsTokIdent(ident->type))
+    if(!isOperator && !IsTokIdent(TokType(p, ident)))
         ExpectedTokenError(p, ident, Tok_Ident);
-    else if(isOperator && !IsTokOperator(ident->type))
+    else if(isOperator && !IsTokOperator(TokType(p, ident)))
         ParseError(p, ident, StrLit("Expecting operator"));
     
     procDecl->where = ident;
     procDecl->type = typeInfo;
-    procDecl->name = procDecl->where->ident;
+    procDecl->name = TokIdent(p, procDecl->where);
     AddDeclToScope(p->scope, procDecl);
     
-    if(p->at->type == ';')
+    if(TokType(p, p->at) == ';')
     {
         procDecl->declSpecs |= Decl_Extern;
         ++p->at;
@@ -159,9 +429,11 @@ Ast_ProcDecl* ParseProc(Parser* p, Ast_DeclSpec specs)
         procDef->decl = procDecl;
         auto procType = (Ast_ProcType*)typeInfo;
         
+        procDef->bodyStart = p->at;
+        
         // Special error for this token
         bool hasMultipleReturns = ((Ast_ProcType*)typeInfo)->retTypes.length > 1;
-        if(!hasMultipleReturns && p->at->type == ',')
+        if(!hasMultipleReturns && TokType(p, p->at) == ',')
             ParseError(p, p->at, StrLit("Multiple return values should be wrapped with '()' parentheses."));
         else
             EatRequiredToken(p, '{');
@@ -189,7 +461,7 @@ Ast_ProcDecl* ParseProc(Parser* p, Ast_DeclSpec specs)
         // TODO: ideally an error should be printed for this.
         procDecl->declSpecs &= ~Decl_Extern;
         
-        while(p->at->type != '}' && p->at->type != Tok_EOF)
+        while(TokType(p, p->at) != '}' && TokType(p, p->at) != Tok_EOF)
         {
             Ast_Stmt* stmt = ParseStatement(p);
             block.stmts.Append(scratch.arena(), (Ast_Node*)stmt);
@@ -207,20 +479,20 @@ Ast_StructDef* ParseStructDef(Parser* p, Ast_DeclSpec specs)
 {
     ProfileFunc(prof);
     
-    if(p->at->type != Tok_Struct)
+    if(TokType(p, p->at) != Tok_Struct)
         ExpectedTokenError(p, p->at, Tok_Struct);
     
     auto structDef = Ast_MakeEntityNode<Ast_StructDef>(p, p->at);
     structDef->declSpecs = specs;
     
-    Token* ident = 0;
+    TokenIdx ident = 0;
     TypeInfo* typeInfo = ParseType(p, &ident);
-    if(!IsTokIdent(ident->type))
+    if(!IsTokIdent(TokType(p, ident)))
         ExpectedTokenError(p, ident, Tok_Ident);
     
     structDef->where = ident;
     structDef->type = typeInfo;
-    structDef->name = ident->ident;
+    structDef->name = TokIdent(p, ident);
     AddDeclToScope(p->scope, structDef);
     return structDef;
 }
@@ -229,23 +501,23 @@ bool IsNextDecl(Parser* p)
 {
     bool isDecl = false;
     
-    if(IsTokStartOfDecl(p->at->type))
+    if(IsTokStartOfDecl(TokType(p, p->at)))
         isDecl = true;
     else
     {
         bool foundIdent = false;
-        for(Token* token = p->at; token->type != Tok_EOF; ++token)
+        for(TokenIdx token = p->at; TokType(p, token) != Tok_EOF; ++token)
         {
-            if(foundIdent && IsTokIdent(token->type))
+            if(foundIdent && IsTokIdent(TokType(p, token)))
             {
                 isDecl = true;
                 break;
             }
-            else if(IsTokIdent(token->type))
+            else if(IsTokIdent(TokType(p, token)))
             {
                 foundIdent = true;
                 // There could be polymorphic parameters here.
-                token = SkipParens(token + 1, '(', ')') - 1;
+                token = SkipParens(p, token + 1, '(', ')') - 1;
             }
             else break;
         }
@@ -258,7 +530,7 @@ Ast_Node* ParseDeclOrExpr(Parser* p, Ast_DeclSpec specs, bool forceInit, bool ig
 {
     ProfileFunc(prof);
     
-    Token* start = p->at;
+    TokenIdx start = p->at;
     
     // Determine if it's a declaration or an expression first
     // If there were some declaration specifiers then it's a
@@ -278,20 +550,20 @@ Ast_VarDecl* ParseVarDecl(Parser* p, Ast_DeclSpec specs, bool forceInit, bool ig
 {
     ProfileFunc(prof);
     
-    Token* typeTok = p->at;
+    TokenIdx typeTok = p->at;
     
-    Token* t = 0;
+    TokenIdx t = 0;
     auto type = ParseType(p, &t);
-    if(!IsTokIdent(t->type))
+    if(!IsTokIdent(TokType(p, t)))
         ExpectedTokenError(p, t, Tok_Ident);
     
     // A global variable should be its own separate entity
     bool isGlobal = !p->curProc;
-    auto decl  = isGlobal? Ast_MakeEntityNode<Ast_VarDecl>(p, t) : Ast_MakeNode<Ast_VarDecl>(p->arena, t);
+    auto decl  = isGlobal? Ast_MakeEntityNode<Ast_VarDecl>(p, t) : Ast_MakeNode<Ast_VarDecl>(p, t);
     decl->type = type;
     decl->typeTok = typeTok;
     decl->declSpecs = specs;
-    decl->name = t->ident;
+    decl->name = TokIdent(p, t);
     
     AddDeclToScope(p->scope, decl);
     
@@ -306,7 +578,7 @@ Ast_VarDecl* ParseVarDecl(Parser* p, Ast_DeclSpec specs, bool forceInit, bool ig
     
     if(!ignoreInit)
     {
-        if(forceInit || p->at->type == '=')
+        if(forceInit || TokType(p, p->at) == '=')
         {
             EatRequiredToken(p, '=');
             decl->initExpr = ParseExpression(p);
@@ -324,7 +596,7 @@ Ast_Stmt* ParseStatement(Parser* p)
     
     Ast_DeclSpec declSpecs = ParseDeclSpecs(p);
     
-    switch_nocheck(p->at->type)
+    switch_nocheck(TokType(p, p->at))
     {
         case Tok_EOF:         return 0;
         case Tok_If:          stmt = ParseIf(p); break;
@@ -340,20 +612,20 @@ Ast_Stmt* ParseStatement(Parser* p)
         case '{':             stmt = ParseBlock(p); break;
         case ';':
         {
-            stmt = Ast_MakeNode(p->arena, p->at, AstKind_EmptyStmt);
+            stmt = Ast_MakeNode(p, p->at, AstKind_EmptyStmt);
             ++p->at;
             break;
         }
         default:
         {
-            Token* start = p->at;
+            TokenIdx start = p->at;
             stmt = ParseDeclOrExpr(p, declSpecs, false, true);
             
-            if(p->at->type == ',')  // Multi assign
+            if(TokType(p, p->at) == ',')  // Multi assign
             {
                 ++p->at;
                 
-                auto multiAssign = Ast_MakeNode<Ast_MultiAssign>(p->arena, start);
+                auto multiAssign = Ast_MakeNode<Ast_MultiAssign>(p, start);
                 
                 ScratchArena scratch;
                 Slice<Ast_Node*> lefts = { 0, 0 };
@@ -371,13 +643,13 @@ Ast_Stmt* ParseStatement(Parser* p)
                     
                     lefts.Append(scratch, toAppend);
                     
-                    if(p->at->type == ',') ++p->at;
+                    if(TokType(p, p->at) == ',') ++p->at;
                     else break;
                 }
                 
                 multiAssign->lefts = lefts.CopyToArena(p->arena);
                 
-                if(p->at->type == '=')
+                if(TokType(p, p->at) == '=')
                 {
                     multiAssign->where = p->at;
                     ++p->at;
@@ -386,7 +658,7 @@ Ast_Stmt* ParseStatement(Parser* p)
                     {
                         rights.Append(scratch, ParseExpression(p));
                         
-                        if(p->at->type == ',') ++p->at;
+                        if(TokType(p, p->at) == ',') ++p->at;
                         else break;
                     }
                     
@@ -394,7 +666,7 @@ Ast_Stmt* ParseStatement(Parser* p)
                 }
                 
             }
-            else if(stmt->kind == AstKind_VarDecl && p->at->type == '=')  // Single initialization
+            else if(stmt->kind == AstKind_VarDecl && TokType(p, p->at) == '=')  // Single initialization
             {
                 ++p->at;
                 auto varDecl = (Ast_VarDecl*)stmt;
@@ -414,11 +686,11 @@ Ast_If* ParseIf(Parser* p)
 {
     ProfileFunc(prof);
     
-    auto stmt = Ast_MakeNode<Ast_If>(p->arena, p->at);
+    auto stmt = Ast_MakeNode<Ast_If>(p, p->at);
     
     EatRequiredToken(p, Tok_If);
     
-    stmt->thenBlock = Ast_MakeNode<Ast_Block>(p->arena, p->at);
+    stmt->thenBlock = Ast_MakeNode<Ast_Block>(p, p->at);
     stmt->thenBlock->enclosing = p->scope;
     p->scope = stmt->thenBlock;
     defer(p->scope = p->scope->enclosing);
@@ -430,7 +702,7 @@ Ast_If* ParseIf(Parser* p)
     
     ParseOneOrMoreStmtBlock(p, stmt->thenBlock);
     
-    if(p->at->type == Tok_Else)
+    if(TokType(p, p->at) == Tok_Else)
     {
         ++p->at;
         stmt->elseStmt = ParseStatement(p);
@@ -443,16 +715,16 @@ Ast_For* ParseFor(Parser* p)
 {
     ProfileFunc(prof);
     
-    auto stmt = Ast_MakeNode<Ast_For>(p->arena, p->at);
+    auto stmt = Ast_MakeNode<Ast_For>(p, p->at);
     EatRequiredToken(p, Tok_For);
     
-    stmt->body = Ast_MakeNode<Ast_Block>(p->arena, p->at);
+    stmt->body = Ast_MakeNode<Ast_Block>(p, p->at);
     stmt->body->enclosing = p->scope;
     p->scope = stmt->body;
     defer(p->scope = p->scope->enclosing);
     
     EatRequiredToken(p, '(');
-    if(p->at->type != ';')
+    if(TokType(p, p->at) != ';')
     {
         auto declSpecs = ParseDeclSpecs(p);
         stmt->initialization = ParseDeclOrExpr(p, declSpecs);
@@ -460,7 +732,7 @@ Ast_For* ParseFor(Parser* p)
     
     EatRequiredToken(p, ';');
     
-    if(p->at->type != ';')
+    if(TokType(p, p->at) != ';')
     {
         auto declSpecs = ParseDeclSpecs(p);
         stmt->condition = ParseDeclOrExpr(p, declSpecs, true);
@@ -468,7 +740,7 @@ Ast_For* ParseFor(Parser* p)
     
     EatRequiredToken(p, ';');
     
-    if(p->at->type != ')')
+    if(TokType(p, p->at) != ')')
         stmt->update = ParseExpression(p);
     
     EatRequiredToken(p, ')');
@@ -481,11 +753,11 @@ Ast_While* ParseWhile(Parser* p)
 {
     ProfileFunc(prof);
     
-    auto stmt = Ast_MakeNode<Ast_While>(p->arena, p->at);
+    auto stmt = Ast_MakeNode<Ast_While>(p, p->at);
     
     EatRequiredToken(p, Tok_While);
     
-    stmt->doBlock = Ast_MakeNode<Ast_Block>(p->arena, p->at);
+    stmt->doBlock = Ast_MakeNode<Ast_Block>(p, p->at);
     stmt->doBlock->enclosing = p->scope;
     p->scope = stmt->doBlock;
     defer(p->scope = p->scope->enclosing);
@@ -503,7 +775,7 @@ Ast_DoWhile* ParseDoWhile(Parser* p)
 {
     ProfileFunc(prof);
     
-    auto stmt = Ast_MakeNode<Ast_DoWhile>(p->arena, p->at);
+    auto stmt = Ast_MakeNode<Ast_DoWhile>(p, p->at);
     
     EatRequiredToken(p, Tok_Do);
     stmt->doStmt = ParseStatement(p);
@@ -523,7 +795,7 @@ Ast_Switch* ParseSwitch(Parser* p)
     ScratchArena caseScratch(0);
     ScratchArena stmtScratch(1);
     
-    auto stmt = Ast_MakeNode<Ast_Switch>(p->arena, p->at);
+    auto stmt = Ast_MakeNode<Ast_Switch>(p, p->at);
     
     EatRequiredToken(p, Tok_Switch);
     EatRequiredToken(p, '(');
@@ -532,9 +804,9 @@ Ast_Switch* ParseSwitch(Parser* p)
     
     EatRequiredToken(p, '{');
     
-    while(p->at->type == Tok_Case || p->at->type == Tok_Default)
+    while(TokType(p, p->at) == Tok_Case || TokType(p, p->at) == Tok_Default)
     {
-        if(p->at->type == Tok_Default)
+        if(TokType(p, p->at) == Tok_Default)
         {
             stmt->defaultIdx = stmt->cases.length;
             ++p->at;
@@ -561,7 +833,7 @@ Ast_Defer* ParseDefer(Parser* p)
 {
     ProfileFunc(prof);
     
-    auto stmt = Ast_MakeNode<Ast_Defer>(p->arena, p->at);
+    auto stmt = Ast_MakeNode<Ast_Defer>(p, p->at);
     EatRequiredToken(p, Tok_Defer);
     
     stmt->stmt = ParseStatement(p);
@@ -573,10 +845,10 @@ Ast_Return* ParseReturn(Parser* p)
     ProfileFunc(prof);
     ScratchArena scratch;
     
-    auto stmt = Ast_MakeNode<Ast_Return>(p->arena, p->at);
+    auto stmt = Ast_MakeNode<Ast_Return>(p, p->at);
     EatRequiredToken(p, Tok_Return);
     
-    if(p->at->type != ';')
+    if(TokType(p, p->at) != ';')
     {
         Slice<Ast_Expr*> exprs = { 0, 0 };
         while(true)
@@ -584,7 +856,7 @@ Ast_Return* ParseReturn(Parser* p)
             auto expr = ParseExpression(p);
             exprs.Append(scratch, expr);
             
-            if(p->at->type == ',') ++p->at;
+            if(TokType(p, p->at) == ',') ++p->at;
             else break;
         }
         
@@ -600,7 +872,7 @@ Ast_Stmt* ParseJump(Parser* p)
 {
     ProfileFunc(prof);
     
-    auto stmt = Ast_MakeNode<t>(p->arena, p->at);
+    auto stmt = Ast_MakeNode<t>(p, p->at);
     ++p->at;
     
     EatRequiredToken(p, ';');
@@ -613,14 +885,14 @@ Ast_Block* ParseBlock(Parser* p)
     
     ScratchArena scratch;
     
-    auto block = Ast_MakeNode<Ast_Block>(p->arena, p->at);
+    auto block = Ast_MakeNode<Ast_Block>(p, p->at);
     block->enclosing = p->scope;
     p->scope = block;
     defer(p->scope = p->scope->enclosing);
     
     EatRequiredToken(p, '{');
     
-    while(p->at->type != '}' && p->at->type != Tok_EOF)
+    while(TokType(p, p->at) != '}' && TokType(p, p->at) != Tok_EOF)
     {
         Ast_Node* stmt = ParseStatement(p);
         block->stmts.Append(scratch, stmt);
@@ -636,13 +908,13 @@ void ParseOneOrMoreStmtBlock(Parser* p, Ast_Block* outBlock)
 {
     ProfileFunc(prof);
     
-    if(p->at->type == '{')  // Multiple statements
+    if(TokType(p, p->at) == '{')  // Multiple statements
     {
         outBlock->where = p->at;
         ++p->at;
         
         ScratchArena scratch;
-        while(p->at->type != '}' && p->at->type != Tok_EOF)
+        while(TokType(p, p->at) != '}' && TokType(p, p->at) != Tok_EOF)
         {
             Ast_Node* stmt = ParseStatement(p);
             outBlock->stmts.Append(scratch.arena(), stmt);
@@ -671,17 +943,17 @@ Ast_Expr* ParseExpression(Parser* p, int prec, bool ignoreEqual)
     Ast_Expr* lhs = 0;
     
     // Prefix operators (basic linked-list construction)
-    Ast_Expr* prefixExpr = 0;
-    Ast_Expr** baseExpr = &prefixExpr;
-    while(IsOpPrefix(p->at->type))
+    Ast_ExprRef<Ast_Expr> prefixExpr = 0;
+    Ast_ExprRef<Ast_Expr>* baseExpr = &prefixExpr;
+    while(IsOpPrefix(TokType(p, p->at)))
     {
-        if(p->at->type == Tok_Cast)  // Typecast
+        if(TokType(p, p->at) == Tok_Cast)  // Typecast
         {
-            auto tmp = Ast_MakeNode<Ast_Typecast>(p->arena, p->at);
+            auto tmp = Ast_MakeNode<Ast_Typecast>(p, p->at);
             ++p->at;
             
             EatRequiredToken(p, '(');
-            Token* ident = 0;
+            TokenIdx ident = 0;
             tmp->type = ParseType(p, &ident);
             EatRequiredToken(p, ')');
             
@@ -690,8 +962,8 @@ Ast_Expr* ParseExpression(Parser* p, int prec, bool ignoreEqual)
         }
         else  // Other prefix operators
         {
-            auto tmp = Ast_MakeNode<Ast_UnaryExpr>(p->arena, p->at);
-            tmp->op = p->at->type;
+            auto tmp = Ast_MakeNode<Ast_UnaryExpr>(p, p->at);
+            tmp->op = TokType(p, p->at);
             tmp->isPostfix = false;
             
             *baseExpr = tmp;
@@ -714,21 +986,21 @@ Ast_Expr* ParseExpression(Parser* p, int prec, bool ignoreEqual)
     
     while(true)
     {
-        int opPrec = GetOperatorPrec(p->at->type);
+        int opPrec = GetOperatorPrec(TokType(p, p->at));
         
         bool undoRecurse = false;
         undoRecurse |= (opPrec == -1);
         undoRecurse |= (opPrec > prec);  // Is it's less important (=greater priority) don't recurse
-        undoRecurse |= (opPrec == prec && IsOperatorLToR(p->at->type));
-        undoRecurse |= (p->at->type == '=' && ignoreEqual);  // If we're supposed to ignore the equal sign, stop here
+        undoRecurse |= (opPrec == prec && IsOperatorLToR(TokType(p, p->at)));
+        undoRecurse |= (TokType(p, p->at) == '=' && ignoreEqual);  // If we're supposed to ignore the equal sign, stop here
         if(undoRecurse)
         {
             /* TODO: test this
-            if(p->at->type == '?')  // Ternary operator(s)
+            if(TokType(p, p->at) == '?')  // Ternary operator(s)
             {
                 ++p->at;
                 
-                auto ternary = Ast_MakeNode<Ast_TernaryExpr>(p->arena, p->at);
+                auto ternary = Ast_MakeNode<Ast_TernaryExpr>(p, p->at);
                 ternary->expr1 = lhs;
                 ternary->expr2 = ParseExpression(p);
                 EatRequiredToken(p, ':');
@@ -742,8 +1014,8 @@ Ast_Expr* ParseExpression(Parser* p, int prec, bool ignoreEqual)
         }
         
         // Recurse
-        auto binOp = Ast_MakeNode<Ast_BinaryExpr>(p->arena, p->at);
-        binOp->op = p->at->type;
+        auto binOp = Ast_MakeNode<Ast_BinaryExpr>(p, p->at);
+        binOp->op = TokType(p, p->at);
         binOp->lhs = lhs;
         ++p->at;
         
@@ -762,18 +1034,18 @@ Ast_Expr* ParsePostfixExpression(Parser* p)
     Ast_Expr* curExpr = ParsePrimaryExpression(p);
     
     ScratchArena scratch;
-    while(IsOpPostfix(p->at->type))
+    while(IsOpPostfix(TokType(p, p->at)))
     {
         scratch.Reset();
-        switch_nocheck(p->at->type)
+        switch_nocheck(TokType(p, p->at))
         {
             case '.':  // Member access
             {
-                auto memberAccess = Ast_MakeNode<Ast_MemberAccess>(p->arena, p->at);
+                auto memberAccess = Ast_MakeNode<Ast_MemberAccess>(p, p->at);
                 ++p->at;
                 
-                Token* ident = EatRequiredToken(p, Tok_Ident);
-                memberAccess->memberName = ident->ident;
+                TokenIdx ident = EatRequiredToken(p, Tok_Ident);
+                memberAccess->memberName = TokIdent(p, ident);
                 memberAccess->target = curExpr;
                 curExpr = memberAccess;
                 
@@ -781,10 +1053,10 @@ Ast_Expr* ParsePostfixExpression(Parser* p)
             }
             case '(':  // Function call
             {
-                auto call = Ast_MakeNode<Ast_FuncCall>(p->arena, p->at);
+                auto call = Ast_MakeNode<Ast_FuncCall>(p, p->at);
                 ++p->at;
                 
-                if(p->at->type != ')')
+                if(TokType(p, p->at) != ')')
                 {
                     // Parse arguments
                     while(true)
@@ -792,7 +1064,7 @@ Ast_Expr* ParsePostfixExpression(Parser* p)
                         auto argExpr = ParseExpression(p);
                         call->args.Append(scratch.arena(), argExpr);
                         
-                        if(p->at->type == ',') ++p->at;
+                        if(TokType(p, p->at) == ',') ++p->at;
                         else break;
                     }
                 }
@@ -807,7 +1079,7 @@ Ast_Expr* ParsePostfixExpression(Parser* p)
             }
             case '[':  // Subscript operator
             {
-                auto subscript = Ast_MakeNode<Ast_Subscript>(p->arena, p->at);
+                auto subscript = Ast_MakeNode<Ast_Subscript>(p, p->at);
                 ++p->at;
                 
                 subscript->idxExpr = ParseExpression(p);
@@ -819,8 +1091,8 @@ Ast_Expr* ParsePostfixExpression(Parser* p)
             }
             default:  // The rest of the post-fix unary operators
             {
-                auto unary = Ast_MakeNode<Ast_UnaryExpr>(p->arena, p->at);
-                unary->op = p->at->type;
+                auto unary = Ast_MakeNode<Ast_UnaryExpr>(p, p->at);
+                unary->op = TokType(p, p->at);
                 unary->isPostfix = true;
                 
                 unary->expr = curExpr;
@@ -840,59 +1112,62 @@ Ast_Expr* ParsePrimaryExpression(Parser* p)
     ProfileFunc(prof);
     ScratchArena scratch;
     
-    if(p->at->type == '(')  // Parenthesis expression
+    if(TokType(p, p->at) == '(')  // Parenthesis expression
     {
         ++p->at;
         auto primary = ParseExpression(p);
         EatRequiredToken(p, ')');
         return primary;
     }
-    else if(IsTokIdent(p->at->type))
+    else if(IsTokIdent(TokType(p, p->at)))
     {
-        auto ident = Ast_MakeNode<Ast_IdentExpr>(p->arena, p->at);
-        ident->name = p->at->ident;
+        auto ident = Ast_MakeNode<Ast_IdentExpr>(p, p->at);
+        ident->name = TokIdent(p, p->at);
         ++p->at;
         return ident;
     }
-    else if(p->at->type == Tok_IntNum)
+    else if(TokType(p, p->at) == Tok_IntNum)
     {
-        auto constExpr = Ast_MakeNode<Ast_ConstValue>(p->arena, p->at);
+        auto constExpr = Ast_MakeNode<Ast_ConstValue>(p, p->at);
         constExpr->type = &Typer_Int64;
-        constExpr->addr = Arena_FromStackPack(p->arena, p->at->intValue);
+        TokenLiteral literal = TokLiteral(p, p->at);
+        constExpr->addr = Arena_FromStackPack(p->arena, literal.intValue);
         
         ++p->at;
         return constExpr;
     }
-    else if(p->at->type == Tok_FloatNum)
+    else if(TokType(p, p->at) == Tok_FloatNum)
     {
-        auto constExpr = Ast_MakeNode<Ast_ConstValue>(p->arena, p->at);
+        auto constExpr = Ast_MakeNode<Ast_ConstValue>(p, p->at);
         constExpr->type = &Typer_Float;
-        constExpr->addr = Arena_FromStackPack(p->arena, p->at->floatValue);
+        TokenLiteral literal = TokLiteral(p, p->at);
+        constExpr->addr = Arena_FromStackPack(p->arena, literal.floatValue);
         
         ++p->at;
         return constExpr;
     }
-    else if(p->at->type == Tok_DoubleNum)
+    else if(TokType(p, p->at) == Tok_DoubleNum)
     {
-        auto constExpr = Ast_MakeNode<Ast_ConstValue>(p->arena, p->at);
+        auto constExpr = Ast_MakeNode<Ast_ConstValue>(p, p->at);
         constExpr->type = &Typer_Double;
-        constExpr->addr = Arena_FromStackPack(p->arena, p->at->doubleValue);
+        TokenLiteral literal = TokLiteral(p, p->at);
+        constExpr->addr = Arena_FromStackPack(p->arena, literal.doubleValue);
         
         ++p->at;
         return constExpr;
     }
-    else if(p->at->type == Tok_True || p->at->type == Tok_False)
+    else if(TokType(p, p->at) == Tok_True || TokType(p, p->at) == Tok_False)
     {
-        auto constExpr = Ast_MakeNode<Ast_ConstValue>(p->arena, p->at);
+        auto constExpr = Ast_MakeNode<Ast_ConstValue>(p, p->at);
         constExpr->type = &Typer_Bool;
-        bool val = p->at->type == Tok_True;
+        bool val = TokType(p, p->at) == Tok_True;
         constExpr->addr = Arena_FromStackPack(p->arena, val);
         
         ++p->at;
         return constExpr;
     }
     
-    String tokType = TokTypeToString(p->at->type, scratch.arena());
+    String tokType = TokTypeToString(TokType(p, p->at), scratch.arena());
     
     StringBuilder strBuilder(scratch);
     
@@ -904,7 +1179,7 @@ Ast_Expr* ParsePrimaryExpression(Parser* p)
     return 0;
 }
 
-TypeInfo* ParseType(Parser* p, Token** outIdent)
+TypeInfo* ParseType(Parser* p, TokenIdx* outIdent)
 {
     ProfileFunc(prof);
     ScratchArena scratch;
@@ -918,19 +1193,19 @@ TypeInfo* ParseType(Parser* p, Token** outIdent)
     bool loop = true;
     while(loop)
     {
-        if(IsTokIdent(p->at->type))
+        if(IsTokIdent(TokType(p, p->at)))
         {
-            if(p->at->type == Tok_Ident)  // Compound type
+            if(TokType(p, p->at) == Tok_Ident)  // Compound type
             {
                 auto tmp = Ast_MakeType<Ast_IdentType>(p->arena);
-                tmp->name = p->at->ident;
+                tmp->name = TokIdent(p, p->at);
                 *baseType = tmp;
                 
                 // TODO: polymorphic parameters
             }
             else  // Primitive type
             {
-                *baseType = TokToPrimitiveType(p->at->type);
+                *baseType = TokToPrimitiveType(TokType(p, p->at));
             }
             
             ++p->at;
@@ -938,7 +1213,7 @@ TypeInfo* ParseType(Parser* p, Token** outIdent)
             // Ident should be the last type declarator
             loop = false;
         }
-        else switch_nocheck(p->at->type)
+        else switch_nocheck(TokType(p, p->at))
         {
             case '^':
             {
@@ -965,7 +1240,7 @@ TypeInfo* ParseType(Parser* p, Token** outIdent)
             case Tok_Proc:
             case Tok_Operator:
             {
-                Token* ident = 0;
+                TokenIdx ident = 0;
                 Ast_ProcType decl = ParseProcType(p, &ident, false);
                 auto tmp = Arena_FromStackPack(p->arena, decl);
                 if(ident)
@@ -979,7 +1254,7 @@ TypeInfo* ParseType(Parser* p, Token** outIdent)
             }
             case Tok_Struct:
             {
-                Token* ident = 0;
+                TokenIdx ident = 0;
                 Ast_StructType decl = ParseStructType(p, &ident);
                 auto tmp = Arena_FromStackPack(p->arena, decl);
                 if(ident)
@@ -1011,13 +1286,13 @@ TypeInfo* ParseType(Parser* p, Token** outIdent)
     if(!(*outIdent))
     {
         *outIdent = p->at;
-        if(IsTokIdent(p->at->type)) ++p->at;
+        if(IsTokIdent(TokType(p, p->at))) ++p->at;
     }
     
     return type;
 }
 
-Ast_ProcType ParseProcType(Parser* p, Token** outIdent, bool forceArgNames)
+Ast_ProcType ParseProcType(Parser* p, TokenIdx* outIdent, bool forceArgNames)
 {
     ProfileFunc(prof);
     
@@ -1027,13 +1302,13 @@ Ast_ProcType ParseProcType(Parser* p, Token** outIdent, bool forceArgNames)
     *outIdent = 0;
     
     // It's a proc or an operator
-    bool isOperator = p->at->type == Tok_Operator;
+    bool isOperator = TokType(p, p->at) == Tok_Operator;
     
-    if(p->at->type == Tok_Proc || p->at->type == Tok_Operator)
+    if(TokType(p, p->at) == Tok_Proc || TokType(p, p->at) == Tok_Operator)
         ++p->at;
     else  // This in practice never happens
     {
-        String tokType = TokTypeToString(p->at->type, scratch.arena());
+        String tokType = TokTypeToString(TokType(p, p->at), scratch.arena());
         
         StringBuilder strBuilder(scratch);
         strBuilder.Append("Unexpected '");
@@ -1046,12 +1321,12 @@ Ast_ProcType ParseProcType(Parser* p, Token** outIdent, bool forceArgNames)
     
     *outIdent = p->at;  // It's set to the identifier or the operator if it's an operator declaration
     
-    if(!isOperator && IsTokIdent(p->at->type))
+    if(!isOperator && IsTokIdent(TokType(p, p->at)))
         ++p->at;
-    else if(isOperator && IsTokOperator(p->at->type))
+    else if(isOperator && IsTokOperator(TokType(p, p->at)))
         ++p->at;
     
-    if(IsTokIdent(p->at->type)) ++p->at;
+    if(IsTokIdent(TokType(p, p->at))) ++p->at;
     
     EatRequiredToken(p, '(');
     
@@ -1059,28 +1334,28 @@ Ast_ProcType ParseProcType(Parser* p, Token** outIdent, bool forceArgNames)
     decl.isOperator = isOperator;
     
     // Parse arguments
-    if(p->at->type != ')')
+    if(TokType(p, p->at) != ')')
     {
         Slice<Ast_Declaration*> args = { 0, 0 };
         while(true)
         {
             Ast_DeclSpec specs = ParseDeclSpecs(p);
             
-            Token* t = 0;
+            TokenIdx t = 0;
             auto type = ParseType(p, &t);
-            if(!IsTokIdent(t->type))
+            if(!IsTokIdent(TokType(p, t)))
                 ExpectedTokenError(p, t, Tok_Ident);
             
             //auto argDecl = ParseVarDecl(p, (Ast_DeclSpec)0, false, true);
-            auto argDecl = Ast_MakeNode<Ast_VarDecl>(p->arena, t);
+            auto argDecl = Ast_MakeNode<Ast_VarDecl>(p, t);
             argDecl->type = type;
             argDecl->declSpecs = specs;
-            argDecl->name = t->ident;
+            argDecl->name = TokIdent(p, t);
             
             args.Append(scratch, argDecl);
             argDecl->declIdx = args.length - 1;
             
-            if(p->at->type == ',') ++p->at;
+            if(TokType(p, p->at) == ',') ++p->at;
             else break;
         }
         
@@ -1091,12 +1366,12 @@ Ast_ProcType ParseProcType(Parser* p, Token** outIdent, bool forceArgNames)
     EatRequiredToken(p, ')');
     
     // Parse return types
-    if(p->at->type == Tok_Arrow)  // There is at least one return type
+    if(TokType(p, p->at) == Tok_Arrow)  // There is at least one return type
     {
         ++p->at;
-        if(p->at->type != '(')
+        if(TokType(p, p->at) != '(')
         {
-            Token* token = 0;
+            TokenIdx token = 0;
             TypeInfo* type = ParseType(p, &token);
             
             decl.retTypes.length = 1;
@@ -1108,12 +1383,12 @@ Ast_ProcType ParseProcType(Parser* p, Token** outIdent, bool forceArgNames)
             
             while(true)
             {
-                Token* token = 0;
+                TokenIdx token = 0;
                 TypeInfo* type = ParseType(p, &token);
                 
                 decl.retTypes.Append(scratch.arena(), type);
                 
-                if(p->at->type == ',') ++p->at;
+                if(TokType(p, p->at) == ',') ++p->at;
                 else break;
             }
             
@@ -1125,7 +1400,7 @@ Ast_ProcType ParseProcType(Parser* p, Token** outIdent, bool forceArgNames)
     return decl;
 }
 
-Ast_StructType ParseStructType(Parser* p, Token** outIdent)
+Ast_StructType ParseStructType(Parser* p, TokenIdx* outIdent)
 {
     ProfileFunc(prof);
     
@@ -1137,11 +1412,11 @@ Ast_StructType ParseStructType(Parser* p, Token** outIdent)
     Ast_StructType decl;
     
     *outIdent = p->at;
-    if(IsTokIdent(p->at->type)) ++p->at;
+    if(IsTokIdent(TokType(p, p->at))) ++p->at;
     
     EatRequiredToken(p, '{');
     
-    if(p->at->type == '}')
+    if(TokType(p, p->at) == '}')
     {
         ++p->at;
         return decl;
@@ -1152,19 +1427,19 @@ Ast_StructType ParseStructType(Parser* p, Token** outIdent)
     ScratchArena tokenScratch(1);
     
     Slice<TypeInfo*> types = { 0, 0 };
-    Slice<Token*> tokens = { 0, 0 };
+    Slice<TokenIdx> tokens = { 0, 0 };
     
-    while(p->at->type != '}' && p->at->type != Tok_EOF)
+    while(TokType(p, p->at) != '}' && TokType(p, p->at) != Tok_EOF)
     {
-        if(p->at->type == ';')
+        if(TokType(p, p->at) == ';')
         {
             ++p->at;
             continue;
         }
         
-        Token* argName = 0;
+        TokenIdx argName = 0;
         TypeInfo* type = ParseType(p, &argName);
-        if(!IsTokIdent(argName->type))
+        if(!IsTokIdent(TokType(p, argName)))
             ExpectedTokenError(p, argName, Tok_Ident);
         
         types.Append(typeScratch.arena(), type);
@@ -1176,17 +1451,17 @@ Ast_StructType ParseStructType(Parser* p, Token** outIdent)
     decl.memberTypes      = types.CopyToArena(p->arena);
     decl.memberNameTokens = tokens.CopyToArena(p->arena);
     
-    decl.memberNames.ptr    = Arena_AllocArrayPack(p->arena, tokens.length, HashedString);
+    decl.memberNames.ptr    = Arena_AllocArrayPack(p->arena, tokens.length, InternedString);
     decl.memberNames.length = tokens.length;
     
     decl.memberOffsets.ptr    = Arena_AllocArrayPack(p->arena, types.length, uint32);
     decl.memberOffsets.length = types.length;
     
     //for_array(i, decl.memberNames)
-    //decl.memberNames[i] = decl.memberNameTokens[i]->ident;
+    //decl.memberNames[i] = TokIdent(p, decl.memberNameTokens[i]);
     
     for_array(i, decl.memberNames)
-        decl.memberNames[i] = decl.memberNameTokens[i]->ident; 
+        decl.memberNames[i] = TokIdent(p, decl.memberNameTokens[i]); 
     
     EatRequiredToken(p, '}');
     return decl;
@@ -1198,7 +1473,7 @@ Ast_DeclSpec ParseDeclSpecs(Parser* p)
     
     while(true)
     {
-        Ast_DeclSpec spec = Ast_TokTypeToDeclSpec(p->at->type);
+        Ast_DeclSpec spec = Ast_TokTypeToDeclSpec(TokType(p, p->at));
         if(spec == 0)
             break;
         
@@ -1358,40 +1633,40 @@ bool IsOperatorLToR(TokenType tokType)
 // TODO: This is pretty bad, if closeParen is missing then the
 // whole file is scanned. (not that big of a deal for now, compilation
 // will be way faster with syntax errors anyway)
-Token* SkipParens(Token* start, char openParen, char closeParen)
+TokenIdx SkipParens(Parser* p, TokenIdx start, char openParen, char closeParen)
 {
     ProfileFunc(prof);
     
     int parenLevel = 0;
-    if(start->type == openParen)
+    if(TokType(p, start) == openParen)
         ++parenLevel;
     
-    Token* result = start;
-    while(parenLevel > 0 && result->type != Tok_EOF)
+    TokenIdx result = start;
+    while(parenLevel > 0 && TokType(p, result) != Tok_EOF)
     {
         ++result;
         
-        if(result->type == openParen)
+        if(TokType(p, result) == openParen)
             ++parenLevel;
-        else if(result->type == closeParen)
+        else if(TokType(p, result) == closeParen)
             --parenLevel;
     }
     
     return result;
 }
 
-inline void ParseError(Parser* p, Token* token, String message)
+inline void ParseError(Parser* p, TokenIdx token, String message)
 {
-    if(p->status)
+    if(p->status && !p->silent)
         CompileError(p->tokenizer, token, message);
     
-    p->status   = false;
-    p->at->type = Tok_EOF;
+    p->status = false;
+    p->tokenizer->tokTypes[p->at] = Tok_EOF;
 }
 
-inline Token* EatRequiredToken(Parser* p, TokenType tokType)
+inline TokenIdx EatRequiredToken(Parser* p, TokenType tokType)
 {
-    if(p->at->type != tokType && !(IsTokIdent(p->at->type) && IsTokIdent(tokType)))
+    if(TokType(p, p->at) != tokType && !(IsTokIdent(TokType(p, p->at)) && IsTokIdent(tokType)))
     {
         ExpectedTokenError(p, tokType);
         return p->at;
@@ -1400,12 +1675,12 @@ inline Token* EatRequiredToken(Parser* p, TokenType tokType)
     return p->at++;
 }
 
-inline Token* EatRequiredToken(Parser* p, char tokType)
+inline TokenIdx EatRequiredToken(Parser* p, char tokType)
 {
     return EatRequiredToken(p, (TokenType)tokType);
 }
 
-inline void ExpectedTokenError(Parser* p, Token* tok, TokenType tokType)
+inline void ExpectedTokenError(Parser* p, TokenIdx tok, TokenType tokType)
 {
     if(IsTokIdent(tokType))
         ParseError(p, tok, StrLit("Expecting identifier"));
@@ -1425,7 +1700,7 @@ inline void ExpectedTokenError(Parser* p, TokenType tokType)
     ExpectedTokenError(p, p->at, tokType);
 }
 
-inline void ExpectedTokenError(Parser* p, Token* tok, char tokType)
+inline void ExpectedTokenError(Parser* p, TokenIdx tok, char tokType)
 {
     ExpectedTokenError(p, tok, (TokenType)tokType);
 }
@@ -6,9 +6,11 @@
 
 struct Parser
 {
-    Arena* arena; // Ast storage
+    Arena* arena; // Types and other data referenced by the AST
     Tokenizer* tokenizer;
-    Token* at;  // Current analyzed token in the stream
+    TokenIdx at;  // Current analyzed token in the stream
+    
+    Ast_PoolCursor pools[Ast_NumPools];  // Ast nodes
     
     Ast_Block* scope = 0;  // Current scope
     Ast_Block* fileScope = 0;
@@ -19,14 +21,51 @@ struct Parser
     
     // False if in error mode
     bool status = true;
+    // Errors are not printed. Used by the jobs of the parallel
+    // parse, the whole file is parsed again if any of them fails
+    bool silent = false;
+};
+
+// NOTE: Big files are parsed in parallel. A cheap scan over the
+// token types finds where each top-level declaration ends (by matching
+// braces), then contiguous groups of declarations are parsed by jobs into
+// the workers' arenas. The results are stitched together in source order,
+// so the top-level statements, the file scope and the entity indices are
+// exactly the same as the ones of a sequential parse.
+#define Parser_MinParallelTokens 65536  // Smaller files are parsed sequentially
+#define Parser_MinTokensPerJob   8192
+
+struct Parser_Job
+{
+    Parser* mainParser;
+    TokenIdx start;
+    TokenIdx end;  // Exclusive
+    
+    // Results
+    bool status;
+    Slice<Ast_Node*> nodes;
+    Slice<Dg_Entity> entities;
+    Ast_Block scope;  // Top-level declarations, moved to the file scope
+    uint64 numAstNodes;
 };
 
+// Token accessors, for brevity
+cforceinline TokenType TokType(Parser* p, TokenIdx tok) { return TokType(p->tokenizer, tok); }
+cforceinline InternedString TokIdent(Parser* p, TokenIdx tok) { return TokIdent(p->tokenizer, tok); }
+cforceinline TokenLiteral TokLiteral(Parser* p, TokenIdx tok) { return TokLiteral(p->tokenizer, tok); }
+
 template<typename t>
-t* Ast_MakeEntityNode(Parser* p, Token* token);
+t* Ast_MakeEntityNode(Parser* p, TokenIdx token);
 
 void AddDeclToScope(Ast_Block* block, Ast_Declaration* decl);
 
 Ast_FileScope* ParseFile(Parser* p);
+void ParseTopLevelDecls(Parser* p, Arena* nodesArena, ChunkedArray<Ast_Node*>* outNodes);
+// Returns the first token of each top-level declaration, followed by
+// the EOF token. Returns an empty slice if the braces don't match
+Slice<TokenIdx> ScanTopLevelDecls(Parser* p, Arena* arena);
+bool ParseFileParallel(Parser* p, Ast_FileScope* root);
+void Parser_JobProc(void* userData);
 Ast_ProcDecl* ParseProc(Parser* p, Ast_DeclSpec specs);
 Ast_StructDef* ParseStructDef(Parser* p, Ast_DeclSpec specs);
 Ast_Node* ParseDeclOrExpr(Parser* p, Ast_DeclSpec specs, bool forceInit = false, bool ignoreInit = false);
@@ -46,10 +85,10 @@ void ParseOneOrMoreStmtBlock(Parser* p, Ast_Block* outBlock);  // Used for block
 Ast_Expr* ParseExpression(Parser* p, int prec = INT_MAX, bool ignoreEqual = false);
 Ast_Expr* ParsePostfixExpression(Parser* p);
 Ast_Expr* ParsePrimaryExpression(Parser* p);
-TypeInfo* ParseType(Parser* p, Token** outIdent);
+TypeInfo* ParseType(Parser* p, TokenIdx* outIdent);
 // Do I even need these to be values and not pointers anymore?
-Ast_ProcType ParseProcType(Parser* p, Token** outIdent, bool forceArgNames = true);
-Ast_StructType ParseStructType(Parser* p, Token** outIdent);
+Ast_ProcType ParseProcType(Parser* p, TokenIdx* outIdent, bool forceArgNames = true);
+Ast_StructType ParseStructType(Parser* p, TokenIdx* outIdent);
 Ast_DeclSpec ParseDeclSpecs(Parser* p);
 void CheckDeclSpecs(Parser* p, Ast_DeclSpec specs, Ast_DeclSpec allowedSpecs);
 
@@ -75,16 +114,16 @@ bool IsOperatorLToR(TokenType tokType);
 bool IsTokOperator(TokenType tokType);
 
 // Also skips nested parentheses
-Token* SkipParens(Token* start, char openParen, char closeParen);
+TokenIdx SkipParens(Parser* p, TokenIdx start, char openParen, char closeParen);
 
-inline void ParseError(Parser* p, Token* token, String message);
-inline void ParseError(Parser* p, Token* token, int numStrings, char* message1, ...);
-inline void ParseError(Parser* p, Token* token, char* message);
+inline void ParseError(Parser* p, TokenIdx token, String message);
+inline void ParseError(Parser* p, TokenIdx token, int numStrings, char* message1, ...);
+inline void ParseError(Parser* p, TokenIdx token, char* message);
 
-inline Token* EatRequiredToken(Parser* p, TokenType tokType);
-inline Token* EatRequiredToken(Parser* p, char tokType);
+inline TokenIdx EatRequiredToken(Parser* p, TokenType tokType);
+inline TokenIdx EatRequiredToken(Parser* p, char tokType);
 
 inline void ExpectedTokenError(Parser* p, TokenType tokType);
 inline void ExpectedTokenError(Parser* p, char tokType);
-inline void ExpectedTokenError(Parser* p, Token* tok, TokenType tokType);
-inline void ExpectedTokenError(Parser* p, Token* tok, char tokType);
+inline void ExpectedTokenError(Parser* p, TokenIdx tok, TokenType tokType);
+inline void ExpectedTokenError(Parser* p, TokenIdx tok, char tokType);
@@ -0,0 +1,368 @@
+
+#include "perf_regress.h"
+#include "memory_management.h"
+#include "os/os_agnostic.h"
+#include "lexer.h"
+#include "parser.h"
+#include "dependency_graph.h"
+#include "interpreter.h"
+#include "tilde_codegen.h"
+#include "corpus_gen.h"
+#include "job_system.h"
+#include "compile_stats.h"
+
+#include <math.h>
+
+bool Perf_RunAll(Slice<char*> srcFiles, char* baselinePath, int numRuns, bool update)
+{
+    Arena arena = Arena_VirtualMemInit(GB(4), MB(2));
+    defer(Arena_Free(&arena));
+    
+    bool found = false;
+    Slice<Perf_Entry> baseline = Perf_ReadBaseline(&arena, baselinePath, &found);
+    
+    bool status = true;
+    // The names and the generated source are allocated in
+    // the same arena, so the results can't be a plain slice
+    ArenaArray<Perf_Entry> results;
+    
+    for(int i = 0; i < srcFiles.length; ++i)
+    {
+        MappedFile file = MapFileReadOnly(srcFiles[i]);
+        if(!file.ptr)
+        {
+            SetErrorColor();
+            fprintf(stderr, "Error");
+            ResetColor();
+            fprintf(stderr, ": Could not find the file %s.\n", srcFiles[i]);
+            status = false;
+            continue;
+        }
+        
+        // NOTE: Not unmapped, the atoms of the identifiers
+        // point into the file contents (see atom.h)
+        Perf_Entry entry = {};
+        entry.input = { srcFiles[i], (int64)strlen(srcFiles[i]) };
+        if(Perf_Measure(entry.input, { file.ptr, (int64)file.size }, numRuns, &entry.stats))
+            results.Append(&arena, entry);
+        else
+            status = false;
+    }
+    
+    // The generated program doesn't depend on the files which happen
+    // to be in the test folders, so it's always part of the run
+    {
+        const int scale = 1;
+        char* name = Arena_AllocArray(&arena, 32, char);
+        snprintf(name, 32, "corpus:%d", scale);
+        
+        Perf_Entry entry = {};
+        entry.input = { name, (int64)strlen(name) };
+        String src = Corpus_Generate(&arena, Corpus_DefaultParams(scale));
+        if(Perf_Measure(entry.input, src, numRuns, &entry.stats))
+            results.Append(&arena, entry);
+        else
+            status = false;
+    }
+    
+    if(!found || update)
+    {
+        if(!Perf_WriteBaseline(baselinePath, results))
+        {
+            SetErrorColor();
+            fprintf(stderr, "Error");
+            ResetColor();
+            fprintf(stderr, ": Could not write to the file %s.\n", baselinePath);
+            return false;
+        }
+        
+        printf("Wrote the baseline to %s (%lld inputs, %d runs each).\n", baselinePath, (long long)results.length, numRuns);
+        return status;
+    }
+    
+    printf("%-28s %-13s %12s %12s %12s %8s\n", "Input", "Phase", "Baseline", "Current", "Noise", "Change");
+    for_array(i, results)
+    {
+        Perf_Entry* base = 0;
+        for_array(j, baseline)
+        {
+            if(baseline[j].input == results[i].input)
+            {
+                base = &baseline[j];
+                break;
+            }
+        }
+        
+        if(!base)
+        {
+            printf("%-28.*s (not in the baseline, skipped)\n", (int)results[i].input.length, results[i].input.ptr);
+            continue;
+        }
+        
+        status &= Perf_Compare(base, &results[i].stats);
+    }
+    
+    if(status)
+        printf("No performance regressions.\n");
+    else
+        printf("There were performance regressions!\n");
+    
+    return status;
+}
+
+bool Perf_Measure(String input, String src, int numRuns, Perf_Stats* outStats)
+{
+    ScratchArena scratch;
+    
+    numRuns = max(numRuns, 1);
+    
+    double* samples[Perf_NumPhases];
+    for(int p = 0; p < Perf_NumPhases; ++p)
+        samples[p] = Arena_AllocArray(scratch, numRuns, double);
+    
+    printf("Measuring %.*s (%d runs)...\n", (int)input.length, input.ptr, numRuns);
+    
+    // NOTE: The first run is discarded, it pays for
+    // the page faults of the arenas and for cold caches
+    for(int run = -1; run < numRuns; ++run)
+    {
+        if(!Perf_Compile(src, input))
+        {
+            SetErrorColor();
+            fprintf(stderr, "Error");
+            ResetColor();
+            fprintf(stderr, ": %.*s did not compile.\n", (int)input.length, input.ptr);
+            return false;
+        }
+        
+        if(run < 0) continue;
+        
+        double phases[Perf_NumPhases];
+        phases[Perf_Lex]         = timings.lex;
+        phases[Perf_Parse]       = timings.parse;
+        phases[Perf_Typecheck]   = timings.phases[CompPhase_Typecheck];
+        phases[Perf_ComputeSize] = timings.phases[CompPhase_ComputeSize];
+        phases[Perf_Bytecode]    = timings.phases[CompPhase_Bytecode];
+        phases[Perf_IrGen]       = timings.irGen;
+        phases[Perf_Backend]     = timings.backend;
+        phases[Perf_Total]       = timings.frontend + timings.irGen + timings.backend;
+        
+        for(int p = 0; p < Perf_NumPhases; ++p)
+            samples[p][run] = phases[p] * 1e9;
+    }
+    
+    double* deviations = Arena_AllocArray(scratch, numRuns, double);
+    for(int p = 0; p < Perf_NumPhases; ++p)
+    {
+        double median = Perf_Median(samples[p], numRuns);
+        for(int run = 0; run < numRuns; ++run)
+            deviations[run] = fabs(samples[p][run] - median);
+        
+        outStats->median[p] = median;
+        outStats->mad[p] = Perf_Median(deviations, numRuns);
+    }
+    
+    return true;
+}
+
+// NOTE: The MAD is scaled to be comparable with a standard deviation
+// (for normally distributed timings), and the noise of the difference of
+// the two medians is estimated from both of them. Timings are rarely
+// normally distributed (there's a long tail of slow runs), which is
+// why medians are used in the first place, so this is only a heuristic.
+bool Perf_Compare(Perf_Entry* baseline, Perf_Stats* current)
+{
+    const double madToStdDev = 1.4826;
+    
+    bool status = true;
+    for(int p = 0; p < Perf_NumPhases; ++p)
+    {
+        double base = baseline->stats.median[p];
+        double cur  = current->median[p];
+        double madBase = baseline->stats.mad[p] * madToStdDev;
+        double madCur  = current->mad[p] * madToStdDev;
+        double noise = Perf_NumMads * sqrt(madBase * madBase + madCur * madCur);
+        
+        double threshold = max(noise, max(base * Perf_MinSlowdownRatio, (double)Perf_MinSlowdownNs));
+        bool regressed = cur - base > threshold;
+        status &= !regressed;
+        
+        double change = base > 0 ? (cur - base) / base * 100.0 : 0.0;
+        const double msPerNs = 1.0 / 1000000.0;
+        printf("%-28.*s %-13s %10.3fms %10.3fms %10.3fms %+7.1f%%",
+               (int)baseline->input.length, baseline->input.ptr, Perf_PhaseName((Perf_Phase)p),
+               base * msPerNs, cur * msPerNs, noise * msPerNs, change);
+        
+        if(regressed)
+        {
+            SetErrorColor();
+            printf("  SLOWER");
+            ResetColor();
+        }
+        
+        printf("\n");
+    }
+    
+    return status;
+}
+
+bool Perf_Compile(String src, String path)
+{
+    ProfileFunc(prof);
+    
+    Arena astArena = Arena_VirtualMemInit(GB(1), MB(2));
+    Arena internArena = Arena_VirtualMemInit(GB(1), MB(2));
+    Arena entityArena = Arena_VirtualMemInit(GB(1), MB(2));
+    defer({
+              Arena_Free(&astArena);
+              Arena_Free(&internArena);
+              Arena_Free(&entityArena);
+              
+              // Big files are parsed into the workers' arenas
+              Job_ResetWorkerArenas();
+              Ast_ResetPools();
+          });
+    
+    timings  = {};
+    counters = {};
+    uint64 frontendStart = GetMonotonicTimeNs();
+    
+    Tokenizer tokenizer = InitTokenizer(&astArena, &internArena, src.ptr, path);
+    Parser parser = { &astArena, &tokenizer };
+    parser.entityArena = &entityArena;
+    
+    uint64 lexStart = GetMonotonicTimeNs();
+    LexFile(&tokenizer);
+    timings.lex += SecondsSince(lexStart);
+    counters.tokens += tokenizer.numTokens;
+    
+    uint64 parseStart = GetMonotonicTimeNs();
+    Ast_FileScope* fileAst = ParseFile(&parser);
+    timings.parse += SecondsSince(parseStart);
+    counters.entities += parser.entities.length;
+    
+    if(!parser.status) return false;
+    
+    Interp interp;
+    bool status = MainDriver(&parser, &interp, fileAst);
+    timings.frontend += SecondsSince(frontendStart);
+    if(!status) return false;
+    
+    Tc_CodegenAndLink(fileAst, &interp, { 0, 0 }, false);
+    return true;
+}
+
+Slice<Perf_Entry> Perf_ReadBaseline(Arena* arena, char* path, bool* outFound)
+{
+    ArenaArray<Perf_Entry> entries;
+    
+    FILE* file = fopen(path, "rb");
+    *outFound = file != 0;
+    if(!file) return entries;
+    defer(fclose(file));
+    
+    char line[1024];
+    char input[512];
+    char phaseName[64];
+    while(fgets(line, sizeof(line), file))
+    {
+        if(line[0] == '#' || line[0] == '\n' || line[0] == '\r') continue;
+        
+        double median = 0, mad = 0;
+        if(sscanf(line, "%511s %63s %lf %lf", input, phaseName, &median, &mad) != 4) continue;
+        
+        int phase = -1;
+        for(int p = 0; p < Perf_NumPhases; ++p)
+        {
+            if(strcmp(phaseName, Perf_PhaseName((Perf_Phase)p)) == 0)
+            {
+                phase = p;
+                break;
+            }
+        }
+        
+        // Phases which don't exist anymore are ignored
+        if(phase == -1) continue;
+        
+        String inputStr = { input, (int64)strlen(input) };
+        Perf_Entry* entry = 0;
+        for_array(i, entries)
+        {
+            if(entries[i].input == inputStr)
+            {
+                entry = &entries[i];
+                break;
+            }
+        }
+        
+        if(!entry)
+        {
+            Perf_Entry newEntry = {};
+            newEntry.input.ptr = (char*)Arena_AllocAndCopy(arena, input, inputStr.length + 1);
+            newEntry.input.length = inputStr.length;
+            entries.Append(arena, newEntry);
+            entry = &entries[entries.length - 1];
+        }
+        
+        entry->stats.median[phase] = median;
+        entry->stats.mad[phase] = mad;
+    }
+    
+    return entries;
+}
+
+bool Perf_WriteBaseline(char* path, Slice<Perf_Entry> entries)
+{
+    FILE* file = fopen(path, "wb");
+    if(!file) return false;
+    defer(fclose(file));
+    
+    fprintf(file, "# Compiler performance baseline, written by -perf (see perf_regress.h)\n");
+    fprintf(file, "# <input> <phase> <median ns> <mad ns>\n");
+    for_array(i, entries)
+    {
+        for(int p = 0; p < Perf_NumPhases; ++p)
+        {
+            fprintf(file, "%.*s %s %.0f %.0f\n", (int)entries[i].input.length, entries[i].input.ptr,
+                    Perf_PhaseName((Perf_Phase)p), entries[i].stats.median[p], entries[i].stats.mad[p]);
+        }
+    }
+    
+    return !ferror(file);
+}
+
+char* Perf_PhaseName(Perf_Phase phase)
+{
+    switch(phase)
+    {
+        case Perf_Lex:         return "lex";
+        case Perf_Parse:       return "parse";
+        case Perf_Typecheck:   return "typecheck";
+        case Perf_ComputeSize: return "compute_size";
+        case Perf_Bytecode:    return "bytecode";
+        case Perf_IrGen:       return "ir_gen";
+        case Perf_Backend:     return "backend";
+        case Perf_Total:       return "total";
+        default:               return "unknown";
+    }
+}
+
+// Sorts the values in place
+double Perf_Median(double* values, int count)
+{
+    if(count <= 0) return 0;
+    
+    {
+        double tmp;
+#define Tmp_Less(i, j) values[i] < values[j]
+#define Tmp_Swap(i, j) tmp = values[i], values[i] = values[j], values[j] = tmp
+        QSORT(count, Tmp_Less, Tmp_Swap);
+#undef Tmp_Swap
+#undef Tmp_Less
+    }
+    
+    if(count % 2 == 1)
+        return values[count / 2];
+    
+    return (values[count / 2 - 1] + values[count / 2]) / 2.0;
+}
@@ -0,0 +1,64 @@
+
+#pragma once
+
+#include "base.h"
+
+// NOTE: Performance regression tests, run with "-perf <baseline>".
+// Each input (the files on the command line, plus a generated program)
+// is compiled a number of times in-process, without linking, so that it
+// also works on machines without the platform linker. The median and the
+// median absolute deviation (MAD) of each phase are then compared with
+// the ones stored in the baseline file, and the run fails if any phase is
+// slower by more than what the noise of both measurements can explain.
+// If the baseline file doesn't exist (or with -perf_update) it's written
+// with the new measurements instead, it's meant to be committed.
+
+enum Perf_Phase
+{
+    Perf_Lex = 0,
+    Perf_Parse,
+    Perf_Typecheck,
+    Perf_ComputeSize,
+    Perf_Bytecode,
+    Perf_IrGen,
+    Perf_Backend,
+    Perf_Total,
+
+    Perf_NumPhases
+};
+
+// Slowdowns smaller than these are never reported, timings of
+// small inputs are too noisy to be compared precisely
+#define Perf_MinSlowdownRatio 0.05
+#define Perf_MinSlowdownNs    50000
+// Number of (scaled) MADs a slowdown needs to be significant
+#define Perf_NumMads          3.0
+
+struct Perf_Stats
+{
+    double median[Perf_NumPhases];  // In nanoseconds
+    double mad[Perf_NumPhases];
+};
+
+struct Perf_Entry
+{
+    String input;
+    Perf_Stats stats;
+};
+
+// Returns false if there was a regression or an error
+bool Perf_RunAll(Slice<char*> srcFiles, char* baselinePath, int numRuns, bool update);
+bool Perf_Measure(String input, String src, int numRuns, Perf_Stats* outStats);
+bool Perf_Compare(Perf_Entry* baseline, Perf_Stats* current);
+
+// Compiles src with everything but the linker,
+// the results are in the global timings and counters
+bool Perf_Compile(String src, String path);
+
+// Baseline file, one line per input and phase:
+// <input> <phase> <median ns> <mad ns>
+Slice<Perf_Entry> Perf_ReadBaseline(Arena* arena, char* path, bool* outFound);
+bool Perf_WriteBaseline(char* path, Slice<Perf_Entry> entries);
+
+char* Perf_PhaseName(Perf_Phase phase);
+double Perf_Median(double* values, int count);
@@ -20,6 +20,8 @@ Typer InitTyper(Arena* arena, Tokenizer* tokenizer)
 
 void ResetTyper(Typer* t)
 {
+    // Only the global bindings should be left at this point
+    Typer_UnbindDecls(t, t->numGlobalBindings);
     t->curScope = &t->fileScope->scope;
     t->currentProc = 0;
     t->checkedReturnStmt = false;
@@ -108,7 +110,7 @@ bool CheckNode(Typer* t, Ast_Node* node)
 bool CheckProcDecl(Typer* t, Ast_ProcDecl* decl)
 {
     // TODO: Ok, this is getting ridiculous. Types
-    // should just have a Token* I think
+    // should just have a TokenIdx I think
     
     auto procType = Ast_GetProcType(decl);
     
@@ -155,6 +157,8 @@ bool CheckProcDef(Typer* t, Ast_ProcDef* proc)
         return false;
     }
     
+    Dg_RecordUse(t->graph, proc->decl);
+    
     // Definition
     if(!CheckBlock(t, &proc->block)) return false;
     
@@ -215,9 +219,8 @@ bool CheckBlock(Typer* t, Ast_Block* block)
 {
     ProfileFunc(prof);
     
-    auto prevScope = t->curScope;
-    t->curScope = block;
-    defer(t->curScope = prevScope);
+    auto scopeMark = Typer_EnterScope(t, block);
+    defer(Typer_ExitScope(t, scopeMark));
     
     bool result = true;
     for(int i = 0; i < block->stmts.length && result; ++i)
@@ -232,9 +235,8 @@ bool CheckBlock(Typer* t, Ast_Block* block)
 
 bool CheckIf(Typer* t, Ast_If* stmt)
 {
-    auto prevScope = t->curScope;
-    t->curScope = stmt->thenBlock;
-    defer(t->curScope = prevScope);
+    auto scopeMark = Typer_EnterScope(t, stmt->thenBlock);
+    defer(Typer_ExitScope(t, scopeMark));
     
     TypeInfo* condType = CheckCondition(t, stmt->condition);
     if(!condType) return false;
@@ -254,8 +256,9 @@ bool CheckIf(Typer* t, Ast_If* stmt)
                 // it will be added to this ficticious scope
                 Ast_Block tmpBlock;
                 tmpBlock.enclosing = t->curScope;
-                t->curScope = &tmpBlock;
-                defer(tmpBlock.decls.FreeAll());
+                auto elseMark = Typer_EnterScope(t, &tmpBlock);
+                defer(Typer_ExitScope(t, elseMark);
+                      tmpBlock.decls.FreeAll(););
                 
                 if(!CheckNode(t, stmt->elseStmt))
                     return false;
@@ -272,9 +275,8 @@ bool CheckFor(Typer* t, Ast_For* stmt)
     t->inLoopBlock = true;
     defer(t->inLoopBlock = wasInLoopBlock);
     
-    auto prevScope = t->curScope;
-    t->curScope = stmt->body;
-    defer(t->curScope = prevScope);
+    auto scopeMark = Typer_EnterScope(t, stmt->body);
+    defer(Typer_ExitScope(t, scopeMark));
     
     if(stmt->initialization && !CheckNode(t, stmt->initialization))
         return false;
@@ -306,9 +308,8 @@ bool CheckWhile(Typer* t, Ast_While* stmt)
     t->inLoopBlock = true;
     defer(t->inLoopBlock = wasInLoopBlock);
     
-    auto prevScope = t->curScope;
-    t->curScope = stmt->doBlock;
-    defer(t->curScope = prevScope);
+    auto scopeMark = Typer_EnterScope(t, stmt->doBlock);
+    defer(Typer_ExitScope(t, scopeMark));
     
     TypeInfo* condType = CheckCondition(t, stmt->condition);
     if(!condType) return false;
@@ -337,9 +338,8 @@ bool CheckDoWhile(Typer* t, Ast_DoWhile* stmt)
     // it will be added to this ficticious block
     Ast_Block tmpBlock;
     tmpBlock.enclosing = t->curScope;
-    auto prevScope = t->curScope;
-    t->curScope = &tmpBlock;
-    defer(t->curScope = prevScope;
+    auto scopeMark = Typer_EnterScope(t, &tmpBlock);
+    defer(Typer_ExitScope(t, scopeMark);
           tmpBlock.decls.FreeAll(););
     
     if(!CheckNode(t, stmt->doStmt))    return false;
@@ -417,9 +417,8 @@ bool CheckDefer(Typer* t, Ast_Defer* stmt)
     // be added to this ficticious scope.
     Ast_Block tmpBlock;
     tmpBlock.enclosing = t->curScope;
-    auto prevScope = t->curScope;
-    t->curScope = &tmpBlock;
-    defer(t->curScope = prevScope);
+    auto scopeMark = Typer_EnterScope(t, &tmpBlock);
+    defer(Typer_ExitScope(t, scopeMark));
     if(!CheckNode(t, stmt->stmt)) return false;
     
     return true;
@@ -617,6 +616,8 @@ Ast_Declaration* CheckIdent(Typer* t, Ast_IdentExpr* expr)
         return 0;
     }
     
+    Dg_RecordUse(t->graph, node);
+    
     auto decl = (Ast_Declaration*)node;
     expr->type = decl->type;
     
@@ -1099,7 +1100,7 @@ bool CheckMemberAccess(Typer* t, Ast_MemberAccess* expr)
     
     if(idx == -1)
     {
-        MemberNotFoundError(t, expr->where, expr->memberName.str, expr->target->where->text);
+        MemberNotFoundError(t, expr->where, expr->memberName.str, TokText(t->tokenizer, expr->target->where));
         return false;
     }
     
@@ -1151,7 +1152,7 @@ TypeInfo* CheckCondition(Typer* t, Ast_Node* node)
     return type;
 }
 
-bool CheckType(Typer* t, TypeInfo* type, Token* where)
+bool CheckType(Typer* t, TypeInfo* type, TokenIdx where)
 {
     // Check if there is a pure 'raw' type
     {
@@ -1196,6 +1197,7 @@ bool CheckType(Typer* t, TypeInfo* type, Token* where)
         }
         
         identDecl->structDef = (Ast_StructDef*)node;
+        Dg_RecordUse(t->graph, node);
     }
     
     return true;
@@ -1249,7 +1251,7 @@ bool ComputeSize(Typer* t, Ast_Node* node)
     return false;
 }
 
-bool FillInTypeSize(Typer* t, TypeInfo* type, Token* errTok)
+bool FillInTypeSize(Typer* t, TypeInfo* type, TokenIdx errTok)
 {
     if(type->typeId == Typeid_Ident)
     {
@@ -1285,7 +1287,7 @@ bool FillInTypeSize(Typer* t, TypeInfo* type, Token* errTok)
     return true;
 }
 
-ComputeSize_Ret ComputeStructSize(Typer* t, Ast_StructType* declStruct, Token* errTok, bool* outcome)
+ComputeSize_Ret ComputeStructSize(Typer* t, Ast_StructType* declStruct, TokenIdx errTok, bool* outcome)
 {
     struct Funcs
     {
@@ -1376,51 +1378,103 @@ cforceinline bool ApplyOrderConstraint(Ast_Declaration* decl)
     return res;
 }
 
-// This will later use a hash-table.
-// Each scope will have its own hash-table, and the search will just be
-// a linked-list traversal of hash-tables (or arrays if the number of decls is low)
-Ast_Declaration* IdentResolution(Typer* t, Ast_Block* scope, Token* where, HashedString ident)
+// NOTE: Identifiers are resolved through a single flat symbol table
+// indexed by atom, instead of walking the enclosing scopes one by one.
+// Each entry is the top of a stack of bindings for that name: entering
+// a scope pushes a binding for each of its declarations (shadowing the
+// outer ones), and exiting it pops them. Global declarations are bound
+// once for the whole typechecking phase.
+
+void Typer_InitSymbolTable(Typer* t)
+{
+    // All identifiers have already been interned by the lexer
+    uint32 numSymbols = atomTable.numAtoms + 1;
+    t->symbols.Init(numSymbols);
+    t->symbols.Resize(numSymbols);
+    memset(t->symbols.ptr, 0, sizeof(uint32) * numSymbols);
+    
+    // Index 0 is used as the null binding
+    t->bindings.Init(256);
+    t->bindings.Append({ 0 });
+    
+    Typer_BindDecls(t, &t->fileScope->scope);
+    t->numGlobalBindings = t->bindings.length;
+}
+
+void Typer_FreeSymbolTable(Typer* t)
+{
+    t->symbols.FreeAll();
+    t->bindings.FreeAll();
+}
+
+void Typer_BindDecls(Typer* t, Ast_Block* scope)
+{
+    for_array(i, scope->decls)
+    {
+        Ast_Declaration* decl = scope->decls[i];
+        Atom atom = decl->name.atom;
+        if(atom == 0 || atom >= t->symbols.length) continue;
+        
+        Typer_Binding binding;
+        binding.decl  = decl;
+        binding.scope = scope;
+        binding.where = decl->where;
+        binding.next  = t->symbols[atom];
+        binding.applyOrderConstraint = ApplyOrderConstraint(decl);
+        
+        t->symbols[atom] = (uint32)t->bindings.length;
+        t->bindings.Append(binding);
+    }
+}
+
+Typer_ScopeMark Typer_EnterScope(Typer* t, Ast_Block* scope)
+{
+    Typer_ScopeMark mark;
+    mark.prevScope   = t->curScope;
+    mark.numBindings = (uint32)t->bindings.length;
+    
+    // Some statements set the scope before checking their block
+    if(scope != t->curScope)
+    {
+        Typer_BindDecls(t, scope);
+        t->curScope = scope;
+    }
+    
+    return mark;
+}
+
+void Typer_ExitScope(Typer* t, Typer_ScopeMark mark)
+{
+    Typer_UnbindDecls(t, mark.numBindings);
+    t->curScope = mark.prevScope;
+}
+
+void Typer_UnbindDecls(Typer* t, uint32 numBindings)
+{
+    for(int64 i = t->bindings.length - 1; i >= numBindings; --i)
+    {
+        auto& binding = t->bindings[i];
+        t->symbols[binding.decl->name.atom] = binding.next;
+    }
+    
+    t->bindings.length = numBindings;
+}
+
+Ast_Declaration* IdentResolution(Typer* t, Ast_Block* scope, TokenIdx where, InternedString ident)
 {
     ProfileFunc(prof);
     
-    for(Ast_Block* curScope = scope; curScope; curScope = curScope->enclosing)
+    Assert(scope == t->curScope);
+    if(ident.atom >= t->symbols.length) return 0;
+    
+    // From the innermost binding to the outermost one
+    for(uint32 i = t->symbols[ident.atom]; i != 0; i = t->bindings[i].next)
     {
-        if(curScope->flags & Block_UseHashTable)
-        {
-            //uint32 hash = curScope->declsTable.HashFunction(ident.hash);
-            int64 hash = ident.hash;
-            for(int i = 0; ; ++i)
-            {
-                uint32 idx = HashTable_ProbingScheme(hash, i, curScope->declsTable.capacity);
-                auto& entry = curScope->declsTable.entries[idx];
-                if(!entry.occupied) break;
-                
-                // @temporary
-                // Consider just using a Slice or a DynArray instead here
-                if(entry.key == ident.hash && entry.val->name.str == ident.str)
-                {
-                    bool applyOrderConstraint = ApplyOrderConstraint(entry.val);
-                    if(applyOrderConstraint && entry.val->where >= where)
-                        continue;
-                    
-                    return entry.val;
-                }
-            }
-        }
-        else
-        {
-            auto& decls = curScope->decls;
-            
-            for(int i = 0; i < decls.length; ++i)
-            {
-                bool applyOrderConstraint = ApplyOrderConstraint(decls[i]);
-                if(applyOrderConstraint && curScope->decls[i]->where >= where)
-                    continue;
-                
-                if(curScope->decls[i]->name == ident)
-                    return curScope->decls[i];
-            }
-        }
+        auto& binding = t->bindings[i];
+        if(binding.applyOrderConstraint && binding.where >= where)
+            continue;
+        
+        return binding.decl;
     }
     
     return 0;
@@ -1430,19 +1484,15 @@ bool CheckNotAlreadyDeclared(Typer* t, Ast_Block* scope, Ast_Declaration* decl)
 {
     if(scope->flags & Block_UseHashTable)
     {
-        int64 hash = decl->name.hash;
-        for(int i = 0; i <= scope->declsTable.count + 1; ++i)
+        HashTableCursor<int64> cursor;
+        auto& table = scope->declsTable;
+        for(auto val = table.GetFirst(decl->name.atom, &cursor); val; val = table.GetNext(&cursor))
         {
-            Assert(i != scope->declsTable.count + 1);
-            
-            uint32 idx = HashTable_ProbingScheme(hash, i, scope->declsTable.capacity);
-            auto& entry = scope->declsTable.entries[idx];
-            if(!entry.occupied) break;
-            
-            if(entry.key == decl->name.hash && entry.val->name.str == decl->name.str && entry.val->where < decl->where)
+            Ast_Declaration* other = *val;
+            if(other->where < decl->where)
             {
                 SemanticError(t, decl->where, StrLit("Redefinition, this symbol was already defined in this scope, ..."));
-                SemanticErrorContinue(t, scope->decls[i]->where, StrLit("... here"));
+                SemanticErrorContinue(t, other->where, StrLit("... here"));
                 return false;
             }
         }
@@ -1942,7 +1992,7 @@ String GenerateErrorString(String message, va_list args, Arena* allocTo)
 // Consider using just a single function (e.g. SemanticErrorLong),
 // where an array of tokens is specified
 int semErrorContinueFlag = 0;
-void SemanticError(Typer* t, Token* token, String message, ...)
+void SemanticError(Typer* t, TokenIdx token, String message, ...)
 {
     if(t->status)
     {
@@ -1965,7 +2015,7 @@ void SemanticError(Typer* t, Token* token, String message, ...)
 
 // It's assumed that this function is called immediately after
 // SemanticError if at all
-void SemanticErrorContinue(Typer* t, Token* token, String message, ...)
+void SemanticErrorContinue(Typer* t, TokenIdx token, String message, ...)
 {
     if(semErrorContinueFlag >= 2)
         return;
@@ -1981,27 +2031,27 @@ void SemanticErrorContinue(Typer* t, Token* token, String message, ...)
     CompileErrorContinue(t->tokenizer, token, errStr);
 }
 
-void CannotConvertToScalarTypeError(Typer* t, TypeInfo* type, Token* where)
+void CannotConvertToScalarTypeError(Typer* t, TypeInfo* type, TokenIdx where)
 {
     SemanticError(t, where, StrLit("Cannot convert type '%T' to any scalar type"), type);
 }
 
-void CannotConvertToIntegralTypeError(Typer* t, TypeInfo* type, Token* where)
+void CannotConvertToIntegralTypeError(Typer* t, TypeInfo* type, TokenIdx where)
 {
     SemanticError(t, where, StrLit("Cannot convert type '%T' to any integral type"), type);
 }
 
-void CannotDereferenceTypeError(Typer* t, TypeInfo* type, Token* where)
+void CannotDereferenceTypeError(Typer* t, TypeInfo* type, TokenIdx where)
 {
     SemanticError(t, where, StrLit("Cannot dereference type '%T'"), type);
 }
 
-void IncompatibleTypesError(Typer* t, TypeInfo* type1, TypeInfo* type2, Token* where)
+void IncompatibleTypesError(Typer* t, TypeInfo* type1, TypeInfo* type2, TokenIdx where)
 {
     SemanticError(t, where, StrLit("The following types are incompatible: '%T' and '%T'"), type1, type2);
 }
 
-void IncompatibleReturnsError(Typer* t, Token* where, int numStmtRets, int numProcRets)
+void IncompatibleReturnsError(Typer* t, TokenIdx where, int numStmtRets, int numProcRets)
 {
     if(numStmtRets == 0)
         SemanticError(t, where, StrLit("Statement does not return a value, ..."));
@@ -2023,7 +2073,7 @@ void IncompatibleReturnsError(Typer* t, Token* where, int numStmtRets, int numPr
         SemanticErrorContinue(t, t->currentProc->where, StrLit("... but the procedure returns %d values."), numProcRets);
 }
 
-void MemberNotFoundError(Typer* t, Token* where, String memberName, String structName)
+void MemberNotFoundError(Typer* t, TokenIdx where, String memberName, String structName)
 {
     ScratchArena scratch;
     StringBuilder b(scratch);
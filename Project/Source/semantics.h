@@ -6,6 +6,22 @@
 
 struct DepGraph;
 
+struct Typer_Binding
+{
+    Ast_Declaration* decl;
+    Ast_Block* scope;
+    TokenIdx where;
+    uint32 next;  // Binding which is shadowed by this one, 0 if none
+    bool applyOrderConstraint;
+};
+
+// Used to restore the previous scope
+struct Typer_ScopeMark
+{
+    Ast_Block* prevScope;
+    uint32 numBindings;
+};
+
 struct Typer
 {
     Tokenizer* tokenizer;  // This will be an array of tokenizers I assume?
@@ -25,18 +41,24 @@ struct Typer
     
     DepGraph* graph;
     
+    // Flat symbol table, indexed by atom. Each element is
+    // the index of the innermost binding for that name.
+    Array<uint32> symbols;
+    Array<Typer_Binding> bindings;
+    uint32 numGlobalBindings = 0;
+    
     bool status = true;
 };
 
 Typer InitTyper(Arena* arena, Tokenizer* tokenizer);
-void SemanticError(Typer* t, Token* token, String message, ...);
-void SemanticErrorContinue(Typer* t, Token* token, String message, ...);
-void CannotConvertToScalarTypeError(Typer* t, TypeInfo* type, Token* where);
-void CannotConvertToIntegralTypeError(Typer* t, TypeInfo* type, Token* where);
-void CannotDereferenceTypeError(Typer* t, TypeInfo* type, Token* where);
-void IncompatibleTypesError(Typer* t, TypeInfo* type1, TypeInfo* type2, Token* where);
-void IncompatibleReturnsError(Typer* t, Token* where, int numStmtRets, int numProcRets);
-void MemberNotFoundError(Typer* t, Token* where, String memberName, String structName);
+void SemanticError(Typer* t, TokenIdx token, String message, ...);
+void SemanticErrorContinue(Typer* t, TokenIdx token, String message, ...);
+void CannotConvertToScalarTypeError(Typer* t, TypeInfo* type, TokenIdx where);
+void CannotConvertToIntegralTypeError(Typer* t, TypeInfo* type, TokenIdx where);
+void CannotDereferenceTypeError(Typer* t, TypeInfo* type, TokenIdx where);
+void IncompatibleTypesError(Typer* t, TypeInfo* type1, TypeInfo* type2, TokenIdx where);
+void IncompatibleReturnsError(Typer* t, TokenIdx where, int numStmtRets, int numProcRets);
+void MemberNotFoundError(Typer* t, TokenIdx where, String memberName, String structName);
 
 // Semantics
 inline bool IsNodeLValue(Ast_Node* node)
@@ -87,15 +109,21 @@ bool CheckSubscript(Typer* t, Ast_Subscript* expr);
 bool CheckMemberAccess(Typer* t, Ast_MemberAccess* expr);
 TypeInfo* CheckDeclOrExpr(Typer* t, Ast_Node* node);
 TypeInfo* CheckCondition(Typer* t, Ast_Node* node);
-bool CheckType(Typer* t, TypeInfo* type, Token* where);
+bool CheckType(Typer* t, TypeInfo* type, TokenIdx where);
 bool ComputeSize(Typer* t, Ast_Node* node);
 struct ComputeSize_Ret { uint64 size; uint64 align; };
-bool FillInTypeSize(Typer* t, TypeInfo* type, Token* errTok);
-ComputeSize_Ret ComputeStructSize(Typer* t, Ast_StructType* declStruct, Token* errTok, bool* outcome);
+bool FillInTypeSize(Typer* t, TypeInfo* type, TokenIdx errTok);
+ComputeSize_Ret ComputeStructSize(Typer* t, Ast_StructType* declStruct, TokenIdx errTok, bool* outcome);
 
 // Identifier resolution
+void Typer_InitSymbolTable(Typer* t);
+void Typer_FreeSymbolTable(Typer* t);
+void Typer_BindDecls(Typer* t, Ast_Block* scope);
+void Typer_UnbindDecls(Typer* t, uint32 numBindings);
+Typer_ScopeMark Typer_EnterScope(Typer* t, Ast_Block* scope);
+void Typer_ExitScope(Typer* t, Typer_ScopeMark mark);
 bool ApplyOrderConstraint(Ast_Declaration* decl);
-Ast_Declaration* IdentResolution(Typer* t, Ast_Block* scope, Token* where, HashedString ident);
+Ast_Declaration* IdentResolution(Typer* t, Ast_Block* scope, TokenIdx where, InternedString ident);
 bool CheckNotAlreadyDeclared(Typer* t, Ast_Block* scope, Ast_Declaration* decl);
 
 // Types
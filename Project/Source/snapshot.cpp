@@ -0,0 +1,441 @@
+
+#include "snapshot.h"
+#include "memory_management.h"
+#include "atom.h"
+#include "semantics.h"
+#include "cmdline_args.h"
+
+#ifndef UnityBuild
+extern CmdLineArgs cmdLineArgs;
+#endif
+
+// Pointers to these are stored as indices, so that
+// they're still the same objects after loading
+static TypeInfo* snapPrimitives[] =
+{
+    &Typer_None, &Typer_Raw, &Typer_Bool, &Typer_Char,
+    &Typer_Uint8, &Typer_Uint16, &Typer_Uint32, &Typer_Uint64,
+    &Typer_Int8, &Typer_Int16, &Typer_Int32, &Typer_Int64,
+    &Typer_Float, &Typer_Double
+};
+
+bool Snap_Write(char* path, String src, Interp* interp)
+{
+    ProfileFunc(prof);
+    
+    Arena out = Arena_VirtualMemInit(Snap_MaxSize, MB(2));
+    defer(Arena_Free(&out));
+    
+    Snap_Writer w;
+    w.out = &out;
+    w.objects.Init(HashTable_MinCapacity);
+    w.strings.Init(64);
+    defer({
+              w.objects.Free();
+              w.strings.Free();
+              w.ptrFixups.FreeAll();
+              w.typeFixups.FreeAll();
+              w.atomFixups.FreeAll();
+          });
+    
+    // The header is the first allocation, at offset 0
+    auto header = Arena_AllocVarPack(&out, Snap_Header);
+    memset(header, 0, sizeof(Snap_Header));
+    w.base = (char*)header;
+    
+    memcpy(header->magic, Snap_Magic, sizeof(header->magic));
+    header->version  = Snap_Version;
+    header->layoutId = Snap_LayoutId();
+    header->buildId  = Snap_BuildId();
+    header->srcHash  = HashString(src);
+    header->srcSize  = src.length;
+    header->optLevel = cmdLineArgs.optLevel;
+    
+    auto symbols = (Interp_Symbol*)Arena_AllocAndCopy(&out, interp->symbols.ptr, sizeof(Interp_Symbol) * interp->symbols.length, alignof(Interp_Symbol));
+    auto procs = (Interp_Proc*)Arena_AllocAndCopy(&out, interp->procs.ptr, sizeof(Interp_Proc) * interp->procs.length, alignof(Interp_Proc));
+    header->symbols    = symbols;
+    header->procs      = procs;
+    header->numSymbols = (uint32)interp->symbols.length;
+    header->numProcs   = (uint32)interp->procs.length;
+    
+    for_array(i, interp->symbols)
+        Snap_WriteSymbol(&w, &symbols[i]);
+    
+    for_array(i, interp->procs)
+        Snap_WriteProc(&w, &procs[i]);
+    
+    header->ptrFixups  = (uint32*)Arena_AllocAndCopy(&out, w.ptrFixups.ptr, sizeof(uint32) * w.ptrFixups.length, alignof(uint32));
+    header->typeFixups = (uint32*)Arena_AllocAndCopy(&out, w.typeFixups.ptr, sizeof(uint32) * w.typeFixups.length, alignof(uint32));
+    header->atomFixups = (uint32*)Arena_AllocAndCopy(&out, w.atomFixups.ptr, sizeof(uint32) * w.atomFixups.length, alignof(uint32));
+    header->numPtrFixups  = (uint32)w.ptrFixups.length;
+    header->numTypeFixups = (uint32)w.typeFixups.length;
+    header->numAtomFixups = (uint32)w.atomFixups.length;
+    
+    // If the arena had to chain another block, offsets don't work anymore
+    if(out.block) return false;
+    header->fileSize = out.offset;
+    
+    FILE* file = fopen(path, "wb");
+    if(!file) return false;
+    defer(fclose(file));
+    
+    return fwrite(header, 1, out.offset, file) == out.offset;
+}
+
+bool Snap_Load(char* path, String src, Interp* outInterp, MappedFile* outFile)
+{
+    ProfileFunc(prof);
+    
+    MappedFile file = MapFileCopyOnWrite(path);
+    if(!file.ptr) return false;
+    
+    auto header = (Snap_Header*)file.ptr;
+    if(!Snap_IsCompatible(header, file.size, src) || !Snap_ApplyFixups(header))
+    {
+        UnmapFile(file);
+        return false;
+    }
+    
+    // NOTE: The arrays are never grown after the bytecode is generated,
+    // so they can just point into the file
+    Interp interp;
+    interp.module = 0;
+    interp.graph  = 0;
+    interp.symbols.ptr      = &*header->symbols;
+    interp.symbols.length   = header->numSymbols;
+    interp.symbols.capacity = header->numSymbols;
+    interp.procs.ptr        = &*header->procs;
+    interp.procs.length     = header->numProcs;
+    interp.procs.capacity   = header->numProcs;
+    interp.entities = { 0, 0 };
+    
+    *outInterp = interp;
+    *outFile = file;
+    return true;
+}
+
+bool Snap_IsCompatible(Snap_Header* header, size_t fileSize, String src)
+{
+    if(fileSize < sizeof(Snap_Header)) return false;
+    if(memcmp(header->magic, Snap_Magic, sizeof(header->magic)) != 0) return false;
+    
+    bool compatible = header->version  == Snap_Version
+                   && header->layoutId == Snap_LayoutId()
+                   && header->buildId  == Snap_BuildId()
+                   && header->fileSize == fileSize
+                   && header->optLevel == cmdLineArgs.optLevel
+                   && header->srcSize  == (uint64)src.length
+                   && header->srcHash  == HashString(src);
+    if(!compatible) return false;
+    
+    return Snap_ArrayInFile(header, &header->symbols, header->numSymbols)
+        && Snap_ArrayInFile(header, &header->procs, header->numProcs)
+        && Snap_ArrayInFile(header, &header->ptrFixups, header->numPtrFixups)
+        && Snap_ArrayInFile(header, &header->typeFixups, header->numTypeFixups)
+        && Snap_ArrayInFile(header, &header->atomFixups, header->numAtomFixups);
+}
+
+template<typename t>
+bool Snap_ArrayInFile(Snap_Header* header, RelPtr<t>* array, uint32 count)
+{
+    if(count == 0) return true;
+    if(array->offset == 0) return false;
+    
+    int64 offset = (int64)((char*)array - (char*)header) + array->offset;
+    return offset >= (int64)sizeof(Snap_Header)
+        && (uint64)offset + (uint64)count * sizeof(t) <= header->fileSize;
+}
+
+// Fixups (and the tables, see Snap_IsCompatible) are checked
+// against the size of the file, so that a corrupt snapshot
+// can't be used to write outside of it, nor to intern strings
+// which are outside of it.
+bool Snap_ApplyFixups(Snap_Header* header)
+{
+    ProfileFunc(prof);
+    
+    char* base = (char*)header;
+    uint64 size = header->fileSize;
+    
+    uint32* ptrFixups = &*header->ptrFixups;
+    for(uint32 i = 0; i < header->numPtrFixups; ++i)
+    {
+        if(ptrFixups[i] + sizeof(uint64) > size) return false;
+        
+        auto slot = (uint64*)(base + ptrFixups[i]);
+        if(*slot >= size) return false;
+        *slot = (uint64)(base + *slot);
+    }
+    
+    uint32* typeFixups = &*header->typeFixups;
+    for(uint32 i = 0; i < header->numTypeFixups; ++i)
+    {
+        if(typeFixups[i] + sizeof(uint64) > size) return false;
+        
+        auto slot = (uint64*)(base + typeFixups[i]);
+        if(*slot >= StArraySize(snapPrimitives)) return false;
+        *slot = (uint64)snapPrimitives[*slot];
+    }
+    
+    // The strings are valid pointers at this point
+    uint32* atomFixups = &*header->atomFixups;
+    for(uint32 i = 0; i < header->numAtomFixups; ++i)
+    {
+        if(atomFixups[i] + sizeof(InternedString) > size) return false;
+        
+        auto str = (InternedString*)(base + atomFixups[i]);
+        uint64 strOffset = (uint64)str->ptr - (uint64)base;
+        if((uint64)str->ptr < (uint64)base || strOffset > size) return false;
+        if(str->length < 0 || (uint64)str->length > size - strOffset) return false;
+        
+        str->atom = Atom_Intern(str->str);
+    }
+    
+    return true;
+}
+
+// Everything in the snapshot is stored as it is in memory
+uint32 Snap_LayoutId()
+{
+    uint64 sizes[] =
+    {
+        sizeof(Interp_Symbol), sizeof(Interp_Proc), sizeof(Interp_Instr),
+        sizeof(TypeInfo), sizeof(Ast_PtrType), sizeof(Ast_ArrType), sizeof(Ast_ProcType),
+        sizeof(Ast_IdentType), sizeof(Ast_StructType), sizeof(Ast_Declaration),
+        sizeof(Ast_VarDecl), sizeof(Ast_ProcDecl), sizeof(Ast_StructDef)
+    };
+    
+    return LayoutIdOf({ sizes, StArraySize(sizes) });
+}
+
+// The bytecode can change without any of the structures changing
+uint64 Snap_BuildId()
+{
+    return HashString(StrLit(__DATE__ " " __TIME__));
+}
+
+uint32 Snap_Offset(Snap_Writer* w, void* ptr)
+{
+    return (uint32)((char*)ptr - w->base);
+}
+
+void Snap_SetPtr(Snap_Writer* w, void* slot, uint32 target)
+{
+    *(uint64*)slot = target;
+    if(target) w->ptrFixups.Append(Snap_Offset(w, slot));
+}
+
+void Snap_TypeRef(Snap_Writer* w, TypeInfo** slot)
+{
+    TypeInfo* type = *slot;
+    for(int i = 0; i < StArraySize(snapPrimitives); ++i)
+    {
+        if(type == snapPrimitives[i])
+        {
+            *(uint64*)slot = i;
+            w->typeFixups.Append(Snap_Offset(w, slot));
+            return;
+        }
+    }
+    
+    Snap_SetPtr(w, slot, Snap_WriteType(w, type));
+}
+
+template<typename t>
+void Snap_DeclRef(Snap_Writer* w, t** slot)
+{
+    Snap_SetPtr(w, slot, Snap_WriteDecl(w, *slot));
+}
+
+void Snap_WriteString(Snap_Writer* w, String* slot)
+{
+    if(!slot->ptr)
+    {
+        slot->length = 0;
+        return;
+    }
+    
+    uint32* found = w->strings.Get(*slot);
+    if(found)
+    {
+        Snap_SetPtr(w, &slot->ptr, *found);
+        return;
+    }
+    
+    // Strings from the source file are not null terminated
+    char* copy = (char*)Arena_Alloc(w->out, slot->length + 1, 1);
+    memcpy(copy, slot->ptr, slot->length);
+    copy[slot->length] = 0;
+    
+    uint32 offset = Snap_Offset(w, copy);
+    w->strings.Add(*slot, offset);
+    Snap_SetPtr(w, &slot->ptr, offset);
+}
+
+void Snap_WriteInterned(Snap_Writer* w, InternedString* slot)
+{
+    bool isNull = !slot->ptr;
+    Snap_WriteString(w, &slot->str);
+    slot->atom = 0;
+    
+    if(!isNull) w->atomFixups.Append(Snap_Offset(w, slot));
+}
+
+template<typename t>
+t* Snap_WriteSlice(Snap_Writer* w, Slice<t>* slot)
+{
+    if(slot->length <= 0)
+    {
+        slot->ptr = 0;
+        slot->length = 0;
+        return 0;
+    }
+    
+    auto copy = (t*)Arena_AllocAndCopy(w->out, slot->ptr, sizeof(t) * slot->length, alignof(t));
+    Snap_SetPtr(w, &slot->ptr, Snap_Offset(w, copy));
+    return copy;
+}
+
+// The object is registered before anything it points to is
+// written, so cycles (e.g. in struct types) terminate
+template<typename t>
+t* Snap_CopyObject(Snap_Writer* w, t* obj)
+{
+    auto copy = (t*)Arena_AllocAndCopy(w->out, obj, sizeof(t), alignof(t));
+    w->objects.Add((int64)obj, Snap_Offset(w, copy));
+    return copy;
+}
+
+uint32 Snap_WriteDecl(Snap_Writer* w, Ast_Declaration* decl)
+{
+    if(!decl) return 0;
+    
+    uint32* found = w->objects.Get((int64)decl);
+    if(found) return *found;
+    
+    Ast_Declaration* copy = 0;
+    switch(decl->kind)
+    {
+        case AstKind_VarDecl:
+        {
+            auto varDecl = Snap_CopyObject(w, (Ast_VarDecl*)decl);
+            varDecl->initExpr = 0;  // The rest of the AST is not stored
+            copy = varDecl;
+            break;
+        }
+        case AstKind_ProcDecl:  copy = Snap_CopyObject(w, (Ast_ProcDecl*)decl);  break;
+        case AstKind_StructDef: copy = Snap_CopyObject(w, (Ast_StructDef*)decl); break;
+        default:                copy = Snap_CopyObject(w, decl);                 break;
+    }
+    
+    copy->entityIdx = Dg_Null;
+    copy->tildeNode = 0;
+    Snap_TypeRef(w, &copy->type);
+    Snap_WriteInterned(w, &copy->name);
+    return Snap_Offset(w, copy);
+}
+
+uint32 Snap_WriteType(Snap_Writer* w, TypeInfo* type)
+{
+    if(!type) return 0;
+    
+    uint32* found = w->objects.Get((int64)type);
+    if(found) return *found;
+    
+    TypeInfo* copy = 0;
+    switch(type->typeId)
+    {
+        case Typeid_Ptr:
+        {
+            auto ptrType = Snap_CopyObject(w, (Ast_PtrType*)type);
+            Snap_TypeRef(w, &ptrType->baseType);
+            copy = ptrType;
+            break;
+        }
+        case Typeid_Arr:
+        {
+            auto arrType = Snap_CopyObject(w, (Ast_ArrType*)type);
+            arrType->sizeExpr = 0;  // Only sizeValue is used after ComputeSize
+            Snap_TypeRef(w, &arrType->baseType);
+            copy = arrType;
+            break;
+        }
+        case Typeid_Proc:
+        {
+            auto procType = Snap_CopyObject(w, (Ast_ProcType*)type);
+            procType->tildeProto = 0;
+            
+            auto args = Snap_WriteSlice(w, &procType->args);
+            for_array(i, procType->args)
+                Snap_DeclRef(w, &args[i]);
+            
+            auto retTypes = Snap_WriteSlice(w, &procType->retTypes);
+            for_array(i, procType->retTypes)
+                Snap_TypeRef(w, &retTypes[i]);
+            
+            copy = procType;
+            break;
+        }
+        case Typeid_Ident:
+        {
+            auto identType = Snap_CopyObject(w, (Ast_IdentType*)type);
+            identType->polyParams = { 0, 0 };
+            Snap_WriteInterned(w, &identType->name);
+            Snap_DeclRef(w, &identType->structDef);
+            copy = identType;
+            break;
+        }
+        case Typeid_Struct:
+        {
+            auto structType = Snap_CopyObject(w, (Ast_StructType*)type);
+            structType->memberNameTokens = { 0, 0 };
+            
+            auto memberTypes = Snap_WriteSlice(w, &structType->memberTypes);
+            for_array(i, structType->memberTypes)
+                Snap_TypeRef(w, &memberTypes[i]);
+            
+            auto memberNames = Snap_WriteSlice(w, &structType->memberNames);
+            for_array(i, structType->memberNames)
+                Snap_WriteInterned(w, &memberNames[i]);
+            
+            Snap_WriteSlice(w, &structType->memberOffsets);
+            copy = structType;
+            break;
+        }
+        default:
+        {
+            copy = Snap_CopyObject(w, type);
+            break;
+        }
+    }
+    
+    return Snap_Offset(w, copy);
+}
+
+void Snap_WriteProc(Snap_Writer* w, Interp_Proc* proc)
+{
+    proc->module = 0;
+    proc->entityIdx = Dg_Null;
+    
+    Snap_WriteSlice(w, &proc->instrArrays);
+    Snap_WriteSlice(w, &proc->regArrays);
+    Snap_WriteSlice(w, &proc->constArrays);
+    Snap_WriteSlice(w, &proc->argRules);
+    Snap_WriteSlice(w, &proc->instrs);
+    Snap_WriteSlice(w, &proc->argTypes);
+    
+    proc->instrArrays.capacity = proc->instrArrays.length;
+    proc->regArrays.capacity   = proc->regArrays.length;
+    proc->constArrays.capacity = proc->constArrays.length;
+    proc->argRules.capacity    = proc->argRules.length;
+    proc->instrs.capacity      = proc->instrs.length;
+    proc->argTypes.capacity    = proc->argTypes.length;
+}
+
+void Snap_WriteSymbol(Snap_Writer* w, Interp_Symbol* symbol)
+{
+    symbol->tildeSymbol = 0;
+    Snap_DeclRef(w, &symbol->decl);
+    Snap_WriteString(w, &symbol->name);
+    Snap_TypeRef(w, &symbol->typeInfo);
+}
@@ -0,0 +1,99 @@
+
+#pragma once
+
+#include "base.h"
+#include "interpreter.h"
+#include "os/os_agnostic.h"
+
+// NOTE: Snapshot of a typechecked program, written with "-snapshot <path>"
+// right after the bytecode is generated, so that a compilation which fails
+// later (in codegen or when linking) doesn't have to redo the frontend the
+// next time. It contains the Interp symbols and procedures, and everything
+// the backend and the VM need from the AST: the declarations the symbols
+// refer to, all reachable types and the interned strings. The rest of the
+// AST is not stored, so it can only be resumed from the Codegen phase
+// (or from -run).
+// Structures are stored exactly as they are in memory, with pointers
+// replaced by offsets from the start of the file. Loading is a single
+// copy-on-write mapping of the file, followed by a pass over the fixup
+// tables which adds the base address to each of those pointers, and
+// re-interns the strings (atoms are not stable across processes).
+// The snapshot is only used if the source file, the compiler build and
+// the options which change the bytecode are the same.
+
+#define Snap_Magic   "RYUSNAP"
+#define Snap_Version 1
+// Offsets in the header are 32-bit
+#define Snap_MaxSize GB(2)
+
+struct Snap_Header
+{
+    char magic[8];
+    uint32 version;
+    uint32 layoutId;  // See Snap_LayoutId
+    uint64 buildId;   // Snapshots are only valid for the compiler which wrote them
+    uint64 srcHash;
+    uint64 srcSize;
+    uint64 fileSize;  // A truncated file is never loaded
+    int32 optLevel;
+    
+    RelPtr<Interp_Symbol> symbols;
+    RelPtr<Interp_Proc> procs;
+    uint32 numSymbols;
+    uint32 numProcs;
+    
+    // Fixup tables, offsets of the fields to patch
+    RelPtr<uint32> ptrFixups;   // Pointers, they contain an offset from the start of the file
+    RelPtr<uint32> typeFixups;  // Pointers to primitive types, they contain an index in snapPrimitives
+    RelPtr<uint32> atomFixups;  // InternedStrings, which need a new atom
+    uint32 numPtrFixups;
+    uint32 numTypeFixups;
+    uint32 numAtomFixups;
+};
+
+struct Snap_Writer
+{
+    Arena* out;
+    char* base;
+    
+    // Address of an object in the compiler -> its offset in the snapshot
+    HashTable<int64, uint32> objects;
+    StringTable<uint32> strings;
+    
+    Array<uint32> ptrFixups;
+    Array<uint32> typeFixups;
+    Array<uint32> atomFixups;
+};
+
+// Returns false if the snapshot could not be written
+bool Snap_Write(char* path, String src, Interp* interp);
+// Returns false if there's no valid snapshot for src at path. On success, the
+// file stays mapped (interp points into it) until outFile is unmapped.
+bool Snap_Load(char* path, String src, Interp* outInterp, MappedFile* outFile);
+bool Snap_ApplyFixups(Snap_Header* header);
+bool Snap_IsCompatible(Snap_Header* header, size_t fileSize, String src);
+// Checks that an array referenced by the header is inside of the file
+template<typename t>
+bool Snap_ArrayInFile(Snap_Header* header, RelPtr<t>* array, uint32 count);
+uint32 Snap_LayoutId();
+uint64 Snap_BuildId();
+
+// Writing. Except for Snap_WriteDecl and Snap_WriteType, these take a field of an
+// object which was already copied in the snapshot (still holding the original
+// value) and rewrite it, writing what it points to if necessary.
+uint32 Snap_Offset(Snap_Writer* w, void* ptr);
+void Snap_SetPtr(Snap_Writer* w, void* slot, uint32 target);
+void Snap_TypeRef(Snap_Writer* w, TypeInfo** slot);
+template<typename t>
+void Snap_DeclRef(Snap_Writer* w, t** slot);
+void Snap_WriteString(Snap_Writer* w, String* slot);
+void Snap_WriteInterned(Snap_Writer* w, InternedString* slot);
+// Returns the elements in the snapshot
+template<typename t>
+t* Snap_WriteSlice(Snap_Writer* w, Slice<t>* slot);
+template<typename t>
+t* Snap_CopyObject(Snap_Writer* w, t* obj);
+uint32 Snap_WriteDecl(Snap_Writer* w, Ast_Declaration* decl);
+uint32 Snap_WriteType(Snap_Writer* w, TypeInfo* type);
+void Snap_WriteProc(Snap_Writer* w, Interp_Proc* proc);
+void Snap_WriteSymbol(Snap_Writer* w, Interp_Symbol* symbol);
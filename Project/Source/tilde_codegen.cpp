@@ -2,12 +2,13 @@
 #include "base.h"
 #include "interpreter.h"
 #include "cmdline_args.h"
+#include "os/os_agnostic.h"
 
 #include "tilde_codegen.h"
+#include "compile_stats.h"
 
 #ifndef UnityBuild
 extern CmdLineArgs cmdLineArgs;
-extern Timings timings;
 #endif
 
 Tc_Context Tc_InitCtx(TB_Module* module, Arena* strArena, bool emitAsm)
@@ -19,7 +20,7 @@ Tc_Context Tc_InitCtx(TB_Module* module, Arena* strArena, bool emitAsm)
     return result;
 }
 
-void Tc_CodegenAndLink(Ast_FileScope* file, Interp* interp, Slice<char*> objFiles)
+void Tc_CodegenAndLink(Ast_FileScope* file, Interp* interp, Slice<char*> objFiles, bool link)
 {
     ProfileFunc(prof);
     
@@ -38,9 +39,11 @@ void Tc_CodegenAndLink(Ast_FileScope* file, Interp* interp, Slice<char*> objFile
     defer(tb_module_destroy(module));
     
     Arena strArena = Arena_VirtualMemInit(GB(4), MB(2));
+    defer(if(cmdLineArgs.mem) Arena_RecordStats("Tilde strings", &strArena));
     Tc_Context ctx = Tc_InitCtx(module, &strArena, cmdLineArgs.emitAsm);
     
     ctx.symbols = interp->symbols;
+    ctx.entities = interp->entities;
     
     //tb_arena_create(&ctx.procArena, KB(4));
     //defer(tb_arena_destroy(&ctx.procArena));
@@ -66,7 +69,7 @@ void Tc_CodegenAndLink(Ast_FileScope* file, Interp* interp, Slice<char*> objFile
         return;
     }
     
-    Tc_Link(ctx.module, objFiles, arch);
+    if(link) Tc_Link(ctx.module, objFiles, arch);
 }
 
 void Tc_GenSymbol(Tc_Context* ctx, Interp_Symbol* symbol)
@@ -115,7 +118,7 @@ void Tc_GenProc(Tc_Context* ctx, Interp_Proc* proc)
 {
     ProfileFunc(prof);
     
-    uint64 irGenStart = __rdtsc();
+    uint64 irGenStart = GetMonotonicTimeNs();
     
     ScratchArena scratch;
     
@@ -176,17 +179,25 @@ void Tc_GenProc(Tc_Context* ctx, Interp_Proc* proc)
     // Generate its instructions
     Tc_GenInstrs(ctx, curProc, proc);
     
-    timings.irGen += 1.0 / GetRdtscFreq() * (__rdtsc() - irGenStart);
+    uint64 backendStart = GetMonotonicTimeNs();
+    timings.irGen += (backendStart - irGenStart) / 1e9;
     
     Tc_BackendGenProc(curProc, 0, ctx->emitAsm);
+    
+    if(proc->entityIdx != Dg_Null)
+    {
+        auto& cost = ctx->entities[proc->entityIdx].cost;
+        cost.irGenNs   += backendStart - irGenStart;
+        cost.backendNs += GetMonotonicTimeNs() - backendStart;
+    }
 }
 
 void Tc_BackendGenProc(TB_Function* proc, TB_Arena* arena, bool emitAsm)
 {
     ProfileFunc(prof);
     
-    uint64 backendStart = __rdtsc();
-    defer(timings.backend += 1.0 / GetRdtscFreq() * (__rdtsc() - backendStart));
+    uint64 backendStart = GetMonotonicTimeNs();
+    defer(timings.backend += SecondsSince(backendStart));
     
     TB_Passes* p = tb_pass_enter(proc, arena);
     if(cmdLineArgs.emitIr)
@@ -208,6 +219,10 @@ void Tc_BackendGenProc(TB_Function* proc, TB_Arena* arena, bool emitAsm)
     TB_FunctionOutput* output = tb_pass_codegen(p, emitAsm);
     tb_pass_exit(p);
     
+    size_t codeSize = 0;
+    tb_output_get_code(output, &codeSize);
+    counters.bytesEmitted += codeSize;
+    
     if(emitAsm)
     {
         tb_output_print_asm(output, stdout);
@@ -224,6 +239,14 @@ void Tc_GenInstrs(Tc_Context* ctx, TB_Function* tildeProc, Interp_Proc* proc)
     
     for(int i = 0; i < proc->instrs.length; ++i)
     {
+        // Self tail calls jump here, past the argument setup
+        if(proc->hasSelfTailCall && i == proc->prologueEnd)
+        {
+            ctx->bodyRegion = tb_inst_region(tildeProc);
+            tb_inst_goto(tildeProc, ctx->bodyRegion);
+            tb_inst_set_control(tildeProc, ctx->bodyRegion);
+        }
+        
         auto& instr = proc->instrs[i];
         auto& dst = regs[instr.dst];
         auto& unarySrc = regs[instr.unary.src];
@@ -271,6 +294,33 @@ void Tc_GenInstrs(Tc_Context* ctx, TB_Function* tildeProc, Interp_Proc* proc)
                 
                 break;
             }
+            case Op_TailCall:
+            {
+                if(instr.bitfield & InstrBF_SelfTailCall)
+                {
+                    Tc_GenSelfTailCall(ctx, tildeProc, proc, instr);
+                    ++i;  // Skip the return
+                    break;
+                }
+                
+                // NOTE: Tilde doesn't have guaranteed tail calls yet,
+                // so this is just a call, followed by the return
+                auto symbol = syms[instr.call.target];
+                
+                auto debugProto = Tc_ConvertProcToDebugType(ctx->module, ctx->symbols[symbol].typeInfo);
+                auto proto = tb_prototype_from_dbg(ctx->module, debugProto);
+                
+                auto nodes = Tc_GetNodeArray(ctx, proc, instr.call.argStart, instr.call.argCount, scratch);
+                
+                TB_MultiOutput outputs = tb_inst_call(tildeProc,
+                                                      proto,
+                                                      regs[instr.call.target],
+                                                      instr.call.argCount,
+                                                      nodes);
+                Assert(outputs.count == 1);
+                dst = outputs.single;
+                break;
+            }
             case Op_SysCall: break;
             case Op_Store:
             {
@@ -319,12 +369,19 @@ void Tc_GenInstrs(Tc_Context* ctx, TB_Function* tildeProc, Interp_Proc* proc)
                     auto caseBB = bbs[proc->instrArrays[instr.branch.caseStart]].region;
                     tb_inst_if(tildeProc, value, caseBB, bbs[instr.branch.defaultCase].region);
                 }
+                else if(instr.bitfield & InstrBF_JumpTable)
+                    Tc_GenJumpTable(ctx, tildeProc, proc, instr);
+                else if(instr.bitfield & InstrBF_BinarySearch)
+                {
+                    auto value = regs[instr.branch.value];
+                    Tc_GenBinarySearch(ctx, tildeProc, proc, instr, value, 0, instr.branch.count);
+                }
                 else
                 {
-                    //Assert(false && "Switch codegen not implemented");
                     TB_SwitchEntry* entries = Tc_GetSwitchEntries(ctx, proc, instr, scratch);
                     
-                    tb_inst_branch(tildeProc, entries[0].value->dt, regs[instr.branch.value], bbs[instr.branch.defaultCase].region, instr.branch.count, entries);
+                    auto value = regs[instr.branch.value];
+                    tb_inst_branch(tildeProc, value->dt, value, bbs[instr.branch.defaultCase].region, instr.branch.count, entries);
                 }
                 
                 break;
@@ -360,7 +417,7 @@ void Tc_GenInstrs(Tc_Context* ctx, TB_Function* tildeProc, Interp_Proc* proc)
                 break;
             }
             case Op_MemberAccess: dst = tb_inst_member_access(tildeProc, regs[instr.memacc.base], instr.memacc.offset); break;
-            case Op_ArrayAccess: break;
+            case Op_ArrayAccess: dst = tb_inst_array_access(tildeProc, regs[instr.arracc.base], regs[instr.arracc.idx], instr.arracc.stride); break;
             case Op_Truncate: dst = tb_inst_trunc(tildeProc, unarySrc, unaryType); break;
             case Op_FloatExt: dst = tb_inst_fpxt(tildeProc, unarySrc, unaryType); break;
             case Op_SignExt: dst = tb_inst_sxt(tildeProc, unarySrc, unaryType); break;
@@ -372,7 +429,7 @@ void Tc_GenInstrs(Tc_Context* ctx, TB_Function* tildeProc, Interp_Proc* proc)
             case Op_Int2Float: dst = tb_inst_int2float(tildeProc, unarySrc, unaryType, true); break;
             case Op_Float2Int: dst = tb_inst_float2int(tildeProc, unarySrc, unaryType, true); break;
             case Op_Bitcast: dst = tb_inst_bitcast(tildeProc, unarySrc, unaryType); break;
-            case Op_Select: break;
+            case Op_Select: dst = tb_inst_select(tildeProc, regs[instr.sel.cond], regs[instr.sel.a], regs[instr.sel.b]); break;
             case Op_Not: dst = tb_inst_not(tildeProc, unarySrc); break;
             case Op_Negate: dst = tb_inst_neg(tildeProc, unarySrc); break;
             case Op_And: dst = tb_inst_and(tildeProc, src1, src2); break;
@@ -491,12 +548,102 @@ TB_SwitchEntry* Tc_GetSwitchEntries(Tc_Context* ctx, Interp_Proc* proc, Interp_I
     return res;
 }
 
+// The prologue stores the arguments in their stack variables,
+// so store the new arguments there and jump to the body
+void Tc_GenSelfTailCall(Tc_Context* ctx, TB_Function* tildeProc, Interp_Proc* proc, Interp_Instr instr)
+{
+    auto& regs = ctx->regs;
+    
+    for(int i = 0; i < proc->prologueEnd; ++i)
+    {
+        auto& store = proc->instrs[i];
+        if(store.op != Op_Store || store.store.val >= instr.call.argCount) continue;
+        
+        auto arg = regs[proc->regArrays[instr.call.argStart + store.store.val]];
+        tb_inst_store(tildeProc, arg->dt, regs[store.store.addr], arg, store.store.align, false);
+    }
+    
+    tb_inst_goto(tildeProc, ctx->bodyRegion);
+}
+
+// Keys are contiguous (see Interp_PatchBranch), so after subtracting
+// the first key a single unsigned comparison is enough as a bounds
+// check, and the branch on the index becomes an indexed jump table.
+void Tc_GenJumpTable(Tc_Context* ctx, TB_Function* tildeProc, Interp_Proc* proc, Interp_Instr instr)
+{
+    ScratchArena scratch;
+    
+    auto value = ctx->regs[instr.branch.value];
+    auto defaultBB = ctx->bbs[instr.branch.defaultCase].region;
+    int64 minKey = proc->constArrays[instr.branch.keyStart];
+    
+    TB_Node* idx = tb_inst_sub(tildeProc, value, tb_inst_sint(tildeProc, value->dt, minKey), TB_ARITHMATIC_NONE);
+    TB_Node* inRange = tb_inst_cmp_ilt(tildeProc, idx, tb_inst_uint(tildeProc, value->dt, instr.branch.count), false);
+    
+    TB_Node* tableBB = tb_inst_region(tildeProc);
+    tb_inst_if(tildeProc, inRange, tableBB, defaultBB);
+    tb_inst_set_control(tildeProc, tableBB);
+    
+    auto entries = Arena_AllocArray(scratch, instr.branch.count, TB_SwitchEntry);
+    for(int i = 0; i < instr.branch.count; ++i)
+    {
+        entries[i].key   = i;
+        entries[i].value = ctx->bbs[proc->instrArrays[instr.branch.caseStart + i]].region;
+    }
+    
+    tb_inst_branch(tildeProc, value->dt, idx, defaultBB, instr.branch.count, entries);
+}
+
+// Balanced compare tree over the sorted keys in [lo, hi).
+// Small ranges are just compare chains.
+void Tc_GenBinarySearch(Tc_Context* ctx, TB_Function* tildeProc, Interp_Proc* proc, Interp_Instr instr,
+                        TB_Node* value, int lo, int hi)
+{
+    auto keys = &proc->constArrays[instr.branch.keyStart];
+    auto cases = &proc->instrArrays[instr.branch.caseStart];
+    auto defaultBB = ctx->bbs[instr.branch.defaultCase].region;
+    
+    if(hi - lo < Interp_SwitchMinCases)
+    {
+        for(int i = lo; i < hi; ++i)
+        {
+            TB_Node* key = tb_inst_sint(tildeProc, value->dt, keys[i]);
+            TB_Node* isEqual = tb_inst_cmp_eq(tildeProc, value, key);
+            TB_Node* caseBB = ctx->bbs[cases[i]].region;
+            
+            if(i == hi - 1)
+                tb_inst_if(tildeProc, isEqual, caseBB, defaultBB);
+            else
+            {
+                TB_Node* nextBB = tb_inst_region(tildeProc);
+                tb_inst_if(tildeProc, isEqual, caseBB, nextBB);
+                tb_inst_set_control(tildeProc, nextBB);
+            }
+        }
+        
+        return;
+    }
+    
+    int mid = lo + (hi - lo) / 2;
+    TB_Node* key = tb_inst_sint(tildeProc, value->dt, keys[mid]);
+    TB_Node* isLess = tb_inst_cmp_ilt(tildeProc, value, key, true);
+    
+    TB_Node* leftBB  = tb_inst_region(tildeProc);
+    TB_Node* rightBB = tb_inst_region(tildeProc);
+    tb_inst_if(tildeProc, isLess, leftBB, rightBB);
+    
+    tb_inst_set_control(tildeProc, leftBB);
+    Tc_GenBinarySearch(ctx, tildeProc, proc, instr, value, lo, mid);
+    tb_inst_set_control(tildeProc, rightBB);
+    Tc_GenBinarySearch(ctx, tildeProc, proc, instr, value, mid, hi);
+}
+
 void Tc_Link(TB_Module* module, Slice<char*> objFiles, TB_Arch arch)
 {
     ProfileFunc(prof);
     
-    uint64 linkTimeStart = __rdtsc();
-    defer(timings.linker += 1.0 / GetRdtscFreq() * (__rdtsc() - linkTimeStart));
+    uint64 linkTimeStart = GetMonotonicTimeNs();
+    defer(timings.linker += SecondsSince(linkTimeStart));
     
     ScratchArena scratch;
     
@@ -504,6 +651,15 @@ void Tc_Link(TB_Module* module, Slice<char*> objFiles, TB_Arch arch)
     {
         TB_ExecutableType exeType = TB_EXECUTABLE_PE;
         
+        // Object files are mapped and handed to the linker as they are,
+        // they need to stay mapped until the linker is done with them
+        Slice<MappedFile> mappedObjs = { 0, 0 };
+        mappedObjs.ResizeAndInit(scratch, objFiles.length);
+        defer({
+                  for_array(i, mappedObjs)
+                      UnmapFile(mappedObjs[i]);
+              });
+        
         TB_Linker* linker = tb_linker_create(exeType, arch);
         defer(tb_linker_destroy(linker));
         
@@ -511,18 +667,18 @@ void Tc_Link(TB_Module* module, Slice<char*> objFiles, TB_Arch arch)
         
         for_array(i, objFiles)
         {
-            // Load object file into memory and feed it to the linker
-            FILE* objContent = fopen(objFiles[i], "rb");
-            if(!objContent)
+            mappedObjs[i] = MapFileReadOnly(objFiles[i]);
+            if(!mappedObjs[i].ptr)
             {
                 SetErrorColor();
                 fprintf(stderr, "Error");
                 ResetColor();
                 fprintf(stderr, ": Failed to open object file '%s', will be ignored.\n", objFiles[i]);
+                continue;
             }
             
             TB_Slice name = { strlen(objFiles[i]), (uint8*)objFiles[i] };
-            TB_Slice content = { GetFileSize(objContent), (uint8*)objContent };
+            TB_Slice content = { mappedObjs[i].size, (uint8*)mappedObjs[i].ptr };
             tb_linker_append_object(linker, name, content);
         }
         
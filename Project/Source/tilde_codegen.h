@@ -21,6 +21,7 @@ struct Tc_Context
     TB_Module* module = 0;
     TB_Function* proc = 0;
     Slice<Interp_Symbol> symbols;
+    Slice<Dg_Entity> entities;
     
     TB_Function* mainProc = 0;
     bool emitAsm = false;
@@ -37,6 +38,9 @@ struct Tc_Context
     
     InstrIdx lastRegion = InstrIdx_Unused;
     
+    // Target of self tail calls, right after the prologue
+    TB_Node* bodyRegion = 0;
+    
     // For logical operators (and pretty much nothing else)
     // TODO: Can this be simplified?? I'd say probably, would have
     // to think about how though
@@ -49,7 +53,8 @@ struct Tc_Context
 Tc_Context Tc_InitCtx(TB_Module* module, Arena* strArena, bool emitAsm);
 void Tc_ResetCtx(Tc_Context* ctx);
 
-void Tc_CodegenAndLink(Ast_FileScope* file, Interp* interp, Slice<char*> objFiles);
+// With link == false it stops after generating the code, used for benchmarks
+void Tc_CodegenAndLink(Ast_FileScope* file, Interp* interp, Slice<char*> objFiles, bool link = true);
 void Tc_Link(TB_Module* module, Slice<char*> objFiles, TB_Arch arch);
 
 // From bytecode
@@ -64,6 +69,10 @@ TB_DataType Tc_ToTBType(Interp_Type type);
 TB_Node** Tc_GetNodeArray(Tc_Context* ctx, Interp_Proc* proc, int arrayStart, int arrayCount, Arena* allocTo);
 TB_Node** Tc_GetBBArray(Tc_Context* ctx, Interp_Proc* proc, int arrayStart, int arrayCount, Arena* allocTo);
 TB_SwitchEntry* Tc_GetSwitchEntries(Tc_Context* ctx, Interp_Proc* proc, Interp_Instr instr, Arena* allocTo);
+void Tc_GenJumpTable(Tc_Context* ctx, TB_Function* tildeProc, Interp_Proc* proc, Interp_Instr instr);
+void Tc_GenSelfTailCall(Tc_Context* ctx, TB_Function* tildeProc, Interp_Proc* proc, Interp_Instr instr);
+void Tc_GenBinarySearch(Tc_Context* ctx, TB_Function* tildeProc, Interp_Proc* proc, Interp_Instr instr,
+                        TB_Node* value, int lo, int hi);
 
 TB_DataType Tc_ConvertToTildeType(TypeInfo* type);
 TB_DebugType* Tc_ConvertToDebugType(TB_Module* module, TypeInfo* type);
@@ -19,12 +19,20 @@
 #endif
 
 #include "base.cpp"
+#include "atom.cpp"
 #include "main.cpp"
 #include "lexer.cpp"
 #include "memory_management.cpp"
+#include "job_system.cpp"
 #include "parser.cpp"
 #include "semantics.cpp"
 #include "dependency_graph.cpp"
 #include "tilde_codegen.cpp"
 #include "bytecode_builder.cpp"
 #include "interpreter.cpp"
+#include "jit.cpp"
+#include "snapshot.cpp"
+#include "incremental.cpp"
+#include "corpus_gen.cpp"
+#include "perf_regress.cpp"
+#include "benchmarks.cpp"